@@ -0,0 +1,50 @@
+#include <benchmark/benchmark.h>
+
+#include "common.h"
+#include "object.h"
+#include "persistent_vector.h"
+
+#include <format>
+
+static auto push_program(benchmark::State& state) -> std::string {
+    return std::format(
+        "let arr = []; let i = 0; while (i < {}) {{ arr = push(arr, i); i = i + 1; }} len(arr)",
+        state.range(0)
+    );
+}
+
+static void BM_array_push_vm(benchmark::State& state) {
+    bench::source src{push_program(state)};
+
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(bench::run_vm(src.program));
+    }
+    state.SetComplexityN(state.range(0));
+}
+BENCHMARK(BM_array_push_vm)->RangeMultiplier(8)->Range(1 << 10, 1 << 20)->Unit(benchmark::kMillisecond)->Complexity();
+
+static void BM_array_rest_vm(benchmark::State& state) {
+    bench::source src{std::format(
+        "let arr = []; let i = 0; while (i < {}) {{ arr = push(arr, i); i = i + 1; }} "
+        "let sum = 0; while (len(arr) > 0) {{ sum = sum + first(arr); arr = rest(arr); }} sum",
+        state.range(0)
+    )};
+
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(bench::run_vm(src.program));
+    }
+    state.SetComplexityN(state.range(0));
+}
+BENCHMARK(BM_array_rest_vm)->RangeMultiplier(8)->Range(1 << 10, 1 << 20)->Unit(benchmark::kMillisecond)->Complexity();
+
+static void BM_persistent_vector_push(benchmark::State& state) {
+    for (auto _ : state) {
+        interp::persistent::vector<interp::object::value> vec{};
+        for (interp::i64 i{0}; i < state.range(0); i++) {
+            vec = vec.push_back(interp::object::value::integer(i));
+        }
+        benchmark::DoNotOptimize(vec.size());
+    }
+    state.SetComplexityN(state.range(0));
+}
+BENCHMARK(BM_persistent_vector_push)->RangeMultiplier(8)->Range(1 << 10, 1 << 20)->Complexity();
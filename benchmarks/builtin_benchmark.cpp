@@ -0,0 +1,41 @@
+#include <benchmark/benchmark.h>
+
+#include "builtins.h"
+#include "common.h"
+
+#include <string>
+#include <vector>
+
+static void BM_parse_int_lines(benchmark::State& state) {
+    using namespace interp;
+
+    // Lines as gets() would return them, every tenth one malformed or out of range.
+    std::vector<object::value> lines{};
+    object::get_heap().add_roots(lines);
+    for (i64 i{}; i < state.range(0); i++) {
+        std::string line{std::to_string(i * 7919 - 500000)};
+        if (i % 20 == 0) {
+            line += "x";
+        } else if (i % 20 == 10) {
+            line = "99999999999999999999";
+        }
+        lines.push_back(object::make<object::string>(line));
+    }
+
+    auto& parse_int{builtins::lookup("parse_int").as<object::builtin>()};
+
+    for (auto _ : state) {
+        i64 sum{};
+        for (const auto& line : lines) {
+            auto res{parse_int.fn(std::span{&line, 1})};
+            if (!res.is_error()) {
+                sum += res.as_integer();
+            }
+        }
+        benchmark::DoNotOptimize(sum);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+
+    object::get_heap().remove_roots(lines);
+}
+BENCHMARK(BM_parse_int_lines)->Arg(1000000)->Unit(benchmark::kMillisecond);
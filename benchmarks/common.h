@@ -0,0 +1,73 @@
+#pragma once
+
+#include "compiler.h"
+#include "eval.h"
+#include "lexer.h"
+#include "object.h"
+#include "parser.h"
+#include "resolver.h"
+#include "token.h"
+#include "vm.h"
+
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace bench {
+
+// The ast borrows from the text it was parsed from, so the two are kept together.
+class source {
+public:
+    explicit source(std::string input) : text{std::move(input)} {
+        interp::lexer::lexer l{text};
+        interp::parser::parser p{l};
+
+        program = p.parse_program();
+        if (!p.errors.empty()) {
+            throw std::runtime_error{p.errors[0]};
+        }
+    }
+    source(const source&) = delete;
+    auto operator=(const source&) -> source& = delete;
+
+public:
+    std::string text{};
+    interp::ast::program program{};
+};
+
+inline auto count_tokens(std::string_view input) -> interp::usize {
+    interp::lexer::lexer l{input};
+    interp::usize count{};
+    while (l.next_token().type != interp::token::token_type::End) {
+        count++;
+    }
+
+    return count;
+}
+
+inline auto run_eval(interp::ast::program& program) -> interp::object::value {
+    interp::resolver::resolver r{};
+    r.resolve(program);
+
+    interp::object::environment env{};
+
+    return interp::eval::eval(program, env);
+}
+
+inline auto run_vm(const interp::ast::program& program) -> interp::object::value {
+    interp::compiler::state state{};
+    interp::compiler::compiler c{state};
+    c.compile(program);
+    if (!c.errors.empty()) {
+        throw std::runtime_error{c.errors[0]};
+    }
+
+    std::vector<interp::object::value> globals{};
+    interp::vm::vm machine{c.get_bytecode(), globals};
+
+    return machine.run();
+}
+
+}
@@ -0,0 +1,60 @@
+#include <benchmark/benchmark.h>
+
+#include "common.h"
+
+#include <format>
+
+static void BM_eval_while_loop(benchmark::State& state) {
+    bench::source src{std::format(
+        "let i = 0; let sum = 0; while (i < {}) {{ if (i / 2 * 2 == i) {{ sum = sum + i; }} i = i + 1; }} sum",
+        state.range(0)
+    )};
+
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(bench::run_eval(src.program));
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_eval_while_loop)->Arg(100000)->Unit(benchmark::kMillisecond);
+
+static void BM_eval_fib(benchmark::State& state) {
+    bench::source src{std::format(
+        "let fib = fn(n) {{ if (n < 2) {{ return n; }} fib(n - 1) + fib(n - 2) }}; fib({})",
+        state.range(0)
+    )};
+
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(bench::run_eval(src.program));
+    }
+}
+BENCHMARK(BM_eval_fib)->Arg(20)->Arg(25)->Unit(benchmark::kMillisecond);
+
+static void BM_eval_array_hash(benchmark::State& state) {
+    bench::source src{std::format(
+        "let square_len = fn(str) {{ let l = len(str); return l * l; }}; "
+        "let i = 0; let arr = []; "
+        "while (i < {}) {{ arr = push(arr, {{\"len\": square_len(\"some text\")}}); i = i + 1; }} "
+        "arr[len(arr) - 1][\"len\"]",
+        state.range(0)
+    )};
+
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(bench::run_eval(src.program));
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_eval_array_hash)->Arg(10000)->Unit(benchmark::kMillisecond);
+
+static void BM_eval_closure_factory(benchmark::State& state) {
+    bench::source src{std::format(
+        "let newAdder = fn(x) {{ fn(y) {{ x + y }} }}; "
+        "let i = 0; let sum = 0; while (i < {}) {{ sum = sum + newAdder(i)(1); i = i + 1; }} sum",
+        state.range(0)
+    )};
+
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(bench::run_eval(src.program));
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_eval_closure_factory)->Arg(100000)->Unit(benchmark::kMillisecond);
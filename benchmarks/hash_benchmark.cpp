@@ -0,0 +1,32 @@
+#include <benchmark/benchmark.h>
+
+#include "common.h"
+
+#include <format>
+
+static void BM_hash_set_vm(benchmark::State& state) {
+    bench::source src{std::format(
+        "let h = {{}}; let i = 0; while (i < {}) {{ h = set(h, i, i); i = i + 1; }} h[0]",
+        state.range(0)
+    )};
+
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(bench::run_vm(src.program));
+    }
+    state.SetComplexityN(state.range(0));
+}
+BENCHMARK(BM_hash_set_vm)->RangeMultiplier(8)->Range(1 << 10, 1 << 18)->Unit(benchmark::kMillisecond)->Complexity();
+
+static void BM_hash_read_vm(benchmark::State& state) {
+    bench::source src{std::format(
+        "let h = {{}}; let i = 0; while (i < {0}) {{ h = set(h, i, i); i = i + 1; }} "
+        "let sum = 0; let j = 0; while (j < {0}) {{ let copy = h; sum = sum + copy[j]; j = j + 1; }} sum",
+        state.range(0)
+    )};
+
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(bench::run_vm(src.program));
+    }
+    state.SetComplexityN(state.range(0));
+}
+BENCHMARK(BM_hash_read_vm)->RangeMultiplier(8)->Range(1 << 10, 1 << 18)->Unit(benchmark::kMillisecond)->Complexity();
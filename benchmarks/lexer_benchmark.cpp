@@ -0,0 +1,69 @@
+#include <benchmark/benchmark.h>
+
+#include "common.h"
+
+#include <string>
+#include <vector>
+
+// Mostly identifiers and keywords, with near misses like `lets`, `iff` and `fns`.
+static auto identifier_program(benchmark::State& state) -> std::string {
+    std::string input{};
+    for (interp::i64 i{}; i < state.range(0); i++) {
+        input += "let value = fn(first, second) { if (first) { return second; } else { lets = iff; fns } }; ";
+        input += "while (truthy) { break; continue; falsey; returned; elsewhere; } ";
+    }
+
+    return input;
+}
+
+static void BM_lex_identifiers(benchmark::State& state) {
+    auto input{identifier_program(state)};
+
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(bench::count_tokens(input));
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * input.size()));
+}
+BENCHMARK(BM_lex_identifiers)->Arg(10000)->Unit(benchmark::kMillisecond);
+
+static void BM_parse_streamed(benchmark::State& state) {
+    auto input{identifier_program(state)};
+
+    for (auto _ : state) {
+        interp::lexer::lexer l{input};
+        interp::parser::parser p{l};
+        benchmark::DoNotOptimize(p.parse_program());
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * input.size()));
+}
+BENCHMARK(BM_parse_streamed)->Arg(10000)->Unit(benchmark::kMillisecond);
+
+static void BM_parse_token_buffer(benchmark::State& state) {
+    auto input{identifier_program(state)};
+
+    for (auto _ : state) {
+        interp::lexer::lexer l{input};
+        auto tokens{l.tokenize()};
+        interp::parser::parser p{tokens};
+        benchmark::DoNotOptimize(p.parse_program());
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * input.size()));
+}
+BENCHMARK(BM_parse_token_buffer)->Arg(10000)->Unit(benchmark::kMillisecond);
+
+// One parser per line, like the repl.
+static void BM_parse_repl_lines(benchmark::State& state) {
+    std::vector<std::string> lines{
+        "let x = 5;", "x + 10 * 2", "let add = fn(a, b) { a + b };", "add(x, 3)", "[1, 2][0]"
+    };
+
+    for (auto _ : state) {
+        for (const auto& line : lines) {
+            interp::lexer::lexer l{line};
+            interp::parser::parser p{l};
+            benchmark::DoNotOptimize(p.parse_program());
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(lines.size()));
+}
+BENCHMARK(BM_parse_repl_lines);
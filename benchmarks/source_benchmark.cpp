@@ -0,0 +1,69 @@
+#include <benchmark/benchmark.h>
+
+#include "common.h"
+#include "source.h"
+
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+static constexpr interp::usize script_size{100 << 20};
+
+// A script made of one big array literal, like the generated data files, written once per run.
+static auto script_path() -> const std::string& {
+    static const std::string path{[] {
+        auto p{(std::filesystem::temp_directory_path() / "interp_source_benchmark.nm").string()};
+
+        std::ofstream ofs{p, std::ios::binary};
+        ofs << "let data = [";
+        interp::usize written{12};
+        for (interp::usize i{}; written < script_size; i++) {
+            auto elem{std::to_string(i) + ", "};
+            ofs << elem;
+            written += elem.size();
+        }
+        ofs << "0];";
+
+        return p;
+    }()};
+
+    return path;
+}
+
+static void BM_source_ifstream(benchmark::State& state) {
+    const auto& path{script_path()};
+
+    for (auto _ : state) {
+        std::ifstream ifs{path};
+        std::ostringstream oss{};
+        oss << ifs.rdbuf();
+        auto str = oss.str();
+
+        benchmark::DoNotOptimize(bench::count_tokens(str));
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * script_size));
+}
+BENCHMARK(BM_source_ifstream)->Unit(benchmark::kMillisecond);
+
+static void BM_source_mmap(benchmark::State& state) {
+    const auto& path{script_path()};
+
+    for (auto _ : state) {
+        interp::source::file src{path.c_str()};
+
+        benchmark::DoNotOptimize(bench::count_tokens(src.text()));
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * script_size));
+}
+BENCHMARK(BM_source_mmap)->Unit(benchmark::kMillisecond);
+
+static void BM_tokenize_threads(benchmark::State& state) {
+    interp::source::file src{script_path().c_str()};
+
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(interp::lexer::tokenize(src.text(), static_cast<interp::usize>(state.range(0))));
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * script_size));
+}
+BENCHMARK(BM_tokenize_threads)->RangeMultiplier(2)->Range(1, 16)->Unit(benchmark::kMillisecond)->UseRealTime();
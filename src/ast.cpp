@@ -1,11 +1,88 @@
 #include "ast.h"
+#include <algorithm>
+#include <cstdint>
+#include <format>
 #include <memory>
 #include <sstream>
+#include <utility>
 
 namespace interp {
 
 namespace ast {
 
+auto get_operator_string(operator_type op) -> std::string_view {
+    switch (op) {
+    case operator_type::Plus:
+        return "+";
+    case operator_type::Minus:
+        return "-";
+    case operator_type::Asterisk:
+        return "*";
+    case operator_type::Slash:
+        return "/";
+    case operator_type::Lt:
+        return "<";
+    case operator_type::Gt:
+        return ">";
+    case operator_type::Eq:
+        return "==";
+    case operator_type::NotEq:
+        return "!=";
+    case operator_type::Bang:
+        return "!";
+    }
+
+    std::unreachable();
+}
+
+auto get_operator_type(token::token_type type) -> operator_type {
+    switch (type) {
+    case token::token_type::Plus:
+        return operator_type::Plus;
+    case token::token_type::Minus:
+        return operator_type::Minus;
+    case token::token_type::Asterisk:
+        return operator_type::Asterisk;
+    case token::token_type::Slash:
+        return operator_type::Slash;
+    case token::token_type::Lt:
+        return operator_type::Lt;
+    case token::token_type::Gt:
+        return operator_type::Gt;
+    case token::token_type::Eq:
+        return operator_type::Eq;
+    case token::token_type::NotEq:
+        return operator_type::NotEq;
+    case token::token_type::Bang:
+        return operator_type::Bang;
+    default:
+        std::unreachable();
+    }
+}
+
+auto arena::allocate(usize size, usize align) -> void* {
+    auto offset{static_cast<usize>(-reinterpret_cast<uintptr_t>(cursor)) & (align - 1)};
+    if (cursor == nullptr || static_cast<usize>(end - cursor) < offset + size) {
+        auto next{blocks.empty() ? first_block_size : std::min(max_block_size, bytes_reserved)};
+        auto len{std::max(next, size + align)};
+        blocks.emplace_back(std::make_unique_for_overwrite<std::byte[]>(len));
+        cursor = blocks.back().get();
+        end = cursor + len;
+        bytes_reserved += len;
+        offset = static_cast<usize>(-reinterpret_cast<uintptr_t>(cursor)) & (align - 1);
+    }
+
+    auto mem{cursor + offset};
+    cursor = mem + size;
+    bytes_used += offset + size;
+
+    return mem;
+}
+
+auto arena::report() const -> std::string {
+    return std::format("ast: {} nodes, {} bytes used, {} bytes reserved", num_nodes, bytes_used, bytes_reserved);
+}
+
 auto program::token_literal() const -> std::string {
     if (statements.empty()) {
         return {};
@@ -24,24 +101,16 @@ auto program::to_string() const -> std::string {
     return ss.str();
 }
 
-auto identifier::clone() const -> std::unique_ptr<expression> {
-    return std::make_unique<identifier>(*this);
-}
-
 auto identifier::token_literal() const -> std::string {
-    return token.literal;
+    return std::string{value};
 }
 
 auto identifier::to_string() const -> std::string {
-    return value;
-}
-
-auto let_statement::clone() const -> std::unique_ptr<statement> {
-    return std::make_unique<let_statement>(*this);
+    return std::string{value};
 }
 
 auto let_statement::token_literal() const -> std::string {
-    return token.literal;
+    return "let";
 }
 
 auto let_statement::to_string() const -> std::string {
@@ -60,12 +129,8 @@ auto let_statement::to_string() const -> std::string {
     return ss.str();
 }
 
-auto return_statement::clone() const -> std::unique_ptr<statement> {
-    return std::make_unique<return_statement>(*this);
-}
-
 auto return_statement::token_literal() const -> std::string {
-    return token.literal;
+    return "return";
 }
 
 auto return_statement::to_string() const -> std::string {
@@ -82,12 +147,12 @@ auto return_statement::to_string() const -> std::string {
     return ss.str();
 }
 
-auto expression_statement::clone() const -> std::unique_ptr<statement> {
-    return std::make_unique<expression_statement>(*this);
-}
-
 auto expression_statement::token_literal() const -> std::string {
-    return token.literal;
+    if (expr != nullptr) {
+        return expr->token_literal();
+    }
+
+    return {};
 }
 
 auto expression_statement::to_string() const -> std::string {
@@ -98,66 +163,57 @@ auto expression_statement::to_string() const -> std::string {
     return {};
 }
 
-auto integer_literal::clone() const -> std::unique_ptr<expression> {
-    return std::make_unique<integer_literal>(*this);
-}
-
 auto integer_literal::token_literal() const -> std::string {
-    return token.literal;
+    return std::to_string(value);
 }
 
 auto integer_literal::to_string() const -> std::string {
-    return token.literal;
-}
-
-auto prefix_expression::clone() const -> std::unique_ptr<expression> {
-    return std::make_unique<prefix_expression>(*this);
+    return token_literal();
 }
 
 auto prefix_expression::token_literal() const -> std::string {
-    return token.literal;
+    return std::string{get_operator_string(oper)};
 }
 
 auto prefix_expression::to_string() const -> std::string {
-    return std::format("({}{})", oper, right->to_string());
+    return std::format("({}{})", get_operator_string(oper), right->to_string());
 }
 
-auto infix_expression::clone() const -> std::unique_ptr<expression> {
-    return std::make_unique<infix_expression>(*this);
+// Each left operand is taken out of its parent before the parent is destroyed, so chains are destroyed one operator
+// at a time.
+infix_expression::~infix_expression() {
+    auto next{std::move(left)};
+    while (next != nullptr && next->type() == node_type::InfixExpression) {
+        next = std::move(static_cast<infix_expression&>(*next).left);
+    }
 }
 
 auto infix_expression::token_literal() const -> std::string {
-    return token.literal;
+    return std::string{get_operator_string(oper)};
 }
 
 auto infix_expression::to_string() const -> std::string {
-    return std::format("({} {} {})", left->to_string(), oper, right->to_string());
-}
+    auto spine{left_spine(*this)};
 
-auto boolean_expression::clone() const -> std::unique_ptr<expression> {
-    return std::make_unique<boolean_expression>(*this);
+    std::string str(spine.size(), '(');
+    str += spine.back()->left->to_string();
+    for (auto it{spine.rbegin()}; it != spine.rend(); it++) {
+        str += std::format(" {} {})", get_operator_string((*it)->oper), (*it)->right->to_string());
+    }
+
+    return str;
 }
 
 auto boolean_expression::token_literal() const -> std::string {
-    return token.literal;
+    return value ? "true" : "false";
 }
 
 auto boolean_expression::to_string() const -> std::string {
-    return token.literal;
-}
-
-block_statement::block_statement(const block_statement& other) : token{other.token} {
-    for (const auto& stmt : other.statements) {
-        statements.emplace_back(stmt->clone());
-    }
-}
-
-auto block_statement::clone() const -> std::unique_ptr<statement> {
-    return std::make_unique<block_statement>(*this);
+    return token_literal();
 }
 
 auto block_statement::token_literal() const -> std::string {
-    return token.literal;
+    return "{";
 }
 
 auto block_statement::to_string() const -> std::string {
@@ -170,19 +226,8 @@ auto block_statement::to_string() const -> std::string {
     return ss.str();
 }
 
-if_expression::if_expression(const if_expression& other)
-    : token{other.token}, condition{other.condition->clone()}, consequence{other.consequence->clone()} {
-    if (other.alternative) {
-        alternative = other.alternative->clone();
-    }
-}
-
-auto if_expression::clone() const -> std::unique_ptr<expression> {
-    return std::make_unique<if_expression>(*this);
-}
-
 auto if_expression::token_literal() const -> std::string {
-    return token.literal;
+    return "if";
 }
 
 auto if_expression::to_string() const -> std::string {
@@ -197,18 +242,8 @@ auto if_expression::to_string() const -> std::string {
     return ss.str();
 }
 
-fn_expression::fn_expression(const fn_expression& other) : token{other.token}, body{other.body->clone()} {
-    for (const auto& param : other.parameters) {
-        parameters.push_back(param->clone());
-    }
-}
-
-auto fn_expression::clone() const -> std::unique_ptr<expression> {
-    return std::make_unique<fn_expression>(*this);
-}
-
 auto fn_expression::token_literal() const -> std::string {
-    return token.literal;
+    return "fn";
 }
 
 auto fn_expression::to_string() const -> std::string {
@@ -216,30 +251,21 @@ auto fn_expression::to_string() const -> std::string {
 
     ss << token_literal() << "(";
 
+    const auto& parameters{prototype->parameters};
     for (u32 i{0}; i < parameters.size(); i++) {
-        ss << parameters[i];
+        ss << parameters[i]->to_string();
         if (i != parameters.size() - 1) {
             ss << ", ";
         }
     }
 
-    ss << ")" << body->to_string();
+    ss << ")" << prototype->body->to_string();
 
     return ss.str();
 }
 
-call_expression::call_expression(const call_expression& other) : token{other.token}, fn{other.fn->clone()} {
-    for (const auto& arg : other.arguments) {
-        arguments.emplace_back(arg->clone());
-    }
-}
-
-auto call_expression::clone() const -> std::unique_ptr<expression> {
-    return std::make_unique<call_expression>(*this);
-}
-
 auto call_expression::token_literal() const -> std::string {
-    return token.literal;
+    return "(";
 }
 
 auto call_expression::to_string() const -> std::string {
@@ -259,30 +285,16 @@ auto call_expression::to_string() const -> std::string {
     return ss.str();
 }
 
-auto string_literal::clone() const -> std::unique_ptr<expression> {
-    return std::make_unique<string_literal>(*this);
-}
-
 auto string_literal::token_literal() const -> std::string {
-    return token.literal;
+    return std::string{value};
 }
 
 auto string_literal::to_string() const -> std::string {
-    return token.literal;
-}
-
-array_literal::array_literal(const array_literal& other) : token{other.token} {
-    for (const auto& elem : other.elements) {
-        elements.emplace_back(elem->clone());
-    }
-}
-
-auto array_literal::clone() const -> std::unique_ptr<expression> {
-    return std::make_unique<array_literal>(*this);
+    return token_literal();
 }
 
 auto array_literal::token_literal() const -> std::string {
-    return token.literal;
+    return "[";
 }
 
 auto array_literal::to_string() const -> std::string {
@@ -300,30 +312,16 @@ auto array_literal::to_string() const -> std::string {
     return ss.str();
 }
 
-auto index_expression::clone() const -> std::unique_ptr<expression> {
-    return std::make_unique<index_expression>(*this);
-}
-
 auto index_expression::token_literal() const -> std::string {
-    return token.literal;
+    return "[";
 }
 
 auto index_expression::to_string() const -> std::string {
     return std::format("({}[{}])", left->to_string(), index->to_string());
 }
 
-hash_literal::hash_literal(const hash_literal& other) : token{other.token} {
-    for (const auto& [key, val] : other.pairs) {
-        pairs[key->clone()] = val->clone();
-    }
-}
-
-auto hash_literal::clone() const -> std::unique_ptr<expression> {
-    return std::make_unique<hash_literal>(*this);
-}
-
 auto hash_literal::token_literal() const -> std::string {
-    return token.literal;
+    return "{";
 }
 
 auto hash_literal::to_string() const -> std::string {
@@ -332,7 +330,7 @@ auto hash_literal::to_string() const -> std::string {
     ss << "{";
     for (u32 i{0}; const auto& [key, val] : pairs) {
         ss << key->to_string() << ": " << val->to_string();
-        if (i != pairs.size() - 1) {
+        if (i++ != pairs.size() - 1) {
             ss << ", ";
         }
     }
@@ -341,52 +339,179 @@ auto hash_literal::to_string() const -> std::string {
     return ss.str();
 }
 
-auto assign_expression::clone() const -> std::unique_ptr<expression> {
-    return std::make_unique<assign_expression>(*this);
-}
-
 auto assign_expression::token_literal() const -> std::string {
-    return token.literal;
+    return "=";
 }
 
 auto assign_expression::to_string() const -> std::string {
     return std::format("{} = {}", name->to_string(), value->to_string());
 }
 
-auto while_statement::clone() const -> std::unique_ptr<statement> {
-    return std::make_unique<while_statement>(*this);
-}
-
 auto while_statement::token_literal() const -> std::string {
-    return token.literal;
+    return "while";
 }
 
 auto while_statement::to_string() const -> std::string {
     return std::format("while {} {}", condition->to_string(), body->to_string());
 }
 
-auto break_statement::clone() const -> std::unique_ptr<statement> {
-    return std::make_unique<break_statement>(*this);
-}
-
 auto break_statement::token_literal() const -> std::string {
-    return token.literal;
+    return "break";
 }
 
 auto break_statement::to_string() const -> std::string {
-    return token.literal;
-}
-
-auto continue_statement::clone() const -> std::unique_ptr<statement> {
-    return std::make_unique<continue_statement>(*this);
+    return token_literal();
 }
 
 auto continue_statement::token_literal() const -> std::string {
-    return token.literal;
+    return "continue";
 }
 
 auto continue_statement::to_string() const -> std::string {
-    return token.literal;
+    return token_literal();
+}
+
+auto for_each_child(node& parent, const std::function<void(node&)>& fn) -> void {
+    auto visit{[&](node* child) {
+        if (child) {
+            fn(*child);
+        }
+    }};
+
+    switch (parent.type()) {
+    case node_type::Program: {
+        for (const auto& stmt : static_cast<program&>(parent).statements) {
+            visit(stmt.get());
+        }
+    } break;
+
+    case node_type::BlockStatement: {
+        for (const auto& stmt : static_cast<block_statement&>(parent).statements) {
+            visit(stmt.get());
+        }
+    } break;
+
+    case node_type::ExpressionStatement: {
+        visit(static_cast<expression_statement&>(parent).expr.get());
+    } break;
+
+    case node_type::LetStatement: {
+        visit(static_cast<let_statement&>(parent).value.get());
+    } break;
+
+    case node_type::ReturnStatement: {
+        visit(static_cast<return_statement&>(parent).value.get());
+    } break;
+
+    case node_type::WhileStatement: {
+        auto& n{static_cast<while_statement&>(parent)};
+        visit(n.condition.get());
+        visit(n.body.get());
+    } break;
+
+    case node_type::PrefixExpression: {
+        visit(static_cast<prefix_expression&>(parent).right.get());
+    } break;
+
+    case node_type::InfixExpression: {
+        auto& n{static_cast<infix_expression&>(parent)};
+        visit(n.left.get());
+        visit(n.right.get());
+    } break;
+
+    case node_type::IfExpression: {
+        auto& n{static_cast<if_expression&>(parent)};
+        visit(n.condition.get());
+        visit(n.consequence.get());
+        visit(n.alternative.get());
+    } break;
+
+    case node_type::FnExpression: {
+        auto& proto{*static_cast<fn_expression&>(parent).prototype};
+        for (const auto& param : proto.parameters) {
+            visit(param.get());
+        }
+        visit(proto.body.get());
+    } break;
+
+    case node_type::CallExpression: {
+        auto& n{static_cast<call_expression&>(parent)};
+        visit(n.fn.get());
+        for (const auto& arg : n.arguments) {
+            visit(arg.get());
+        }
+    } break;
+
+    case node_type::ArrayLiteral: {
+        for (const auto& elem : static_cast<array_literal&>(parent).elements) {
+            visit(elem.get());
+        }
+    } break;
+
+    case node_type::IndexExpression: {
+        auto& n{static_cast<index_expression&>(parent)};
+        visit(n.left.get());
+        visit(n.index.get());
+    } break;
+
+    case node_type::HashLiteral: {
+        for (const auto& [key, val] : static_cast<hash_literal&>(parent).pairs) {
+            visit(key.get());
+            visit(val.get());
+        }
+    } break;
+
+    case node_type::AssignExpression: {
+        auto& n{static_cast<assign_expression&>(parent)};
+        visit(n.name.get());
+        visit(n.value.get());
+    } break;
+
+    // Leaves.
+    case node_type::Identifier:
+    case node_type::IntegerLiteral:
+    case node_type::BooleanExpression:
+    case node_type::StringLiteral:
+    case node_type::BreakStatement:
+    case node_type::ContinueStatement: {
+    } break;
+    }
+}
+
+auto for_each_child(const node& parent, const std::function<void(const node&)>& fn) -> void {
+    for_each_child(const_cast<node&>(parent), [&](node& child) { fn(child); });
+}
+
+auto walk(const node& root, const std::function<bool(const node&)>& fn) -> void {
+    std::vector<const node*> pending{&root};
+    std::vector<const node*> children{};
+
+    while (!pending.empty()) {
+        auto n{pending.back()};
+        pending.pop_back();
+        if (!fn(*n)) {
+            continue;
+        }
+
+        children.clear();
+        for_each_child(*n, [&](const node& child) { children.push_back(&child); });
+        pending.insert(pending.end(), children.rbegin(), children.rend());
+    }
+}
+
+auto left_spine(infix_expression& expr) -> std::vector<infix_expression*> {
+    std::vector<infix_expression*> spine{&expr};
+    while (spine.back()->left != nullptr && spine.back()->left->type() == node_type::InfixExpression) {
+        spine.push_back(static_cast<infix_expression*>(spine.back()->left.get()));
+    }
+
+    return spine;
+}
+
+auto left_spine(const infix_expression& expr) -> std::vector<const infix_expression*> {
+    auto spine{left_spine(const_cast<infix_expression&>(expr))};
+
+    return {spine.begin(), spine.end()};
 }
 
 }
@@ -1,367 +1,525 @@
 #pragma once
 
 #include "token.h"
+#include "types.h"
+#include <cstddef>
+#include <functional>
 #include <memory>
+#include <new>
 #include <string>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
 namespace interp {
 
 namespace ast {
 
+enum class operator_type : u8 {
+    Plus,
+    Minus,
+    Asterisk,
+    Slash,
+    Lt,
+    Gt,
+    Eq,
+    NotEq,
+    Bang,
+};
+
+static constexpr usize num_operators{static_cast<usize>(operator_type::Bang) + 1};
+
+auto get_operator_string(operator_type op) -> std::string_view;
+auto get_operator_type(token::token_type type) -> operator_type;
+
+enum class node_type : u8 {
+    Program,
+    Identifier,
+    LetStatement,
+    ReturnStatement,
+    ExpressionStatement,
+    IntegerLiteral,
+    PrefixExpression,
+    InfixExpression,
+    BooleanExpression,
+    BlockStatement,
+    IfExpression,
+    FnExpression,
+    CallExpression,
+    StringLiteral,
+    ArrayLiteral,
+    IndexExpression,
+    HashLiteral,
+    AssignExpression,
+    WhileStatement,
+    BreakStatement,
+    ContinueStatement,
+};
+
+// Where a node came from in the source, in place of its whole token.
+struct source_span {
+    u32 offset{};
+    u32 length{};
+};
+
+class node;
+
+// Nodes live in an arena, so owning pointers to them only run the destructor.
+struct node_deleter {
+    auto operator()(node* n) const -> void;
+};
+
+template <typename T>
+using node_ptr = std::unique_ptr<T, node_deleter>;
+
 class node {
 public:
     virtual ~node() = default;
 
+    virtual auto type() const -> node_type = 0;
     virtual auto token_literal() const -> std::string = 0;
     virtual auto to_string() const -> std::string = 0;
 };
 
+inline auto node_deleter::operator()(node* n) const -> void {
+    n->~node();
+}
+
+// Bump allocator the parser creates nodes in. Memory is only released with the arena, which the program and every
+// function prototype parsed into it keep alive.
+class arena {
+public:
+    // Blocks double in size from the first to the max, so a one line repl program does not reserve the max.
+    static constexpr usize first_block_size{1024};
+    static constexpr usize max_block_size{64 * 1024};
+
+    arena() {}
+    arena(const arena&) = delete;
+    auto operator=(const arena&) -> arena& = delete;
+
+    template <typename T, typename... Args>
+    auto make(Args&&... args) -> node_ptr<T> {
+        auto mem{allocate(sizeof(T), alignof(T))};
+        num_nodes++;
+        return node_ptr<T>{new (mem) T(std::forward<Args>(args)...)};
+    }
+
+    auto allocate(usize size, usize align) -> void*;
+
+    auto report() const -> std::string;
+
+public:
+    usize num_nodes{};
+    usize bytes_used{};
+    usize bytes_reserved{};
+
+private:
+    std::vector<std::unique_ptr<std::byte[]>> blocks{};
+    std::byte* cursor{};
+    std::byte* end{};
+};
+
 class statement : public node {
 public:
-    virtual auto clone() const -> std::unique_ptr<statement> = 0;
     virtual auto statement_node() const -> void = 0;
 };
 
 class expression : public node {
 public:
-    virtual auto clone() const -> std::unique_ptr<expression> = 0;
     virtual auto expression_node() const -> void = 0;
 };
 
+// Names and string literals in the ast are views into the source it was parsed from, which has to outlive it.
 class program : public node {
 public:
+    inline auto type() const -> node_type override {
+        return node_type::Program;
+    }
     auto token_literal() const -> std::string override;
     auto to_string() const -> std::string override;
 
 public:
-    std::vector<std::unique_ptr<statement>> statements{};
+    // Declared first so the statements are destroyed before the memory they live in.
+    std::shared_ptr<arena> node_arena{std::make_shared<arena>()};
+    std::vector<node_ptr<statement>> statements{};
+    usize num_slots{};
 };
 
 class identifier : public expression {
 public:
     identifier() {}
-    identifier(const token::token& tok, std::string_view val) : token{tok}, value{val} {}
+    identifier(source_span span, std::string_view val) : span{span}, value{val} {}
 
     auto expression_node() const -> void override {}
-    auto clone() const -> std::unique_ptr<expression> override;
+    inline auto type() const -> node_type override {
+        return node_type::Identifier;
+    }
     auto token_literal() const -> std::string override;
     auto to_string() const -> std::string override;
 
 public:
-    token::token token{};
-    std::string value{};
+    source_span span{};
+    std::string_view value{};
+
+    // Set by the resolver, the variable is stored `depth` environments up at index `slot`.
+    // For builtins `slot` is the index into builtins::definitions.
+    u32 depth{};
+    u32 slot{};
+    bool builtin{};
 };
 
 class let_statement : public statement {
 public:
-    let_statement(const token::token& tok) : token{tok} {}
-    let_statement(const let_statement& other) : token{other.token}, name{other.name}, value{other.value->clone()} {}
+    let_statement(source_span span) : span{span} {}
 
     auto statement_node() const -> void override {};
-    auto clone() const -> std::unique_ptr<statement> override;
+    inline auto type() const -> node_type override {
+        return node_type::LetStatement;
+    }
     auto token_literal() const -> std::string override;
     auto to_string() const -> std::string override;
 
 public:
-    token::token token{};
+    source_span span{};
     identifier name{};
-    std::unique_ptr<expression> value{};
+    node_ptr<expression> value{};
 };
 
 class return_statement : public statement {
 public:
-    return_statement(const token::token& tok) : token{tok} {}
-    return_statement(const return_statement& other) : token{other.token}, value{other.value->clone()} {}
+    return_statement(source_span span) : span{span} {}
 
     auto statement_node() const -> void override {}
-    auto clone() const -> std::unique_ptr<statement> override;
+    inline auto type() const -> node_type override {
+        return node_type::ReturnStatement;
+    }
     auto token_literal() const -> std::string override;
     auto to_string() const -> std::string override;
 
 public:
-    token::token token{};
-    std::unique_ptr<expression> value{};
+    source_span span{};
+    node_ptr<expression> value{};
 };
 
 class expression_statement : public statement {
 public:
-    expression_statement(const token::token& tok) : token{tok} {}
-    expression_statement(const expression_statement& other) : token{other.token}, expr{other.expr->clone()} {}
+    expression_statement(source_span span) : span{span} {}
 
     auto statement_node() const -> void override {}
-    auto clone() const -> std::unique_ptr<statement> override;
+    inline auto type() const -> node_type override {
+        return node_type::ExpressionStatement;
+    }
     auto token_literal() const -> std::string override;
     auto to_string() const -> std::string override;
 
 public:
-    token::token token{};
-    std::unique_ptr<expression> expr{};
+    source_span span{};
+    node_ptr<expression> expr{};
 };
 
 class integer_literal : public expression {
 public:
     integer_literal() {}
-    integer_literal(const token::token& tok, i64 val) : token{tok}, value{val} {}
+    integer_literal(source_span span, i64 val) : span{span}, value{val} {}
 
     auto expression_node() const -> void override {}
-    auto clone() const -> std::unique_ptr<expression> override;
+    inline auto type() const -> node_type override {
+        return node_type::IntegerLiteral;
+    }
     auto token_literal() const -> std::string override;
     auto to_string() const -> std::string override;
 
 public:
-    token::token token{};
+    source_span span{};
     i64 value{};
 };
 
 class prefix_expression : public expression {
 public:
     prefix_expression() {}
-    prefix_expression(const token::token& tok, std::string_view op) : token{tok}, oper{op} {}
-    prefix_expression(const prefix_expression& other)
-        : token{other.token}, oper{other.oper}, right{other.right->clone()} {}
+    prefix_expression(source_span span, operator_type op) : span{span}, oper{op} {}
 
     auto expression_node() const -> void override {}
-    auto clone() const -> std::unique_ptr<expression> override;
+    inline auto type() const -> node_type override {
+        return node_type::PrefixExpression;
+    }
     auto token_literal() const -> std::string override;
     auto to_string() const -> std::string override;
 
 public:
-    token::token token{};
-    std::string oper{};
-    std::unique_ptr<expression> right{};
+    source_span span{};
+    operator_type oper{};
+    node_ptr<expression> right{};
 };
 
 class infix_expression : public expression {
 public:
     infix_expression() {}
-    infix_expression(const token::token& tok, std::string_view op, std::unique_ptr<ast::expression> l)
-        : token{tok}, left{std::move(l)}, oper{op} {}
-    infix_expression(const infix_expression& other)
-        : token{other.token}, left{other.left->clone()}, oper{other.oper}, right{other.right->clone()} {}
+    infix_expression(source_span span, operator_type op, node_ptr<ast::expression> l)
+        : span{span}, left{std::move(l)}, oper{op} {}
+    ~infix_expression() override;
 
     auto expression_node() const -> void override {}
-    auto clone() const -> std::unique_ptr<expression> override;
+    inline auto type() const -> node_type override {
+        return node_type::InfixExpression;
+    }
     auto token_literal() const -> std::string override;
     auto to_string() const -> std::string override;
 
 public:
-    token::token token{};
-    std::unique_ptr<expression> left{};
-    std::string oper{};
-    std::unique_ptr<expression> right{};
+    source_span span{};
+    node_ptr<expression> left{};
+    operator_type oper{};
+    node_ptr<expression> right{};
 };
 
 class boolean_expression : public expression {
 public:
     boolean_expression() {}
-    boolean_expression(const token::token& tok, bool val) : token{tok}, value{val} {}
+    boolean_expression(source_span span, bool val) : span{span}, value{val} {}
 
     auto expression_node() const -> void override {}
-    auto clone() const -> std::unique_ptr<expression> override;
+    inline auto type() const -> node_type override {
+        return node_type::BooleanExpression;
+    }
     auto token_literal() const -> std::string override;
     auto to_string() const -> std::string override;
 
 public:
-    token::token token{};
+    source_span span{};
     bool value{};
 };
 
 class block_statement : public statement {
 public:
     block_statement() {}
-    block_statement(const token::token& tok) : token{tok} {}
-    block_statement(const block_statement& tok);
+    block_statement(source_span span) : span{span} {}
 
     auto statement_node() const -> void override {};
-    auto clone() const -> std::unique_ptr<statement> override;
+    inline auto type() const -> node_type override {
+        return node_type::BlockStatement;
+    }
     auto token_literal() const -> std::string override;
     auto to_string() const -> std::string override;
 
 public:
-    token::token token{};
-    std::vector<std::unique_ptr<statement>> statements{};
+    source_span span{};
+    std::vector<node_ptr<statement>> statements{};
 };
 
 class if_expression : public expression {
 public:
     if_expression() {}
-    if_expression(const token::token& tok) : token{tok} {}
-    if_expression(const if_expression& other);
+    if_expression(source_span span) : span{span} {}
 
     auto expression_node() const -> void override {}
-    auto clone() const -> std::unique_ptr<expression> override;
+    inline auto type() const -> node_type override {
+        return node_type::IfExpression;
+    }
     auto token_literal() const -> std::string override;
     auto to_string() const -> std::string override;
 
 public:
-    token::token token{};
-    std::unique_ptr<expression> condition{};
-    std::unique_ptr<statement> consequence{};
-    std::unique_ptr<statement> alternative{};
+    source_span span{};
+    node_ptr<expression> condition{};
+    node_ptr<statement> consequence{};
+    node_ptr<statement> alternative{};
+};
+
+// The parameters and body of a function literal. Function values share it with the literal, so creating or reading
+// them never copies the ast.
+class fn_prototype {
+public:
+    // Keeps the nodes below alive after the program they were parsed in is gone.
+    std::shared_ptr<arena> node_arena{};
+    std::vector<node_ptr<expression>> parameters{};
+    node_ptr<statement> body{};
+    usize num_slots{};
 };
 
 class fn_expression : public expression {
 public:
     fn_expression() {}
-    fn_expression(const token::token& tok) : token{tok} {}
-    fn_expression(const fn_expression& other);
+    fn_expression(source_span span) : span{span} {}
 
     auto expression_node() const -> void override {}
-    auto clone() const -> std::unique_ptr<expression> override;
+    inline auto type() const -> node_type override {
+        return node_type::FnExpression;
+    }
     auto token_literal() const -> std::string override;
     auto to_string() const -> std::string override;
 
 public:
-    token::token token{};
-    std::vector<std::unique_ptr<expression>> parameters{};
-    std::unique_ptr<statement> body{};
+    source_span span{};
+    std::shared_ptr<fn_prototype> prototype{std::make_shared<fn_prototype>()};
 };
 
 class call_expression : public expression {
 public:
     call_expression() {}
-    call_expression(const token::token& tok, std::unique_ptr<expression> fn) : token{tok}, fn{std::move(fn)} {}
-    call_expression(const call_expression& other);
+    call_expression(source_span span, node_ptr<expression> fn) : span{span}, fn{std::move(fn)} {}
 
     auto expression_node() const -> void override {}
-    auto clone() const -> std::unique_ptr<expression> override;
+    inline auto type() const -> node_type override {
+        return node_type::CallExpression;
+    }
     auto token_literal() const -> std::string override;
     auto to_string() const -> std::string override;
 
 public:
-    token::token token{};
-    std::unique_ptr<expression> fn{};
-    std::vector<std::unique_ptr<expression>> arguments{};
+    source_span span{};
+    node_ptr<expression> fn{};
+    std::vector<node_ptr<expression>> arguments{};
 };
 
 class string_literal : public expression {
 public:
     string_literal() {}
-    string_literal(const token::token& tok, const std::string& val) : token{tok}, value{val} {}
+    string_literal(source_span span, std::string_view val) : span{span}, value{val} {}
 
     auto expression_node() const -> void override {}
-    auto clone() const -> std::unique_ptr<expression> override;
+    inline auto type() const -> node_type override {
+        return node_type::StringLiteral;
+    }
     auto token_literal() const -> std::string override;
     auto to_string() const -> std::string override;
 
 public:
-    token::token token{};
-    std::string value{};
+    source_span span{};
+    std::string_view value{};
 };
 
 class array_literal : public expression {
 public:
     array_literal() {}
-    array_literal(const token::token& tok) : token{tok} {}
-    array_literal(const array_literal& other);
+    array_literal(source_span span) : span{span} {}
 
     auto expression_node() const -> void override {}
-    auto clone() const -> std::unique_ptr<expression> override;
+    inline auto type() const -> node_type override {
+        return node_type::ArrayLiteral;
+    }
     auto token_literal() const -> std::string override;
     auto to_string() const -> std::string override;
 
 public:
-    token::token token{};
-    std::vector<std::unique_ptr<expression>> elements{};
+    source_span span{};
+    std::vector<node_ptr<expression>> elements{};
 };
 
 class index_expression : public expression {
 public:
     index_expression() {}
-    index_expression(const token::token& tok, std::unique_ptr<expression> l) : token{tok}, left{std::move(l)} {}
-    index_expression(const index_expression& other)
-        : token{other.token}, left{other.left->clone()}, index{other.index->clone()} {}
+    index_expression(source_span span, node_ptr<expression> l) : span{span}, left{std::move(l)} {}
 
     auto expression_node() const -> void override {}
-    auto clone() const -> std::unique_ptr<expression> override;
+    inline auto type() const -> node_type override {
+        return node_type::IndexExpression;
+    }
     auto token_literal() const -> std::string override;
     auto to_string() const -> std::string override;
 
 public:
-    token::token token{};
-    std::unique_ptr<expression> left{};
-    std::unique_ptr<expression> index{};
+    source_span span{};
+    node_ptr<expression> left{};
+    node_ptr<expression> index{};
 };
 
 class hash_literal : public expression {
 public:
     hash_literal() {}
-    hash_literal(const token::token& tok) : token{tok} {}
-    hash_literal(const hash_literal& other);
+    hash_literal(source_span span) : span{span} {}
 
     auto expression_node() const -> void override {}
-    auto clone() const -> std::unique_ptr<expression> override;
+    inline auto type() const -> node_type override {
+        return node_type::HashLiteral;
+    }
     auto token_literal() const -> std::string override;
     auto to_string() const -> std::string override;
 
 public:
-    token::token token{};
-    std::unordered_map<std::unique_ptr<expression>, std::unique_ptr<expression>> pairs{};
+    source_span span{};
+    std::unordered_map<node_ptr<expression>, node_ptr<expression>> pairs{};
 };
 
 class assign_expression : public expression {
 public:
     assign_expression() {}
-    assign_expression(const token::token& tok, std::unique_ptr<expression> n) : token{tok}, name{std::move(n)} {}
-    assign_expression(const assign_expression& other)
-        : token{other.token}, name{other.name->clone()}, value{other.value->clone()} {}
+    assign_expression(source_span span, node_ptr<expression> n) : span{span}, name{std::move(n)} {}
 
     auto expression_node() const -> void override {}
-    auto clone() const -> std::unique_ptr<expression> override;
+    inline auto type() const -> node_type override {
+        return node_type::AssignExpression;
+    }
     auto token_literal() const -> std::string override;
     auto to_string() const -> std::string override;
 
 public:
-    token::token token{};
-    std::unique_ptr<expression> name{};
-    std::unique_ptr<expression> value{};
+    source_span span{};
+    node_ptr<expression> name{};
+    node_ptr<expression> value{};
 };
 
 class while_statement : public statement {
 public:
-    while_statement(const token::token& tok) : token{tok} {}
-    while_statement(const while_statement& other)
-        : token{other.token}, condition{other.condition->clone()}, body{other.body->clone()} {}
+    while_statement(source_span span) : span{span} {}
 
     auto statement_node() const -> void override {};
-    auto clone() const -> std::unique_ptr<statement> override;
+    inline auto type() const -> node_type override {
+        return node_type::WhileStatement;
+    }
     auto token_literal() const -> std::string override;
     auto to_string() const -> std::string override;
 
 public:
-    token::token token{};
-    std::unique_ptr<expression> condition{};
-    std::unique_ptr<statement> body{};
+    source_span span{};
+    node_ptr<expression> condition{};
+    node_ptr<statement> body{};
+    usize num_slots{};
 };
 
 class break_statement : public statement {
 public:
-    break_statement(const token::token& tok) : token{tok} {}
+    break_statement(source_span span) : span{span} {}
 
     auto statement_node() const -> void override {};
-    auto clone() const -> std::unique_ptr<statement> override;
+    inline auto type() const -> node_type override {
+        return node_type::BreakStatement;
+    }
     auto token_literal() const -> std::string override;
     auto to_string() const -> std::string override;
 
 public:
-    token::token token{};
+    source_span span{};
 };
 
 class continue_statement : public statement {
 public:
-    continue_statement(const token::token& tok) : token{tok} {}
+    continue_statement(source_span span) : span{span} {}
 
     auto statement_node() const -> void override {};
-    auto clone() const -> std::unique_ptr<statement> override;
+    inline auto type() const -> node_type override {
+        return node_type::ContinueStatement;
+    }
     auto token_literal() const -> std::string override;
     auto to_string() const -> std::string override;
 
 public:
-    token::token token{};
+    source_span span{};
 };
 
+auto for_each_child(node& parent, const std::function<void(node&)>& fn) -> void;
+auto for_each_child(const node& parent, const std::function<void(const node&)>& fn) -> void;
+
+// Calls `fn` on `root` and everything below it, parents before their children. The children of a node are skipped
+// when `fn` returns false for it. Keeps its own stack, so trees of any depth can be walked.
+auto walk(const node& root, const std::function<bool(const node&)>& fn) -> void;
+
+// `expr` and the infix expressions down its left operands, outermost first. A left-associative chain like `a + b + c`
+// is as deep as it is long and the parser does not limit its length, so passes loop over it with this instead of
+// recursing into the left operand.
+auto left_spine(infix_expression& expr) -> std::vector<infix_expression*>;
+auto left_spine(const infix_expression& expr) -> std::vector<const infix_expression*>;
+
 }
 
 }
@@ -0,0 +1,287 @@
+#include "builtins.h"
+#include "helpers.h"
+#include "object.h"
+
+#include <format>
+#include <iostream>
+#include <print>
+#include <random>
+#include <span>
+#include <string>
+#include <string_view>
+
+namespace interp {
+
+namespace builtins {
+
+static auto len_builtin(std::span<const object::value> args) -> object::value {
+    if (args.size() != 1) {
+        return object::make<object::error>(std::format("wrong number of arguments. got: {}, want: 1", args.size()));
+    }
+
+    if (args[0].type() == object::object_type::String) {
+        auto& str{args[0].as<object::string>()};
+        return object::value::integer(static_cast<i64>(str.value.size()));
+    } else if (args[0].type() == object::object_type::Array) {
+        auto& arr{args[0].as<object::array>()};
+        return object::value::integer(static_cast<i64>(arr.elements.size()));
+    }
+
+    return object::make<object::error>(
+        std::format("argument to 'len' not supported, got: {}", object::get_object_type_string(args[0].type()))
+    );
+}
+
+static auto first_builtin(std::span<const object::value> args) -> object::value {
+    if (args.size() != 1) {
+        return object::make<object::error>(std::format("wrong number of arguments. got: {}, want: 1", args.size()));
+    }
+
+    if (args[0].type() == object::object_type::Array) {
+        auto& arr{args[0].as<object::array>()};
+        if (arr.elements.size() < 1) {
+            return object::value::null();
+        }
+        return arr.elements.front();
+    }
+
+    return object::make<object::error>(
+        std::format("argument to 'first' must be Array, got {}", object::get_object_type_string(args[0].type()))
+    );
+}
+
+static auto last_builtin(std::span<const object::value> args) -> object::value {
+    if (args.size() != 1) {
+        return object::make<object::error>(std::format("wrong number of arguments. got: {}, want: 1", args.size()));
+    }
+
+    if (args[0].type() == object::object_type::Array) {
+        auto& arr{args[0].as<object::array>()};
+        if (arr.elements.size() < 1) {
+            return object::value::null();
+        }
+        return arr.elements.back();
+    }
+
+    return object::make<object::error>(
+        std::format("argument to 'last' must be Array, got {}", object::get_object_type_string(args[0].type()))
+    );
+}
+
+static auto rest_builtin(std::span<const object::value> args) -> object::value {
+    if (args.size() != 1) {
+        return object::make<object::error>(std::format("wrong number of arguments. got: {}, want: 1", args.size()));
+    }
+
+    if (args[0].type() == object::object_type::Array) {
+        auto& arr{args[0].as<object::array>()};
+        if (arr.elements.size() < 1) {
+            return object::value::null();
+        }
+
+        return object::make<object::array>(arr.elements.pop_front());
+    }
+
+    return object::make<object::error>(
+        std::format("argument to 'rest' must be Array, got {}", object::get_object_type_string(args[0].type()))
+    );
+}
+
+static auto push_builtin(std::span<const object::value> args) -> object::value {
+    if (args.size() != 2) {
+        return object::make<object::error>(std::format("wrong number of arguments. got: {}, want: 2", args.size()));
+    }
+
+    if (args[0].type() == object::object_type::Array) {
+        auto& arr{args[0].as<object::array>()};
+
+        return object::make<object::array>(arr.elements.push_back(args[1]));
+    }
+
+    return object::make<object::error>(
+        std::format("argument to 'push' must be Array, got {}", object::get_object_type_string(args[0].type()))
+    );
+}
+
+static auto puts_builtin(std::span<const object::value> args) -> object::value {
+    if (args.size() <= 0) {
+        return object::make<object::error>(std::format("wrong number of arguments. needs at least one"));
+    }
+
+    for (const auto& arg : args) {
+        switch (arg.type()) {
+        case object::object_type::String: {
+            auto& str{arg.as<object::string>()};
+            std::println("{}", str.value);
+        } break;
+
+        default: {
+            std::println("{}", arg.to_string());
+        } break;
+        }
+    }
+
+    return object::value::null();
+}
+
+static auto rand_builtin(std::span<const object::value> args) -> object::value {
+    if (args.size() != 2) {
+        return object::make<object::error>(std::format("wrong number of arguments. got: {}, want: 2", args.size()));
+    }
+
+    if (args[0].type() != object::object_type::Integer || args[1].type() != object::object_type::Integer) {
+        return object::make<object::error>(std::format(
+            "all arguments to 'rand()' have to be Integers, got: {}, {}",
+            object::get_object_type_string(args[0].type()),
+            object::get_object_type_string(args[1].type())
+        ));
+    }
+
+    auto int1{args[0].as_integer()};
+    auto int2{args[1].as_integer()};
+
+    i64 min{};
+    i64 max{};
+    if (int1 >= int2) {
+        min = int2;
+        max = int1;
+    } else {
+        min = int1;
+        max = int2;
+    }
+
+    std::random_device rd{};
+    std::mt19937_64 generator{rd()};
+    std::uniform_int_distribution<i64> dist(min, max);
+
+    return object::value::integer(dist(generator));
+}
+
+static auto gets_builtin(std::span<const object::value> args) -> object::value {
+    if (args.size() != 0) {
+        return object::make<object::error>(std::format("wrong number of arguments. got: {}, want: 0", args.size()));
+    }
+
+    std::string line{};
+    std::getline(std::cin, line);
+
+    return object::make<object::string>(line);
+}
+
+static auto to_string_builtin(std::span<const object::value> args) -> object::value {
+    if (args.size() != 1) {
+        return object::make<object::error>(std::format("wrong number of arguments. got: {}, want: 1", args.size()));
+    }
+
+    return object::make<object::string>(args[0].to_string());
+}
+
+static auto parse_int_builtin(std::span<const object::value> args) -> object::value {
+    if (args.size() != 1) {
+        return object::make<object::error>(std::format("wrong number of arguments. got: {}, want: 1", args.size()));
+    }
+
+    if (args[0].type() != object::object_type::String) {
+        return object::make<object::error>(std::format(
+            "argument to 'parse_int()' has to be String, got {}",
+            object::get_object_type_string(args[0].type())
+        ));
+    }
+
+    auto& str{args[0].as<object::string>().value};
+
+    // Surrounding whitespace is allowed, so lines read with gets() parse as typed.
+    std::string_view digits{str};
+    auto first{digits.find_first_not_of(" \t\n\v\f\r")};
+    digits = first == std::string_view::npos ? std::string_view{} : digits.substr(first);
+    digits = digits.substr(0, digits.find_last_not_of(" \t\n\v\f\r") + 1);
+
+    i64 value{};
+    if (auto ec{helpers::parse_i64(digits, value)}; ec == std::errc::result_out_of_range) {
+        return object::make<object::error>(
+            std::format("argument to function 'parse_int()' is out of range, got {}", str)
+        );
+    } else if (ec != std::errc{}) {
+        return object::make<object::error>(std::format("invalid argument to function 'parse_int()', got {}", str));
+    }
+
+    return object::value::integer(value);
+}
+
+static auto set_builtin(std::span<const object::value> args) -> object::value {
+    if (args.size() != 3) {
+        return object::make<object::error>(std::format("wrong number of arguments. got: {}, want: 3", args.size()));
+    }
+
+    if (args[0].type() != object::object_type::Hash) {
+        return object::make<object::error>(
+            std::format("argument to 'set' must be Hash, got {}", object::get_object_type_string(args[0].type()))
+        );
+    }
+
+    if (!args[1].is_hashable()) {
+        return object::make<object::error>(
+            std::format("unusable as hash key: {}", object::get_object_type_string(args[1].type()))
+        );
+    }
+
+    auto& hash{args[0].as<object::hash>()};
+
+    return object::make<object::hash>(hash.pairs.insert(args[1].get_hash_key(), std::make_pair(args[1], args[2])));
+}
+
+static auto delete_builtin(std::span<const object::value> args) -> object::value {
+    if (args.size() != 2) {
+        return object::make<object::error>(std::format("wrong number of arguments. got: {}, want: 2", args.size()));
+    }
+
+    if (args[0].type() != object::object_type::Hash) {
+        return object::make<object::error>(
+            std::format("argument to 'delete' must be Hash, got {}", object::get_object_type_string(args[0].type()))
+        );
+    }
+
+    if (!args[1].is_hashable()) {
+        return object::make<object::error>(
+            std::format("unusable as hash key: {}", object::get_object_type_string(args[1].type()))
+        );
+    }
+
+    auto& hash{args[0].as<object::hash>()};
+
+    return object::make<object::hash>(hash.pairs.erase(args[1].get_hash_key()));
+}
+
+const std::vector<definition> definitions{
+    {"len",       {len_builtin}      },
+    {"first",     {first_builtin}    },
+    {"last",      {last_builtin}     },
+    {"rest",      {rest_builtin}     },
+    {"push",      {push_builtin}     },
+    {"puts",      {puts_builtin}     },
+    {"rand",      {rand_builtin}     },
+    {"gets",      {gets_builtin}     },
+    {"to_string", {to_string_builtin}},
+    {"parse_int", {parse_int_builtin}},
+    {"set",       {set_builtin}      },
+    {"delete",    {delete_builtin}   },
+};
+
+// Builtins are never freed, so they are not allocated on the heap.
+auto get(usize index) -> object::value {
+    return object::value{const_cast<object::builtin*>(&definitions[index].builtin)};
+}
+
+auto lookup(std::string_view name) -> object::value {
+    for (usize i{0}; i < definitions.size(); i++) {
+        if (definitions[i].name == name) {
+            return get(i);
+        }
+    }
+
+    return {};
+}
+
+}
+
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include "object.h"
+
+#include <string_view>
+#include <vector>
+
+namespace interp {
+
+namespace builtins {
+
+class definition {
+public:
+    std::string_view name{};
+    object::builtin builtin{};
+};
+
+extern const std::vector<definition> definitions;
+
+auto get(usize index) -> object::value;
+auto lookup(std::string_view name) -> object::value;
+
+}
+
+}
@@ -0,0 +1,143 @@
+#include "code.h"
+
+#include <array>
+#include <format>
+#include <sstream>
+
+namespace interp {
+
+namespace code {
+
+static const auto definitions = std::to_array<definition>({
+    {"OpConstant",      {4}   },
+    {"OpPop",           {}    },
+    {"OpAdd",           {}    },
+    {"OpSub",           {}    },
+    {"OpMul",           {}    },
+    {"OpDiv",           {}    },
+    {"OpTrue",          {}    },
+    {"OpFalse",         {}    },
+    {"OpNull",          {}    },
+    {"OpEqual",         {}    },
+    {"OpNotEqual",      {}    },
+    {"OpGreaterThan",   {}    },
+    {"OpLessThan",      {}    },
+    {"OpMinus",         {}    },
+    {"OpBang",          {}    },
+    {"OpJumpNotTruthy", {4}   },
+    {"OpJump",          {4}   },
+    {"OpGetGlobal",     {2}   },
+    {"OpSetGlobal",     {2}   },
+    {"OpAssignGlobal",  {2}   },
+    {"OpGetLocal",      {1}   },
+    {"OpSetLocal",      {1}   },
+    {"OpNewCell",       {1}   },
+    {"OpGetDeref",      {1}   },
+    {"OpSetDeref",      {1}   },
+    {"OpGetFree",       {1}   },
+    {"OpSetFree",       {1}   },
+    {"OpLoadFree",      {1}   },
+    {"OpGetBuiltin",    {1}   },
+    {"OpArray",         {4}   },
+    {"OpHash",          {4}   },
+    {"OpIndex",         {}    },
+    {"OpCall",          {1}   },
+    {"OpReturnValue",   {}    },
+    {"OpReturn",        {}    },
+    {"OpClosure",       {4, 1}},
+});
+
+static_assert(definitions.size() == static_cast<usize>(opcode::Closure) + 1);
+
+auto lookup(opcode op) -> const definition& {
+    return definitions[static_cast<usize>(op)];
+}
+
+auto make(opcode op, std::initializer_list<usize> operands) -> instructions {
+    const auto& def{lookup(op)};
+
+    usize len{1};
+    for (auto w : def.operand_widths) {
+        len += w;
+    }
+
+    instructions ins(len);
+    ins[0] = static_cast<u8>(op);
+
+    usize offset{1};
+    for (usize i{0}; auto operand : operands) {
+        auto width{def.operand_widths[i++]};
+        for (usize b{0}; b < width; b++) {
+            ins[offset + b] = static_cast<u8>(operand >> (8 * (width - b - 1)));
+        }
+        offset += width;
+    }
+
+    return ins;
+}
+
+auto read_operands(const definition& def, std::span<const u8> ins) -> std::pair<std::vector<usize>, usize> {
+    std::vector<usize> operands{};
+    usize offset{0};
+
+    for (auto width : def.operand_widths) {
+        switch (width) {
+        case 1:
+            operands.push_back(read_u8(ins.subspan(offset)));
+            break;
+        case 2:
+            operands.push_back(read_u16(ins.subspan(offset)));
+            break;
+        case 4:
+            operands.push_back(read_u32(ins.subspan(offset)));
+            break;
+        }
+
+        offset += width;
+    }
+
+    return {operands, offset};
+}
+
+auto read_u8(std::span<const u8> ins) -> u8 {
+    return ins[0];
+}
+
+auto read_u16(std::span<const u8> ins) -> u16 {
+    return static_cast<u16>((ins[0] << 8) | ins[1]);
+}
+
+auto read_u32(std::span<const u8> ins) -> u32 {
+    return (static_cast<u32>(ins[0]) << 24) | (static_cast<u32>(ins[1]) << 16) | (static_cast<u32>(ins[2]) << 8) |
+           static_cast<u32>(ins[3]);
+}
+
+auto to_string(const instructions& ins) -> std::string {
+    std::stringstream ss{};
+
+    usize i{0};
+    while (i < ins.size()) {
+        if (ins[i] >= definitions.size()) {
+            ss << std::format("ERROR: opcode {} undefined\n", ins[i]);
+            i++;
+            continue;
+        }
+
+        const auto& def{definitions[ins[i]]};
+        auto [operands, read]{read_operands(def, std::span{ins}.subspan(i + 1))};
+
+        ss << std::format("{:04} {}", i, def.name);
+        for (auto operand : operands) {
+            ss << " " << operand;
+        }
+        ss << "\n";
+
+        i += 1 + read;
+    }
+
+    return ss.str();
+}
+
+}
+
+}
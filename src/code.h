@@ -0,0 +1,88 @@
+#pragma once
+
+#include "types.h"
+
+#include <initializer_list>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace interp {
+
+namespace code {
+
+using instructions = std::vector<u8>;
+
+enum class opcode : u8 {
+    Constant,
+    Pop,
+
+    Add,
+    Sub,
+    Mul,
+    Div,
+
+    True,
+    False,
+    Null,
+
+    Equal,
+    NotEqual,
+    GreaterThan,
+    LessThan,
+
+    Minus,
+    Bang,
+
+    JumpNotTruthy,
+    Jump,
+
+    GetGlobal,
+    SetGlobal,
+    AssignGlobal,
+
+    GetLocal,
+    SetLocal,
+
+    NewCell,
+    GetDeref,
+    SetDeref,
+
+    GetFree,
+    SetFree,
+    LoadFree,
+
+    GetBuiltin,
+
+    Array,
+    Hash,
+    Index,
+
+    Call,
+    ReturnValue,
+    Return,
+
+    Closure,
+};
+
+class definition {
+public:
+    std::string_view name{};
+    std::vector<u8> operand_widths{};
+};
+
+auto lookup(opcode op) -> const definition&;
+
+auto make(opcode op, std::initializer_list<usize> operands = {}) -> instructions;
+auto read_operands(const definition& def, std::span<const u8> ins) -> std::pair<std::vector<usize>, usize>;
+
+auto read_u8(std::span<const u8> ins) -> u8;
+auto read_u16(std::span<const u8> ins) -> u16;
+auto read_u32(std::span<const u8> ins) -> u32;
+
+auto to_string(const instructions& ins) -> std::string;
+
+}
+
+}
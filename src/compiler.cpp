@@ -0,0 +1,633 @@
+#include "compiler.h"
+#include "ast.h"
+#include "builtins.h"
+#include "code.h"
+#include "object.h"
+
+#include <format>
+#include <functional>
+#include <limits>
+
+namespace interp {
+
+namespace compiler {
+
+static constexpr usize max_locals{std::numeric_limits<u8>::max() + 1};
+static constexpr usize max_globals{std::numeric_limits<u16>::max() + 1};
+static constexpr usize max_args{std::numeric_limits<u8>::max()};
+
+auto symbol_table::define(const std::string& name) -> symbol {
+    if (auto it{store.find(name)}; it != store.end()) {
+        if (it->second.scope == symbol_scope::Global || it->second.scope == symbol_scope::Local) {
+            return it->second;
+        }
+    }
+
+    if (auto it{reserved.find(name)}; it != reserved.end()) {
+        auto sym{it->second};
+        reserved.erase(it);
+        store[name] = sym;
+
+        return sym;
+    }
+
+    symbol sym{name};
+    if (outer == nullptr) {
+        sym.scope = symbol_scope::Global;
+        sym.index = global_names.size();
+        global_names.push_back(name);
+    } else {
+        sym.scope = symbol_scope::Local;
+        sym.index = frame->num_locals++;
+        sym.boxed = frame->captured.contains(name);
+    }
+
+    store[name] = sym;
+
+    return sym;
+}
+
+auto symbol_table::reserve(const std::string& name) -> symbol {
+    if (auto it{reserved.find(name)}; it != reserved.end()) {
+        return it->second;
+    }
+
+    symbol sym{name, symbol_scope::Local, frame->num_locals++, true};
+    reserved[name] = sym;
+
+    return sym;
+}
+
+auto symbol_table::define_builtin(usize index, const std::string& name) -> symbol {
+    symbol sym{name, symbol_scope::Builtin, index};
+    store[name] = sym;
+
+    return sym;
+}
+
+auto symbol_table::define_free(const symbol& original) -> symbol {
+    free_symbols.push_back(original);
+
+    symbol sym{original.name, symbol_scope::Free, free_symbols.size() - 1, true};
+    store[original.name] = sym;
+
+    return sym;
+}
+
+auto symbol_table::resolve(const std::string& name) -> std::optional<symbol> {
+    if (auto it{store.find(name)}; it != store.end()) {
+        return it->second;
+    }
+
+    if (outer == nullptr) {
+        return std::nullopt;
+    }
+
+    auto sym{outer->resolve(name)};
+    if (!sym || block || sym->scope == symbol_scope::Global || sym->scope == symbol_scope::Builtin) {
+        return sym;
+    }
+
+    return define_free(*sym);
+}
+
+state::state() {
+    for (usize i{0}; i < builtins::definitions.size(); i++) {
+        symbols.define_builtin(i, std::string{builtins::definitions[i].name});
+    }
+
+    object::get_heap().add_roots(constants);
+}
+
+state::~state() {
+    object::get_heap().remove_roots(constants);
+}
+
+static auto collect_identifiers(const ast::node& node, std::unordered_set<std::string>& names) -> void {
+    ast::walk(node, [&](const ast::node& n) {
+        if (n.type() == ast::node_type::Identifier) {
+            names.insert(std::string{static_cast<const ast::identifier&>(n).value});
+        }
+
+        return true;
+    });
+}
+
+// Names used inside function literals nested in `node`. Locals with one of these names get stored in cells,
+// so closures share them with the scope that declared them.
+static auto collect_captured(const ast::node& node, std::unordered_set<std::string>& names) -> void {
+    ast::walk(node, [&](const ast::node& n) {
+        if (n.type() == ast::node_type::FnExpression) {
+            collect_identifiers(n, names);
+            return false;
+        }
+
+        return true;
+    });
+}
+
+// Names declared by `let` in the scope of `node`. While bodies and function literals open their own scope.
+static auto collect_lets(const ast::node& node, std::vector<std::string>& names) -> void {
+    ast::walk(node, [&](const ast::node& n) {
+        switch (n.type()) {
+        case ast::node_type::LetStatement: {
+            names.push_back(std::string{static_cast<const ast::let_statement&>(n).name.value});
+        } break;
+
+        case ast::node_type::WhileStatement: {
+            collect_lets(*static_cast<const ast::while_statement&>(n).condition, names);
+            return false;
+        } break;
+
+        case ast::node_type::FnExpression: {
+            return false;
+        } break;
+
+        default: {
+        } break;
+        }
+
+        return true;
+    });
+}
+
+auto compiler::compile(const ast::program& program) -> void {
+    enter_scope();
+
+    symbols->num_locals = 0;
+    symbols->captured.clear();
+    collect_captured(program, symbols->captured);
+
+    for (usize i{0}; i < program.statements.size(); i++) {
+        const auto& stmt{*program.statements[i]};
+
+        if (i == program.statements.size() - 1) {
+            if (stmt.type() == ast::node_type::ExpressionStatement) {
+                if (const auto& expr{static_cast<const ast::expression_statement&>(stmt).expr}) {
+                    compile_expr(*expr);
+                    emit(code::opcode::ReturnValue);
+                    break;
+                }
+            }
+        }
+
+        compile_stmt(stmt);
+    }
+
+    emit(code::opcode::Return);
+
+    if (symbols->num_locals > max_locals) {
+        errors.push_back("too many local variables");
+    }
+
+    main_locals = symbols->num_locals;
+    main_instructions = leave_scope();
+}
+
+auto compiler::get_bytecode() const -> bytecode {
+    return {
+        object::compiled_function{main_instructions, main_locals, 0},
+        st.constants,
+        st.symbols.global_names,
+    };
+}
+
+auto compiler::compile_stmt(const ast::statement& stmt) -> void {
+    switch (stmt.type()) {
+    case ast::node_type::ExpressionStatement: {
+        if (const auto& expr{static_cast<const ast::expression_statement&>(stmt).expr}) {
+            compile_expr(*expr);
+            emit(code::opcode::Pop);
+        }
+    } break;
+
+    case ast::node_type::LetStatement: {
+        auto& let{static_cast<const ast::let_statement&>(stmt)};
+
+        // A function is defined before its value is compiled so it can call itself, anything else only after.
+        auto name{std::string{let.name.value}};
+        if (let.value->type() == ast::node_type::FnExpression) {
+            symbols->define(name);
+        }
+
+        compile_expr(*let.value);
+        store_symbol(symbols->define(name), false);
+    } break;
+
+    case ast::node_type::ReturnStatement: {
+        compile_expr(*static_cast<const ast::return_statement&>(stmt).value);
+        emit(code::opcode::ReturnValue);
+    } break;
+
+    case ast::node_type::WhileStatement: {
+        compile_while(static_cast<const ast::while_statement&>(stmt));
+    } break;
+
+    case ast::node_type::BreakStatement: {
+        auto& loops{scopes.back().loops};
+        if (loops.empty()) {
+            errors.push_back("break statement is illegal in current context");
+            return;
+        }
+
+        loops.back().breaks.push_back(emit(code::opcode::Jump, {0}));
+    } break;
+
+    case ast::node_type::ContinueStatement: {
+        auto& loops{scopes.back().loops};
+        if (loops.empty()) {
+            errors.push_back("continue statement is illegal in current context");
+            return;
+        }
+
+        emit(code::opcode::Jump, {loops.back().start});
+    } break;
+
+    case ast::node_type::BlockStatement: {
+        for (const auto& s : static_cast<const ast::block_statement&>(stmt).statements) {
+            compile_stmt(*s);
+        }
+    } break;
+
+    default: {
+    } break;
+    }
+}
+
+auto compiler::compile_expr(const ast::expression& expr) -> void {
+    switch (expr.type()) {
+    case ast::node_type::IntegerLiteral: {
+        auto value{static_cast<const ast::integer_literal&>(expr).value};
+        emit(code::opcode::Constant, {add_constant(object::value::integer(value))});
+    } break;
+
+    case ast::node_type::BooleanExpression: {
+        emit(static_cast<const ast::boolean_expression&>(expr).value ? code::opcode::True : code::opcode::False);
+    } break;
+
+    case ast::node_type::StringLiteral: {
+        auto value{static_cast<const ast::string_literal&>(expr).value};
+        emit(code::opcode::Constant, {add_constant(object::make<object::string>(std::string{value}))});
+    } break;
+
+    case ast::node_type::Identifier: {
+        load_symbol(resolve(std::string{static_cast<const ast::identifier&>(expr).value}));
+    } break;
+
+    case ast::node_type::PrefixExpression: {
+        auto& n{static_cast<const ast::prefix_expression&>(expr)};
+        compile_expr(*n.right);
+
+        switch (n.oper) {
+        case ast::operator_type::Bang:
+            emit(code::opcode::Bang);
+            break;
+        case ast::operator_type::Minus:
+            emit(code::opcode::Minus);
+            break;
+        default:
+            errors.push_back(std::format("unknown operator {}", ast::get_operator_string(n.oper)));
+            break;
+        }
+    } break;
+
+    case ast::node_type::InfixExpression: {
+        auto spine{ast::left_spine(static_cast<const ast::infix_expression&>(expr))};
+        compile_expr(*spine.back()->left);
+        for (auto it{spine.rbegin()}; it != spine.rend(); it++) {
+            compile_expr(*(*it)->right);
+            compile_operator((*it)->oper);
+        }
+    } break;
+
+    case ast::node_type::IfExpression: {
+        auto& n{static_cast<const ast::if_expression&>(expr)};
+        compile_expr(*n.condition);
+        auto jump_not_truthy{emit(code::opcode::JumpNotTruthy, {0})};
+
+        compile_block_value(static_cast<const ast::block_statement&>(*n.consequence));
+        auto jump{emit(code::opcode::Jump, {0})};
+
+        change_operand(jump_not_truthy, current_instructions().size());
+
+        if (n.alternative) {
+            compile_block_value(static_cast<const ast::block_statement&>(*n.alternative));
+        } else {
+            emit(code::opcode::Null);
+        }
+
+        change_operand(jump, current_instructions().size());
+    } break;
+
+    case ast::node_type::FnExpression: {
+        compile_fn(static_cast<const ast::fn_expression&>(expr));
+    } break;
+
+    case ast::node_type::CallExpression: {
+        auto& n{static_cast<const ast::call_expression&>(expr)};
+        compile_expr(*n.fn);
+        for (const auto& arg : n.arguments) {
+            compile_expr(*arg);
+        }
+
+        if (n.arguments.size() > max_args) {
+            errors.push_back("too many arguments in function call");
+        }
+
+        emit(code::opcode::Call, {n.arguments.size()});
+    } break;
+
+    case ast::node_type::ArrayLiteral: {
+        auto& n{static_cast<const ast::array_literal&>(expr)};
+        for (const auto& elem : n.elements) {
+            compile_expr(*elem);
+        }
+
+        emit(code::opcode::Array, {n.elements.size()});
+    } break;
+
+    case ast::node_type::HashLiteral: {
+        auto& n{static_cast<const ast::hash_literal&>(expr)};
+        for (const auto& [key, val] : n.pairs) {
+            compile_expr(*key);
+            compile_expr(*val);
+        }
+
+        emit(code::opcode::Hash, {n.pairs.size() * 2});
+    } break;
+
+    case ast::node_type::IndexExpression: {
+        auto& n{static_cast<const ast::index_expression&>(expr)};
+        compile_expr(*n.left);
+        compile_expr(*n.index);
+        emit(code::opcode::Index);
+    } break;
+
+    case ast::node_type::AssignExpression: {
+        auto& n{static_cast<const ast::assign_expression&>(expr)};
+        auto& ident{static_cast<const ast::identifier&>(*n.name)};
+        auto sym{resolve(std::string{ident.value})};
+        if (sym.scope == symbol_scope::Builtin) {
+            errors.push_back(std::format("variable {} does not exist yet", ident.value));
+            return;
+        }
+
+        compile_expr(*n.value);
+        store_symbol(sym, true);
+        load_symbol(sym);
+    } break;
+
+    default: {
+    } break;
+    }
+}
+
+auto compiler::compile_operator(ast::operator_type oper) -> void {
+    switch (oper) {
+    case ast::operator_type::Plus:
+        emit(code::opcode::Add);
+        break;
+    case ast::operator_type::Minus:
+        emit(code::opcode::Sub);
+        break;
+    case ast::operator_type::Asterisk:
+        emit(code::opcode::Mul);
+        break;
+    case ast::operator_type::Slash:
+        emit(code::opcode::Div);
+        break;
+    case ast::operator_type::Gt:
+        emit(code::opcode::GreaterThan);
+        break;
+    case ast::operator_type::Lt:
+        emit(code::opcode::LessThan);
+        break;
+    case ast::operator_type::Eq:
+        emit(code::opcode::Equal);
+        break;
+    case ast::operator_type::NotEq:
+        emit(code::opcode::NotEqual);
+        break;
+    default:
+        errors.push_back(std::format("unknown operator {}", ast::get_operator_string(oper)));
+        break;
+    }
+}
+
+auto compiler::compile_block_value(const ast::block_statement& block) -> void {
+    if (block.statements.empty()) {
+        emit(code::opcode::Null);
+        return;
+    }
+
+    for (usize i{0}; i < block.statements.size() - 1; i++) {
+        compile_stmt(*block.statements[i]);
+    }
+
+    const auto& last{*block.statements.back()};
+    const ast::expression* value{};
+    if (last.type() == ast::node_type::ExpressionStatement) {
+        value = static_cast<const ast::expression_statement&>(last).expr.get();
+    }
+
+    if (value) {
+        compile_expr(*value);
+    } else {
+        compile_stmt(last);
+        emit(code::opcode::Null);
+    }
+}
+
+auto compiler::compile_fn(const ast::fn_expression& fn) -> void {
+    enter_scope();
+    enter_table(false);
+
+    collect_captured(*fn.prototype->body, symbols->captured);
+
+    for (const auto& param : fn.prototype->parameters) {
+        auto sym{symbols->define(std::string{static_cast<const ast::identifier&>(*param).value})};
+        if (sym.boxed) {
+            emit(code::opcode::GetLocal, {sym.index});
+            emit(code::opcode::NewCell, {sym.index});
+            emit(code::opcode::SetDeref, {sym.index});
+        }
+    }
+
+    const auto& body{static_cast<const ast::block_statement&>(*fn.prototype->body)};
+    make_cells(body.statements);
+
+    compile_block_value(body);
+    emit(code::opcode::ReturnValue);
+
+    auto free_symbols{symbols->free_symbols};
+    auto num_locals{symbols->num_locals};
+
+    if (num_locals > max_locals) {
+        errors.push_back("too many local variables");
+    }
+
+    if (free_symbols.size() > std::numeric_limits<u8>::max()) {
+        errors.push_back("too many free variables");
+    }
+
+    leave_table();
+    auto instructions{leave_scope()};
+
+    for (const auto& sym : free_symbols) {
+        if (sym.scope == symbol_scope::Local) {
+            emit(code::opcode::GetLocal, {sym.index});
+        } else {
+            emit(code::opcode::LoadFree, {sym.index});
+        }
+    }
+
+    auto compiled{
+        object::make<object::compiled_function>(std::move(instructions), num_locals, fn.prototype->parameters.size())
+    };
+    emit(code::opcode::Closure, {add_constant(compiled), free_symbols.size()});
+}
+
+auto compiler::compile_while(const ast::while_statement& stmt) -> void {
+    auto start{current_instructions().size()};
+
+    compile_expr(*stmt.condition);
+    auto jump_not_truthy{emit(code::opcode::JumpNotTruthy, {0})};
+
+    enter_table(true);
+    scopes.back().loops.push_back(loop{start});
+
+    const auto& body{static_cast<const ast::block_statement&>(*stmt.body)};
+    make_cells(body.statements);
+
+    for (const auto& s : body.statements) {
+        compile_stmt(*s);
+    }
+
+    emit(code::opcode::Jump, {start});
+
+    auto end{current_instructions().size()};
+    change_operand(jump_not_truthy, end);
+    for (auto pos : scopes.back().loops.back().breaks) {
+        change_operand(pos, end);
+    }
+
+    scopes.back().loops.pop_back();
+    leave_table();
+}
+
+auto compiler::emit(code::opcode op, std::initializer_list<usize> operands) -> usize {
+    auto ins{code::make(op, operands)};
+    auto& current{current_instructions()};
+
+    auto pos{current.size()};
+    current.insert(current.end(), ins.begin(), ins.end());
+
+    return pos;
+}
+
+auto compiler::change_operand(usize pos, usize operand) -> void {
+    auto& current{current_instructions()};
+    auto ins{code::make(static_cast<code::opcode>(current[pos]), {operand})};
+
+    std::ranges::copy(ins, current.begin() + static_cast<std::ptrdiff_t>(pos));
+}
+
+auto compiler::current_instructions() -> code::instructions& {
+    return scopes.back().instructions;
+}
+
+auto compiler::add_constant(object::value val) -> usize {
+    st.constants.push_back(val);
+
+    return st.constants.size() - 1;
+}
+
+auto compiler::enter_scope() -> void {
+    scopes.emplace_back();
+}
+
+auto compiler::leave_scope() -> code::instructions {
+    auto instructions{std::move(scopes.back().instructions)};
+    scopes.pop_back();
+
+    return instructions;
+}
+
+auto compiler::enter_table(bool block) -> void {
+    tables.push_back(std::make_unique<symbol_table>(symbols, block));
+    symbols = tables.back().get();
+}
+
+auto compiler::leave_table() -> void {
+    symbols = symbols->outer;
+    tables.pop_back();
+}
+
+// Lets are defined where they run, but the cells of captured ones are made when the scope is entered, so closures
+// never see a slot without one.
+auto compiler::make_cells(const std::vector<ast::node_ptr<ast::statement>>& stmts) -> void {
+    std::vector<std::string> names{};
+    for (const auto& stmt : stmts) {
+        collect_lets(*stmt, names);
+    }
+
+    for (const auto& name : names) {
+        auto it{symbols->store.find(name)};
+        auto defined{it != symbols->store.end() && it->second.scope == symbol_scope::Local};
+        if (!defined && !symbols->reserved.contains(name) && symbols->frame->captured.contains(name)) {
+            emit(code::opcode::NewCell, {symbols->reserve(name).index});
+        }
+    }
+}
+
+auto compiler::load_symbol(const symbol& sym) -> void {
+    switch (sym.scope) {
+    case symbol_scope::Global:
+        emit(code::opcode::GetGlobal, {sym.index});
+        break;
+    case symbol_scope::Local:
+        emit(sym.boxed ? code::opcode::GetDeref : code::opcode::GetLocal, {sym.index});
+        break;
+    case symbol_scope::Builtin:
+        emit(code::opcode::GetBuiltin, {sym.index});
+        break;
+    case symbol_scope::Free:
+        emit(code::opcode::GetFree, {sym.index});
+        break;
+    }
+}
+
+auto compiler::store_symbol(const symbol& sym, bool assign) -> void {
+    switch (sym.scope) {
+    case symbol_scope::Global:
+        emit(assign ? code::opcode::AssignGlobal : code::opcode::SetGlobal, {sym.index});
+        break;
+    case symbol_scope::Local:
+        emit(sym.boxed ? code::opcode::SetDeref : code::opcode::SetLocal, {sym.index});
+        break;
+    case symbol_scope::Free:
+        emit(code::opcode::SetFree, {sym.index});
+        break;
+    case symbol_scope::Builtin:
+        break;
+    }
+}
+
+// Names that do not resolve are treated as globals that may be defined later on, reading one that never was
+// is a runtime error, same as in the tree-walking evaluator.
+auto compiler::resolve(const std::string& name) -> symbol {
+    if (auto sym{symbols->resolve(name)}) {
+        return *sym;
+    }
+
+    auto sym{st.symbols.define(name)};
+    if (sym.index >= max_globals) {
+        errors.push_back("too many global variables");
+    }
+
+    return sym;
+}
+
+}
+
+}
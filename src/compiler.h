@@ -0,0 +1,144 @@
+#pragma once
+
+#include "ast.h"
+#include "code.h"
+#include "object.h"
+#include "types.h"
+
+#include <memory>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace interp {
+
+namespace compiler {
+
+enum class symbol_scope : u8 {
+    Global,
+    Local,
+    Builtin,
+    Free,
+};
+
+class symbol {
+public:
+    std::string name{};
+    symbol_scope scope{};
+    usize index{};
+    bool boxed{};
+};
+
+// A table is either the global table, a function table or a block table (the body of a while loop).
+// Block tables share the local slots of the nearest function (or of the top level) they are nested in.
+class symbol_table {
+public:
+    symbol_table() : frame{this} {}
+    symbol_table(symbol_table* outer, bool block) : outer{outer}, frame{block ? outer->frame : this}, block{block} {}
+
+    auto define(const std::string& name) -> symbol;
+    // Gives a local that closures capture its slot before the let declaring it, so its cell can be made when the
+    // scope is entered. The name only resolves once it is defined.
+    auto reserve(const std::string& name) -> symbol;
+    auto define_builtin(usize index, const std::string& name) -> symbol;
+    auto resolve(const std::string& name) -> std::optional<symbol>;
+
+private:
+    auto define_free(const symbol& original) -> symbol;
+
+public:
+    symbol_table* outer{};
+    symbol_table* frame{};
+    bool block{};
+
+    std::unordered_map<std::string, symbol> store{};
+    std::unordered_map<std::string, symbol> reserved{};
+    std::vector<symbol> free_symbols{};
+
+    usize num_locals{};
+    std::unordered_set<std::string> captured{};
+
+    std::vector<std::string> global_names{};
+};
+
+// The constants are registered as gc roots for as long as the state is alive.
+class state {
+public:
+    state();
+    state(const state&) = delete;
+    auto operator=(const state&) -> state& = delete;
+    ~state();
+
+public:
+    symbol_table symbols{};
+    std::vector<object::value> constants{};
+};
+
+class bytecode {
+public:
+    object::compiled_function main;
+    const std::vector<object::value>& constants;
+    const std::vector<std::string>& global_names;
+};
+
+class compiler {
+public:
+    compiler(state& s) : st{s}, symbols{&s.symbols} {}
+
+    auto compile(const ast::program& program) -> void;
+    auto get_bytecode() const -> bytecode;
+
+private:
+    class loop {
+    public:
+        usize start{};
+        std::vector<usize> breaks{};
+    };
+
+    class scope {
+    public:
+        code::instructions instructions{};
+        std::vector<loop> loops{};
+    };
+
+    auto compile_stmt(const ast::statement& stmt) -> void;
+    auto compile_expr(const ast::expression& expr) -> void;
+    auto compile_operator(ast::operator_type oper) -> void;
+    auto compile_block_value(const ast::block_statement& block) -> void;
+    auto compile_fn(const ast::fn_expression& fn) -> void;
+    auto compile_while(const ast::while_statement& stmt) -> void;
+
+    auto emit(code::opcode op, std::initializer_list<usize> operands = {}) -> usize;
+    auto change_operand(usize pos, usize operand) -> void;
+    auto current_instructions() -> code::instructions&;
+    auto add_constant(object::value val) -> usize;
+
+    auto enter_scope() -> void;
+    auto leave_scope() -> code::instructions;
+    auto enter_table(bool block) -> void;
+    auto leave_table() -> void;
+
+    auto make_cells(const std::vector<ast::node_ptr<ast::statement>>& stmts) -> void;
+
+    auto load_symbol(const symbol& sym) -> void;
+    auto store_symbol(const symbol& sym, bool assign) -> void;
+    auto resolve(const std::string& name) -> symbol;
+
+public:
+    std::vector<std::string> errors{};
+
+private:
+    state& st;
+    symbol_table* symbols{};
+    std::vector<std::unique_ptr<symbol_table>> tables{};
+    std::vector<scope> scopes{};
+
+    code::instructions main_instructions{};
+    usize main_locals{};
+};
+
+}
+
+}
@@ -1,699 +1,664 @@
 #include "eval.h"
 #include "ast.h"
+#include "builtins.h"
+#include "flat_ast.h"
+#include "helpers.h"
 #include "object.h"
-#include <cassert>
-#include <iostream>
+#include <array>
+#include <cstddef>
 #include <memory>
-#include <print>
-#include <random>
-#include <ranges>
+#include <span>
 #include <string>
-#include <type_traits>
-#include <unordered_map>
+#include <utility>
 #include <vector>
 
 namespace interp {
 
 namespace eval {
 
-static auto len_builtin(std::vector<std::unique_ptr<object::object>> args) -> std::unique_ptr<object::object> {
-    if (args.size() != 1) {
-        return std::make_unique<object::error>(std::format("wrong number of arguments. got: {}, want: 1", args.size()));
-    }
-
-    if (dynamic_cast<object::string*>(args[0].get())) {
-        auto& str{dynamic_cast<object::string&>(*args[0])};
-        return std::make_unique<object::integer>(str.value.size());
-    } else if (dynamic_cast<object::array*>(args[0].get())) {
-        auto& arr{dynamic_cast<object::array&>(*args[0])};
-        return std::make_unique<object::integer>(arr.elements.size());
-    }
-
-    return std::make_unique<object::error>(
-        std::format("argument to 'len' not supported, got: {}", object::get_object_type_string(args[0]->type()))
-    );
-}
+// How evaluating a node finished. Anything but Normal unwinds to the enclosing loop, function or program, so
+// return, break and continue never allocate anything to signal themselves.
+enum class completion_type : u8 {
+    Normal,
+    Return,
+    Break,
+    Continue,
+    Error,
+};
 
-static auto first_builtin(std::vector<std::unique_ptr<object::object>> args) -> std::unique_ptr<object::object> {
-    if (args.size() != 1) {
-        return std::make_unique<object::error>(std::format("wrong number of arguments. got: {}, want: 1", args.size()));
+class completion {
+public:
+    inline auto abrupt() const -> bool {
+        return type != completion_type::Normal;
     }
 
-    if (dynamic_cast<object::array*>(args[0].get())) {
-        auto& arr{dynamic_cast<object::array&>(*args[0])};
-        if (arr.elements.size() < 1) {
-            return std::make_unique<object::null>();
-        }
-        return arr.elements.front()->clone();
-    }
+public:
+    completion_type type{};
+    object::value val{};
+};
 
-    return std::make_unique<object::error>(
-        std::format("argument to 'first' must be Array, got {}", object::get_object_type_string(args[0]->type()))
-    );
+static auto from_value(object::value val) -> completion {
+    return completion{val.is_error() ? completion_type::Error : completion_type::Normal, val};
 }
 
-static auto last_builtin(std::vector<std::unique_ptr<object::object>> args) -> std::unique_ptr<object::object> {
-    if (args.size() != 1) {
-        return std::make_unique<object::error>(std::format("wrong number of arguments. got: {}, want: 1", args.size()));
-    }
-
-    if (dynamic_cast<object::array*>(args[0].get())) {
-        auto& arr{dynamic_cast<object::array&>(*args[0])};
-        if (arr.elements.size() < 1) {
-            return std::make_unique<object::null>();
-        }
-        return arr.elements.back()->clone();
-    }
-
-    return std::make_unique<object::error>(
-        std::format("argument to 'last' must be Array, got {}", object::get_object_type_string(args[0]->type()))
-    );
+static auto error(std::string_view msg) -> completion {
+    return completion{completion_type::Error, object::make<object::error>(msg)};
 }
 
-static auto rest_builtin(std::vector<std::unique_ptr<object::object>> args) -> std::unique_ptr<object::object> {
-    if (args.size() != 1) {
-        return std::make_unique<object::error>(std::format("wrong number of arguments. got: {}, want: 1", args.size()));
-    }
-
-    if (dynamic_cast<object::array*>(args[0].get())) {
-        auto& arr{dynamic_cast<object::array&>(*args[0])};
-        if (arr.elements.size() < 1) {
-            return std::make_unique<object::null>();
-        }
-
-        auto clone = arr.clone();
-        auto& arr_clone{dynamic_cast<object::array&>(*clone)};
-        arr_clone.elements.erase(arr_clone.elements.begin());
+using tree_ptr = std::shared_ptr<const flat_ast::tree>;
 
-        return clone;
-    }
+static usize max_depth{default_max_depth};
 
-    return std::make_unique<object::error>(
-        std::format("argument to 'rest' must be Array, got {}", object::get_object_type_string(args[0]->type()))
-    );
+auto set_max_depth(usize depth) -> void {
+    max_depth = depth;
 }
 
-static auto push_builtin(std::vector<std::unique_ptr<object::object>> args) -> std::unique_ptr<object::object> {
-    if (args.size() != 2) {
-        return std::make_unique<object::error>(std::format("wrong number of arguments. got: {}, want: 2", args.size()));
-    }
-
-    if (dynamic_cast<object::array*>(args[0].get())) {
-        auto& arr{dynamic_cast<object::array&>(*args[0])};
-
-        auto clone = arr.clone();
-        auto& arr_clone{dynamic_cast<object::array&>(*clone)};
-        arr_clone.elements.emplace_back(std::move(args[1]));
-
-        return clone;
-    }
-
-    return std::make_unique<object::error>(
-        std::format("argument to 'push' must be Array, got {}", object::get_object_type_string(args[0]->type()))
-    );
+auto get_max_depth() -> usize {
+    return max_depth;
 }
 
-static auto puts_builtin(std::vector<std::unique_ptr<object::object>> args) -> std::unique_ptr<object::object> {
-    if (args.size() <= 0) {
-        return std::make_unique<object::error>(std::format("wrong number of arguments. needs at least one"));
-    }
-
-    for (const auto& arg : args) {
-        switch (arg->type()) {
-        case object::object_type::String: {
-            auto& str{dynamic_cast<object::string&>(*arg)};
-            std::println("{}", str.value);
-        } break;
-
-        default: {
-            std::println("{}", arg->to_string());
-        } break;
+static auto eval_prefix_expression(ast::operator_type oper, object::value obj) -> object::value {
+    switch (oper) {
+    case ast::operator_type::Bang: {
+        if (obj.is_boolean()) {
+            return object::value::boolean(!obj.as_boolean());
         }
-    }
-
-    return std::make_unique<object::null>();
-}
 
-static auto rand_builtin(std::vector<std::unique_ptr<object::object>> args) -> std::unique_ptr<object::object> {
-    if (args.size() != 2) {
-        return std::make_unique<object::error>(std::format("wrong number of arguments. got: {}, want: 2", args.size()));
-    }
+        return object::value::boolean(obj.is_null());
+    } break;
 
-    if (args[0]->type() != object::object_type::Integer || args[1]->type() != object::object_type::Integer) {
-        return std::make_unique<object::error>(std::format(
-            "all arguments to 'rand()' have to be Integers, got: {}, {}",
-            object::get_object_type_string(args[0]->type()),
-            object::get_object_type_string(args[1]->type())
-        ));
-    }
+    case ast::operator_type::Minus: {
+        if (!obj.is_integer()) {
+            return object::make<object::error>(
+                std::format("unknown operator: -{}", object::get_object_type_string(obj.type()))
+            );
+        }
 
-    auto& int1{dynamic_cast<object::integer&>(*args[0]).value};
-    auto& int2{dynamic_cast<object::integer&>(*args[1]).value};
+        return object::value::integer(helpers::wrapping_neg(obj.as_integer()));
+    } break;
 
-    i64 min{};
-    i64 max{};
-    if (int1 >= int2) {
-        min = int2;
-        max = int1;
-    } else {
-        min = int1;
-        max = int2;
+    default: {
+    } break;
     }
 
-    std::random_device rd{};
-    std::mt19937_64 generator{rd()};
-    std::uniform_int_distribution<i64> dist(min, max);
+    return object::make<object::error>(std::format(
+        "unknown operator: {}{}",
+        ast::get_operator_string(oper),
+        object::get_object_type_string(obj.type())
+    ));
+}
 
-    return std::make_unique<object::integer>(dist(generator));
+static auto unknown_operator(ast::operator_type oper, object::value left, object::value right) -> object::value {
+    return object::make<object::error>(std::format(
+        "unknown operator: {} {} {}",
+        object::get_object_type_string(left.type()),
+        ast::get_operator_string(oper),
+        object::get_object_type_string(right.type())
+    ));
 }
 
-static auto gets_builtin(std::vector<std::unique_ptr<object::object>> args) -> std::unique_ptr<object::object> {
-    if (args.size() != 0) {
-        return std::make_unique<object::error>(std::format("wrong number of arguments. got: {}, want: 0", args.size()));
-    }
+static auto type_mismatch(ast::operator_type oper, object::value left, object::value right) -> object::value {
+    return object::make<object::error>(std::format(
+        "type mismatch: {} {} {}",
+        object::get_object_type_string(left.type()),
+        ast::get_operator_string(oper),
+        object::get_object_type_string(right.type())
+    ));
+}
 
-    std::string line{};
-    std::getline(std::cin, line);
+enum class operand : u8 {
+    Integer,
+    Boolean,
+    String,
+    Other,
+};
 
-    return std::make_unique<object::string>(line);
-}
+static constexpr usize num_operands{static_cast<usize>(operand::Other) + 1};
 
-static auto to_string_builtin(std::vector<std::unique_ptr<object::object>> args) -> std::unique_ptr<object::object> {
-    if (args.size() != 1) {
-        return std::make_unique<object::error>(std::format("wrong number of arguments. got: {}, want: 1", args.size()));
+static auto get_operand(object::value val) -> operand {
+    if (val.is_integer()) {
+        return operand::Integer;
+    } else if (val.is_boolean()) {
+        return operand::Boolean;
+    } else if (val.type() == object::object_type::String) {
+        return operand::String;
     }
 
-    return std::make_unique<object::string>(args[0]->to_string());
+    return operand::Other;
 }
 
-static auto parse_int_builtin(std::vector<std::unique_ptr<object::object>> args) -> std::unique_ptr<object::object> {
-    if (args.size() != 1) {
-        return std::make_unique<object::error>(std::format("wrong number of arguments. got: {}, want: 1", args.size()));
-    }
+using infix_fn = auto (*)(ast::operator_type oper, object::value left, object::value right) -> object::value;
 
-    if (args[0]->type() != object::object_type::String) {
-        return std::make_unique<object::error>(std::format(
-            "argument to 'parse_int()' has to be String, got {}",
-            object::get_object_type_string(args[0]->type())
-        ));
-    }
+// Indexed by [operator][left operand][right operand]. Pairs of the same type fall back to "unknown operator", mixed
+// ones to "type mismatch".
+static constexpr auto infix_table{[] {
+    using enum ast::operator_type;
 
-    auto& str{dynamic_cast<object::string&>(*args[0]).value};
-    try {
-        return std::make_unique<object::integer>(std::stol(str));
-    } catch (const std::exception&) {
-        return std::make_unique<object::error>(std::format("invalid argument to function 'parse_int()', got {}", str));
+    std::array<std::array<std::array<infix_fn, num_operands>, num_operands>, ast::num_operators> table{};
+    for (auto& by_left : table) {
+        for (usize l{0}; l < num_operands; l++) {
+            for (usize r{0}; r < num_operands; r++) {
+                by_left[l][r] = l == r && l != static_cast<usize>(operand::Other) ? unknown_operator : type_mismatch;
+            }
+        }
     }
-}
 
-static auto builtins = std::unordered_map<std::string, object::builtin>{
-    {"len",       {len_builtin}      },
-    {"first",     {first_builtin}    },
-    {"last",      {last_builtin}     },
-    {"rest",      {rest_builtin}     },
-    {"push",      {push_builtin}     },
-    {"puts",      {puts_builtin}     },
-    {"rand",      {rand_builtin}     },
-    {"gets",      {gets_builtin}     },
-    {"to_string", {to_string_builtin}},
-    {"parse_int", {parse_int_builtin}},
-};
+    auto set{[&](ast::operator_type oper, operand left, operand right, infix_fn fn) {
+        table[static_cast<usize>(oper)][static_cast<usize>(left)][static_cast<usize>(right)] = fn;
+    }};
+
+    set(Plus, operand::Integer, operand::Integer, [](ast::operator_type, object::value l, object::value r) {
+        return object::value::integer(helpers::wrapping_add(l.as_integer(), r.as_integer()));
+    });
+    set(Minus, operand::Integer, operand::Integer, [](ast::operator_type, object::value l, object::value r) {
+        return object::value::integer(helpers::wrapping_sub(l.as_integer(), r.as_integer()));
+    });
+    set(Asterisk, operand::Integer, operand::Integer, [](ast::operator_type, object::value l, object::value r) {
+        return object::value::integer(helpers::wrapping_mul(l.as_integer(), r.as_integer()));
+    });
+    set(Slash, operand::Integer, operand::Integer, [](ast::operator_type, object::value l, object::value r) {
+        if (r.as_integer() == 0) {
+            return object::make<object::error>("division by zero");
+        }
+        return object::value::integer(helpers::wrapping_div(l.as_integer(), r.as_integer()));
+    });
+    set(Lt, operand::Integer, operand::Integer, [](ast::operator_type, object::value l, object::value r) {
+        return object::value::boolean(l.as_integer() < r.as_integer());
+    });
+    set(Gt, operand::Integer, operand::Integer, [](ast::operator_type, object::value l, object::value r) {
+        return object::value::boolean(l.as_integer() > r.as_integer());
+    });
+    set(Eq, operand::Integer, operand::Integer, [](ast::operator_type, object::value l, object::value r) {
+        return object::value::boolean(l.as_integer() == r.as_integer());
+    });
+    set(NotEq, operand::Integer, operand::Integer, [](ast::operator_type, object::value l, object::value r) {
+        return object::value::boolean(l.as_integer() != r.as_integer());
+    });
+
+    set(Eq, operand::Boolean, operand::Boolean, [](ast::operator_type, object::value l, object::value r) {
+        return object::value::boolean(l.as_boolean() == r.as_boolean());
+    });
+    set(NotEq, operand::Boolean, operand::Boolean, [](ast::operator_type, object::value l, object::value r) {
+        return object::value::boolean(l.as_boolean() != r.as_boolean());
+    });
+
+    set(Plus, operand::String, operand::String, [](ast::operator_type, object::value l, object::value r) {
+        return object::make<object::string>(l.as<object::string>().value + r.as<object::string>().value);
+    });
+
+    return table;
+}()};
+
+static auto eval_infix_expression(ast::operator_type oper, object::value left, object::value right)
+    -> object::value {
+    auto left_operand{static_cast<usize>(get_operand(left))};
+    auto right_operand{static_cast<usize>(get_operand(right))};
+
+    return infix_table[static_cast<usize>(oper)][left_operand][right_operand](oper, left, right);
+}
 
-static auto is_error(object::object* obj) -> bool {
-    if (obj) {
-        return obj->type() == object::object_type::Error;
+static auto is_truthy(object::value obj) -> bool {
+    if (obj.is_boolean()) {
+        return obj.as_boolean();
+    } else if (obj.is_null()) {
+        return false;
     }
 
-    return false;
+    return true;
 }
 
-static auto eval_program(const ast::program& program, object::environment& env) -> std::unique_ptr<object::object> {
-    std::unique_ptr<object::object> result{nullptr};
+static auto eval_index_expression(object::value left, object::value index) -> completion {
+    if (left.type() == object::object_type::Array && index.type() == object::object_type::Integer) {
+        auto& arr{left.as<object::array>()};
+        auto idx{index.as_integer()};
 
-    for (const auto& stmt : program.statements) {
-        result = eval(*stmt, env);
-        if (result == nullptr) {
-            continue;
+        if (idx >= static_cast<i64>(arr.elements.size()) || idx < 0) {
+            return completion{completion_type::Normal, object::value::null()};
         }
 
-        switch (result->type()) {
-        case object::object_type::ReturnValue: {
-            auto ret{dynamic_cast<object::return_value*>(result.get())};
-            return std::move(ret->value);
-        } break;
+        return completion{completion_type::Normal, arr.elements[static_cast<usize>(idx)]};
+    } else if (left.type() == object::object_type::Hash && index.is_hashable()) {
+        auto& hash{left.as<object::hash>()};
+        auto pair{hash.pairs.find(index.get_hash_key())};
 
-        case object::object_type::Error: {
-            return result;
-        } break;
+        if (!pair) {
+            return completion{completion_type::Normal, object::value::null()};
+        }
 
-        case object::object_type::BreakValue: {
-            return std::make_unique<object::error>("break statement is illegal in current context");
-        } break;
+        return completion{completion_type::Normal, pair->second};
 
-        case object::object_type::ContinueValue: {
-            return std::make_unique<object::error>("continue statement is illegal in current context");
+    } else {
+        switch (left.type()) {
+        case interp::object::object_type::Hash: {
+            return error(std::format("unusable as hash key: {}", object::get_object_type_string(index.type())));
         } break;
 
         default: {
+            return error(std::format("index not supported: {}", object::get_object_type_string(left.type())));
         } break;
         }
     }
-
-    return result;
 }
 
-static auto eval_block_stmt(const ast::block_statement& block_stmt, object::environment& env)
-    -> std::unique_ptr<object::object> {
-    std::unique_ptr<object::object> result{nullptr};
+// The step of a call frame while the function's body runs.
+static constexpr u32 in_call{~u32{0}};
+
+// A node being evaluated. `step` counts the children evaluated so far, their values are kept in `values` from
+// `base` on until the node is done.
+struct frame {
+    const tree_ptr* tree{};
+    object::environment* env{};
+    usize base{};
+    flat_ast::node_index idx{};
+    u32 step{};
+};
 
-    for (const auto& stmt : block_stmt.statements) {
-        result = eval(*stmt, env);
+// Evaluates with its own stack of frames on the heap instead of recursing, so nesting and recursion are only limited
+// by memory and max_depth. Each step of the frame on top either enters a child, whose completion is in `result` the
+// next time the frame steps, or leaves with a completion of its own.
+class machine {
+public:
+    machine() {
+        object::get_heap().add_roots(values);
+    }
 
-        if (result != nullptr) {
-            switch (result->type()) {
-            case object::object_type::ContinueValue:
-            case object::object_type::BreakValue:
-            case object::object_type::ReturnValue:
-            case object::object_type::Error: {
-                return result;
-            } break;
+    machine(const machine&) = delete;
+    auto operator=(const machine&) -> machine& = delete;
 
-            default:
-                break;
-            }
-        }
+    ~machine() {
+        object::get_heap().remove_roots(values);
     }
 
-    return result;
-}
+    auto run(const tree_ptr& tree, object::environment& env) -> completion;
 
-static auto eval_prefix_expression(std::string_view oper, const object::object& obj)
-    -> std::unique_ptr<object::object> {
-    if (oper == "!") {
-        if (auto n{dynamic_cast<const object::boolean*>(&obj)}) {
-            return std::make_unique<object::boolean>(!n->value);
-        } else if (dynamic_cast<const object::null*>(&obj)) {
-            return std::make_unique<object::boolean>(true);
-        } else {
-            return std::make_unique<object::boolean>(false);
-        }
-    } else if (oper == "-") {
-        if (obj.type() != object::object_type::Integer) {
-            return std::make_unique<object::error>(
-                std::format("unknown operator: -{}", object::get_object_type_string(obj.type()))
-            );
-        }
+private:
+    auto enter(const tree_ptr& tree, flat_ast::node_index idx, object::environment& env) -> void;
+    auto leave(completion c) -> void;
+    auto step() -> void;
 
-        auto n{dynamic_cast<const object::integer&>(obj)};
-        n.value = -n.value;
+private:
+    std::vector<frame> frames{};
+    // Operands of the frames and the environments they run in, which have to survive collections.
+    std::vector<object::value> values{};
+    completion result{};
+    // Function calls in progress.
+    usize depth{};
+};
 
-        return std::make_unique<object::integer>(n);
+// Leaves are evaluated right away, everything else gets a frame.
+auto machine::enter(const tree_ptr& tree, flat_ast::node_index idx, object::environment& env) -> void {
+    const auto& t{*tree};
+    if (idx != flat_ast::none && t[idx].type == ast::node_type::ExpressionStatement) {
+        idx = t[idx].a;
     }
 
-    return std::make_unique<object::error>(
-        std::format("unknown operator: {}{}", oper, object::get_object_type_string(obj.type()))
-    );
-}
-
-static auto eval_infix_expression(std::string_view oper, const object::object& left, const object::object& right)
-    -> std::unique_ptr<object::object> {
-    using namespace interp;
-
-    if (left.type() == object::object_type::Integer && right.type() == object::object_type::Integer) {
-        auto& left_val{dynamic_cast<const object::integer&>(left).value};
-        auto& right_val{dynamic_cast<const object::integer&>(right).value};
-
-        if (oper == "+") {
-            return std::make_unique<object::integer>(left_val + right_val);
-        } else if (oper == "-") {
-            return std::make_unique<object::integer>(left_val - right_val);
-        } else if (oper == "*") {
-            return std::make_unique<object::integer>(left_val * right_val);
-        } else if (oper == "/") {
-            return std::make_unique<object::integer>(left_val / right_val);
-        } else if (oper == ">") {
-            return std::make_unique<object::boolean>(left_val > right_val);
-        } else if (oper == "<") {
-            return std::make_unique<object::boolean>(left_val < right_val);
-        } else if (oper == "!=") {
-            return std::make_unique<object::boolean>(left_val != right_val);
-        } else if (oper == "==") {
-            return std::make_unique<object::boolean>(left_val == right_val);
-        } else {
-            return std::make_unique<object::error>(std::format(
-                "unknown operator: {} {} {}",
-                object::get_object_type_string(left.type()),
-                oper,
-                object::get_object_type_string(right.type())
-            ));
-        }
-    } else if (left.type() == object::object_type::Boolean && right.type() == object::object_type::Boolean) {
-        auto left_val{dynamic_cast<const object::boolean&>(left).value};
-        auto right_val{dynamic_cast<const object::boolean&>(right).value};
-
-        if (oper == "!=") {
-            return std::make_unique<object::boolean>(left_val != right_val);
-        } else if (oper == "==") {
-            return std::make_unique<object::boolean>(left_val == right_val);
-        } else {
-            return std::make_unique<object::error>(std::format(
-                "unknown operator: {} {} {}",
-                object::get_object_type_string(left.type()),
-                oper,
-                object::get_object_type_string(right.type())
-            ));
-        }
-    } else if (left.type() == object::object_type::String && right.type() == object::object_type::String) {
-        auto& left_val{dynamic_cast<const object::string&>(left).value};
-        auto& right_val{dynamic_cast<const object::string&>(right).value};
-
-        if (oper == "+") {
-            return std::make_unique<object::string>(left_val + right_val);
-        } else {
-            return std::make_unique<object::error>(std::format(
-                "unknown operator: {} {} {}",
-                object::get_object_type_string(left.type()),
-                oper,
-                object::get_object_type_string(right.type())
-            ));
-        }
+    if (idx == flat_ast::none) {
+        result = {};
+        return;
     }
 
-    return std::make_unique<object::error>(std::format(
-        "type mismatch: {} {} {}",
-        object::get_object_type_string(left.type()),
-        oper,
-        object::get_object_type_string(right.type())
-    ));
-}
-
-static auto is_truthy(const object::object& obj) -> bool {
-    if (auto val{dynamic_cast<const object::boolean*>(&obj)}) {
-        if (val->value) {
-            return true;
+    const auto& n{t[idx]};
+    switch (n.type) {
+    case ast::node_type::IntegerLiteral: {
+        result = completion{completion_type::Normal, object::value::integer(t.integer(idx))};
+    } break;
+
+    case ast::node_type::BooleanExpression: {
+        result = completion{completion_type::Normal, object::value::boolean(n.flag)};
+    } break;
+
+    case ast::node_type::StringLiteral: {
+        result = completion{completion_type::Normal, object::make<object::string>(std::string{t.string(n.a)})};
+    } break;
+
+    case ast::node_type::Identifier: {
+        if (n.flag) {
+            result = completion{completion_type::Normal, builtins::get(n.b)};
+        } else if (auto val{env.get(n.a, n.b)}; val.has_value()) {
+            result = completion{completion_type::Normal, val};
         } else {
-            return false;
+            result = error(std::format("identifier not found: {}", t.string(n.c)));
         }
-    } else if (dynamic_cast<const object::null*>(&obj)) {
-        return false;
-    }
+    } break;
 
-    return true;
-}
+    case ast::node_type::FnExpression: {
+        result = completion{completion_type::Normal, object::make<object::function>(tree, idx, &env)};
+    } break;
 
-static auto eval_expressions(const std::vector<std::unique_ptr<ast::expression>>& exprs, object::environment& env)
-    -> std::vector<std::unique_ptr<object::object>> {
-    std::vector<std::unique_ptr<object::object>> ret{};
+    case ast::node_type::BreakStatement: {
+        result = completion{completion_type::Break, {}};
+    } break;
 
-    for (const auto& expr : exprs) {
-        auto evaluated{eval(*expr, env)};
-        if (is_error(evaluated.get())) {
-            ret.clear();
-            ret.emplace_back(std::move(evaluated));
-            return ret;
-        }
+    case ast::node_type::ContinueStatement: {
+        result = completion{completion_type::Continue, {}};
+    } break;
 
-        ret.emplace_back(std::move(evaluated));
+    default: {
+        frames.push_back(frame{&tree, &env, values.size(), idx, 0});
+    } break;
     }
-
-    return ret;
 }
 
-static auto apply_function(std::unique_ptr<object::object>& function, std::vector<std::unique_ptr<object::object>> args)
-    -> std::unique_ptr<object::object> {
-    if (dynamic_cast<object::function*>(function.get())) {
-        auto& fn{dynamic_cast<object::function&>(*function)};
-
-        auto env{std::make_unique<object::environment>(&fn.env_outer)};
-        for (const auto& [param, arg] : std::ranges::zip_view(fn.parameters, args)) {
-            env->set(dynamic_cast<const ast::identifier&>(*param).value, std::move(arg));
-        }
-
-        auto evaluated{eval(*fn.body, *env)};
-
-        if (dynamic_cast<object::function*>(evaluated.get())) {
-            fn.env_outer.envs_inner.push_back(std::move(env));
-        }
-
-        if (evaluated && evaluated->type() == object::object_type::BreakValue) {
-            return std::make_unique<object::error>("break statement is illegal in current context");
-        }
-
-        if (evaluated && evaluated->type() == object::object_type::ContinueValue) {
-            return std::make_unique<object::error>("continue statement is illegal in current context");
-        }
-
-        if (auto val{dynamic_cast<object::return_value*>(evaluated.get())}) {
-            if (dynamic_cast<object::function*>(val->value.get())) {
-                fn.env_outer.envs_inner.push_back(std::move(env));
-            }
-
-            return std::move(val->value);
-        }
-
-        return evaluated;
-    } else if (dynamic_cast<object::builtin*>(function.get())) {
-        auto& fn{dynamic_cast<object::builtin&>(*function)};
-        return fn.fn(std::move(args));
-    }
-
-    return std::make_unique<object::error>(
-        std::format("not a function: {}", object::get_object_type_string(function->type()))
-    );
+auto machine::leave(completion c) -> void {
+    values.resize(frames.back().base);
+    frames.pop_back();
+    result = c;
 }
 
-auto eval(ast::node& node, object::environment& env) -> std::unique_ptr<object::object> {
-    if (auto n{dynamic_cast<ast::program*>(&node)}) {
-        return eval_program(*n, env);
-
-    } else if (auto n{dynamic_cast<ast::block_statement*>(&node)}) {
-        return eval_block_stmt(*n, env);
-
-    } else if (auto n{dynamic_cast<ast::expression_statement*>(&node)}) {
-        return eval(*n->expr, env);
-
-    } else if (auto n{dynamic_cast<ast::integer_literal*>(&node)}) {
-        return std::make_unique<object::integer>(n->value);
-
-    } else if (auto n{dynamic_cast<ast::boolean_expression*>(&node)}) {
-        return std::make_unique<object::boolean>(n->value);
-
-    } else if (auto n{dynamic_cast<ast::prefix_expression*>(&node)}) {
-        auto right{eval(*n->right, env)};
-        if (is_error(right.get())) {
-            return right;
-        }
-        return eval_prefix_expression(n->oper, *right);
-
-    } else if (auto n{dynamic_cast<ast::infix_expression*>(&node)}) {
-        auto left{eval(*n->left, env)};
-        if (is_error(left.get())) {
-            return left;
+auto machine::step() -> void {
+    auto& f{frames.back()};
+    const auto& tree{*f.tree};
+    const auto& t{*tree};
+    const auto& n{t[f.idx]};
+    auto& env{*f.env};
+
+    switch (n.type) {
+    case ast::node_type::Program:
+    case ast::node_type::BlockStatement: {
+        if (f.step == 0) {
+            result = {};
+        } else if (result.abrupt()) {
+            if (n.type == ast::node_type::Program && result.type == completion_type::Return) {
+                leave(completion{completion_type::Normal, result.val});
+            } else {
+                leave(result);
+            }
+            return;
         }
 
-        auto right{eval(*n->right, env)};
-        if (is_error(right.get())) {
-            return right;
+        if (f.step == n.b) {
+            leave(result);
+            return;
         }
 
-        return eval_infix_expression(n->oper, *left, *right);
-
-    } else if (auto n{dynamic_cast<ast::if_expression*>(&node)}) {
-        auto condition{eval(*n->condition, env)};
-        if (is_error(condition.get())) {
-            return condition;
-        }
+        enter(tree, t.list(n.a, n.b)[f.step++], env);
+    } break;
 
-        if (is_truthy(*condition)) {
-            return eval(*n->consequence, env);
-        } else if (n->alternative != nullptr) {
-            return eval(*n->alternative, env);
+    case ast::node_type::PrefixExpression: {
+        if (f.step++ == 0) {
+            enter(tree, n.a, env);
+        } else if (result.abrupt()) {
+            leave(result);
         } else {
-            return std::make_unique<object::null>();
+            leave(from_value(eval_prefix_expression(n.oper, result.val)));
+        }
+    } break;
+
+    case ast::node_type::InfixExpression: {
+        if (f.step == 0) {
+            f.step++;
+            enter(tree, n.a, env);
+        } else if (result.abrupt()) {
+            leave(result);
+        } else if (f.step == 1) {
+            f.step++;
+            values.push_back(result.val);
+            enter(tree, n.b, env);
+        } else {
+            leave(from_value(eval_infix_expression(n.oper, values[f.base], result.val)));
+        }
+    } break;
+
+    // The chosen branch replaces the if.
+    case ast::node_type::IfExpression: {
+        if (f.step++ == 0) {
+            enter(tree, n.a, env);
+        } else if (result.abrupt()) {
+            leave(result);
+        } else if (is_truthy(result.val) || n.c != flat_ast::none) {
+            auto branch{is_truthy(result.val) ? n.b : n.c};
+            leave({});
+            enter(tree, branch, env);
+        } else {
+            leave(completion{completion_type::Normal, object::value::null()});
         }
+    } break;
 
-    } else if (auto n{dynamic_cast<ast::return_statement*>(&node)}) {
-        auto val{eval(*n->value, env)};
-        if (is_error(val.get())) {
-            return val;
+    case ast::node_type::ReturnStatement: {
+        if (f.step++ == 0) {
+            enter(tree, n.a, env);
+        } else if (result.abrupt()) {
+            leave(result);
+        } else {
+            leave(completion{completion_type::Return, result.val});
         }
+    } break;
 
-        return std::make_unique<object::return_value>(std::move(val));
+    case ast::node_type::LetStatement: {
+        if (f.step++ == 0) {
+            enter(tree, n.b, env);
+        } else if (result.abrupt() || !result.val.has_value()) {
+            leave(result);
+        } else {
+            env.slots[t[n.a].b] = result.val;
+            leave({});
+        }
+    } break;
+
+    // The function and then the arguments go on `values`. Once the function's body is entered, this frame waits for
+    // it in_call.
+    case ast::node_type::CallExpression: {
+        if (f.step == in_call) {
+            depth--;
+            switch (result.type) {
+            case completion_type::Break: {
+                leave(error("break statement is illegal in current context"));
+            } break;
 
-    } else if (auto n{dynamic_cast<ast::let_statement*>(&node)}) {
-        auto val{eval(*n->value, env)};
-        if (is_error(val.get()) || !val) {
-            return val;
-        }
+            case completion_type::Continue: {
+                leave(error("continue statement is illegal in current context"));
+            } break;
 
-        if (val->type() == object::object_type::ReturnValue) {
-            auto& ret{dynamic_cast<object::return_value&>(*val)};
-            env.set(n->name.value, std::move(ret.value));
-            return nullptr;
-        }
+            case completion_type::Return: {
+                leave(completion{completion_type::Normal, result.val});
+            } break;
 
-        if (val->type() == object::object_type::BreakValue) {
-            return std::make_unique<object::error>("break statement is illegal in current context");
+            default: {
+                leave(result);
+            } break;
+            }
+            return;
         }
 
-        if (val->type() == object::object_type::ContinueValue) {
-            return std::make_unique<object::error>("continue statement is illegal in current context");
-        }
+        if (f.step > 0) {
+            if (result.abrupt()) {
+                leave(result);
+                return;
+            }
+            values.push_back(result.val);
+        }
+
+        auto arguments{t.list(n.b, n.c)};
+        if (f.step <= arguments.size()) {
+            auto next{f.step == 0 ? n.a : arguments[f.step - 1]};
+            f.step++;
+            enter(tree, next, env);
+            return;
+        }
+
+        auto function{values[f.base]};
+        auto args{std::span{values}.subspan(f.base + 1)};
+        if (function.type() == object::object_type::Builtin) {
+            leave(from_value(function.as<object::builtin>().fn(args)));
+        } else if (function.type() == object::object_type::Function) {
+            auto& fn{function.as<object::function>()};
+            const auto& proto{(*fn.tree)[fn.node]};
+            if (args.size() != proto.b) {
+                leave(error(std::format("wrong number of arguments: want={}, got={}", proto.b, args.size())));
+                return;
+            }
 
-        env.set(n->name.value, std::move(val));
+            if (depth >= max_depth) {
+                leave(error("stack overflow"));
+                return;
+            }
 
-    } else if (auto n{dynamic_cast<ast::identifier*>(&node)}) {
-        auto* val{env.get(n->value)};
-        if (val && *val) {
-            return (*val)->clone();
-        }
+            auto callee{object::get_heap().make<object::environment>(fn.env_outer, (*fn.tree)[proto.c].c)};
+            for (usize i{0}; i < args.size(); i++) {
+                callee->slots[i] = args[i];
+            }
+            values.push_back(object::value{callee});
 
-        if (builtins.contains(n->value)) {
-            return builtins[n->value].clone();
+            f.step = in_call;
+            depth++;
+            enter(fn.tree, proto.c, *callee);
+        } else {
+            leave(error(std::format("not a function: {}", object::get_object_type_string(function.type()))));
         }
+    } break;
 
-        return std::make_unique<object::error>(std::format("identifier not found: {}", n->value));
-
-    } else if (auto n{dynamic_cast<ast::fn_expression*>(&node)}) {
-        return std::make_unique<object::function>(std::move(n->parameters), std::move(n->body), env);
-
-    } else if (auto n{dynamic_cast<ast::call_expression*>(&node)}) {
-        auto fn = eval(*n->fn, env);
-        if (is_error(fn.get())) {
-            return fn;
+    case ast::node_type::ArrayLiteral: {
+        if (f.step > 0) {
+            if (result.abrupt()) {
+                leave(result);
+                return;
+            }
+            values.push_back(result.val);
         }
 
-        auto args = eval_expressions(n->arguments, env);
-        if (args.size() == 1 && is_error(args[0].get())) {
-            return std::move(args[0]);
+        if (f.step < n.b) {
+            enter(tree, t.list(n.a, n.b)[f.step++], env);
+            return;
         }
 
-        return apply_function(fn, std::move(args));
-
-    } else if (auto n{dynamic_cast<ast::string_literal*>(&node)}) {
-        return std::make_unique<object::string>(n->value);
-
-    } else if (auto n{dynamic_cast<ast::array_literal*>(&node)}) {
-        auto arr{std::make_unique<object::array>()};
-        arr->elements = eval_expressions(n->elements, env);
+        std::vector<object::value> elements{values.begin() + static_cast<std::ptrdiff_t>(f.base), values.end()};
+        leave(completion{completion_type::Normal, object::make<object::array>(elements)});
+    } break;
 
-        if (arr->elements.size() == 1 && is_error(arr->elements[0].get())) {
-            return std::move(arr->elements[0]);
+    case ast::node_type::IndexExpression: {
+        if (f.step == 0) {
+            f.step++;
+            enter(tree, n.a, env);
+        } else if (result.abrupt()) {
+            leave(result);
+        } else if (f.step == 1) {
+            f.step++;
+            values.push_back(result.val);
+            enter(tree, n.b, env);
+        } else {
+            leave(eval_index_expression(values[f.base], result.val));
         }
+    } break;
 
-        return arr;
-    } else if (auto n{dynamic_cast<ast::index_expression*>(&node)}) {
-        auto left{eval(*n->left, env)};
-        if (is_error(left.get())) {
-            return left;
+    // Keys are checked once their value is evaluated too.
+    case ast::node_type::HashLiteral: {
+        if (f.step > 0) {
+            if (result.abrupt()) {
+                leave(result);
+                return;
+            }
+            values.push_back(result.val);
+
+            if (f.step % 2 == 0) {
+                if (auto key{values[values.size() - 2]}; !key.is_hashable()) {
+                    leave(error(std::format("unusable as hash key: {}", object::get_object_type_string(key.type())))
+                    );
+                    return;
+                }
+            }
         }
 
-        auto index{eval(*n->index, env)};
-        if (is_error(index.get())) {
-            return index;
+        if (f.step < n.b) {
+            enter(tree, t.list(n.a, n.b)[f.step++], env);
+            return;
         }
 
-        if (left->type() == object::object_type::Array && index->type() == object::object_type::Integer) {
-            auto& arr{dynamic_cast<object::array&>(*left)};
-            auto& idx{dynamic_cast<object::integer&>(*index).value};
-
-            if (idx >= static_cast<i64>(arr.elements.size()) || idx < 0) {
-                return std::make_unique<object::null>();
-            }
-
-            return arr.elements[static_cast<usize>(idx)]->clone();
-        } else if (left->type() == object::object_type::Hash && dynamic_cast<object::hashable*>(index.get())) {
-            auto& hash{dynamic_cast<object::hash&>(*left)};
-            auto key{dynamic_cast<object::hashable&>(*index).get_hash_key()};
+        auto hash{object::make<object::hash>()};
+        auto& pairs{hash.as<object::hash>().pairs};
+        for (usize i{f.base}; i < values.size(); i += 2) {
+            pairs = pairs.insert(values[i].get_hash_key(), std::make_pair(values[i], values[i + 1]));
+        }
+        leave(completion{completion_type::Normal, hash});
+    } break;
 
-            if (!hash.pairs.contains(key)) {
-                return std::make_unique<object::null>();
+    case ast::node_type::AssignExpression: {
+        const auto& ident{t[n.a]};
+        if (f.step++ == 0) {
+            if (ident.flag || !env.get(ident.a, ident.b).has_value()) {
+                leave(error(std::format("variable {} does not exist yet", t.string(ident.c))));
+            } else {
+                enter(tree, n.b, env);
             }
-
-            return hash.pairs[key].second->clone();
-
+        } else if (result.abrupt()) {
+            leave(result);
         } else {
-            switch (left->type()) {
-            case interp::object::object_type::Hash: {
-                return std::make_unique<object::error>(
-                    std::format("unusable as hash key: {}", object::get_object_type_string(index->type()))
-                );
-            } break;
+            env.get(ident.a, ident.b) = result.val;
+            leave(result);
+        }
+    } break;
+
+    // Steps between evaluating the condition and the body, every iteration runs in a new environment.
+    case ast::node_type::WhileStatement: {
+        if (f.step == 0) {
+            f.step = 1;
+            enter(tree, n.a, env);
+        } else if (f.step == 1) {
+            if (result.abrupt()) {
+                leave(result);
+            } else if (!is_truthy(result.val)) {
+                leave({});
+            } else {
+                auto inner{object::get_heap().make<object::environment>(&env, t[n.b].c)};
+                values.resize(f.base);
+                values.push_back(object::value{inner});
 
-            default: {
-                return std::make_unique<object::error>(
-                    std::format("index not supported: {}", object::get_object_type_string(left->type()))
-                );
-            } break;
+                f.step = 2;
+                enter(tree, n.b, *inner);
             }
+        } else if (result.type == completion_type::Error || result.type == completion_type::Return) {
+            leave(result);
+        } else if (result.type == completion_type::Break) {
+            leave({});
+        } else {
+            f.step = 1;
+            enter(tree, n.a, env);
         }
+    } break;
 
-    } else if (auto n{dynamic_cast<ast::hash_literal*>(&node)}) {
-        auto hash{std::make_unique<object::hash>()};
-
-        for (const auto& [key, val] : n->pairs) {
-            auto left{eval(*key, env)};
-            if (is_error(left.get())) {
-                return left;
-            }
-
-            auto right{eval(*val, env)};
-            if (is_error(right.get())) {
-                return right;
-            }
-
-            if (auto h{dynamic_cast<object::hashable*>(left.get())}) {
-                hash->pairs[h->get_hash_key()] = std::make_pair(std::move(left), std::move(right));
-            } else {
-                return std::make_unique<object::error>(
-                    std::format("unusable as hash key: {}", object::get_object_type_string(left->type()))
-                );
-            }
-        }
+    default: {
+        std::unreachable();
+    } break;
+    }
+}
 
-        return hash;
+auto machine::run(const tree_ptr& tree, object::environment& env) -> completion {
+    values.push_back(object::value{&env});
 
-    } else if (auto n{dynamic_cast<ast::assign_expression*>(&node)}) {
-        auto& ident{dynamic_cast<ast::identifier&>(*n->name)};
-        if (!env.contains(ident.value)) {
-            return std::make_unique<object::error>(std::format("variable {} does not exist yet", ident.value));
-        }
+    const auto& program{(*tree)[0]};
+    if (env.slots.size() < program.c) {
+        env.slots.resize(program.c);
+    }
 
-        auto evaluated{eval(*n->value, env)};
-        env.update(ident.value, evaluated->clone());
+    enter(tree, 0, env);
+    while (!frames.empty()) {
+        step();
+    }
 
-        return evaluated;
-    } else if (auto n{dynamic_cast<ast::while_statement*>(&node)}) {
-        auto condition{eval(*n->condition, env)};
-        if (is_error(condition.get())) {
-            return condition;
-        }
+    return result;
+}
 
-        while (is_truthy(*condition)) {
-            object::environment env_inner{&env};
-            auto evaluated{eval(*n->body, env_inner)};
-            if (is_error(evaluated.get()) || evaluated->type() == object::object_type::ReturnValue) {
-                return evaluated;
-            }
+auto eval(const ast::program& program, object::environment& env) -> object::value {
+    return eval(std::make_shared<const flat_ast::tree>(flat_ast::flatten(program)), env);
+}
 
-            if (evaluated->type() == object::object_type::BreakValue) {
-                break;
-            }
+auto eval(std::shared_ptr<const flat_ast::tree> tree, object::environment& env) -> object::value {
+    auto result{machine{}.run(tree, env)};
 
-            condition = eval(*n->condition, env);
-            if (is_error(condition.get())) {
-                return condition;
-            }
-        }
+    switch (result.type) {
+    case completion_type::Break: {
+        return object::make<object::error>("break statement is illegal in current context");
+    } break;
 
-    } else if (auto{dynamic_cast<ast::break_statement*>(&node)}) {
-        return std::make_unique<object::break_value>();
+    case completion_type::Continue: {
+        return object::make<object::error>("continue statement is illegal in current context");
+    } break;
 
-    } else if (auto{dynamic_cast<ast::continue_statement*>(&node)}) {
-        return std::make_unique<object::continue_value>();
+    default: {
+        return result.val;
+    } break;
     }
-
-    return nullptr;
 }
+
 }
+
 }
@@ -1,13 +1,25 @@
 #pragma once
 
 #include "ast.h"
+#include "flat_ast.h"
 #include "object.h"
 
+#include <memory>
+
 namespace interp {
 
 namespace eval {
 
-auto eval(ast::node& node, object::environment& env) -> std::unique_ptr<object::object>;
+// Function calls nested deeper than this evaluate to a "stack overflow" error, in the evaluator and in the vm.
+static constexpr usize default_max_depth{100'000};
+
+auto set_max_depth(usize depth) -> void;
+auto get_max_depth() -> usize;
+
+// Flattens the program and evaluates the result, the program has to be resolved first.
+auto eval(const ast::program& program, object::environment& env) -> object::value;
+// Functions created while evaluating keep `tree` alive.
+auto eval(std::shared_ptr<const flat_ast::tree> tree, object::environment& env) -> object::value;
 
 }
 
@@ -0,0 +1,751 @@
+#include "flat_ast.h"
+#include "ast.h"
+#include "builtins.h"
+
+#include <array>
+#include <cstring>
+#include <format>
+#include <sstream>
+#include <unordered_map>
+#include <utility>
+
+namespace interp {
+
+namespace flat_ast {
+
+static constexpr usize num_node_types{static_cast<usize>(ast::node_type::ContinueStatement) + 1};
+
+// What a field of a node holds. A List is always followed by its Count in the next field.
+enum class field : u8 {
+    Unused,
+    Value,
+    Node,
+    OptionalNode,
+    List,
+    Count,
+    String,
+};
+
+struct layout {
+    field a{};
+    field b{};
+    field c{};
+};
+
+// The table in flat_ast.h, checked by deserialize().
+static constexpr auto layouts{[] {
+    using enum ast::node_type;
+    using enum field;
+
+    std::array<layout, num_node_types> l{};
+    l[static_cast<usize>(Program)] = {List, Count, Value};
+    l[static_cast<usize>(Identifier)] = {Value, Value, String};
+    l[static_cast<usize>(LetStatement)] = {Node, OptionalNode, Unused};
+    l[static_cast<usize>(ReturnStatement)] = {OptionalNode, Unused, Unused};
+    l[static_cast<usize>(ExpressionStatement)] = {OptionalNode, Unused, Unused};
+    l[static_cast<usize>(IntegerLiteral)] = {Value, Value, Unused};
+    l[static_cast<usize>(PrefixExpression)] = {Node, Unused, Unused};
+    l[static_cast<usize>(InfixExpression)] = {Node, Node, Unused};
+    l[static_cast<usize>(BlockStatement)] = {List, Count, Value};
+    l[static_cast<usize>(IfExpression)] = {Node, Node, OptionalNode};
+    l[static_cast<usize>(FnExpression)] = {List, Count, Node};
+    l[static_cast<usize>(CallExpression)] = {Node, List, Count};
+    l[static_cast<usize>(StringLiteral)] = {String, Unused, Unused};
+    l[static_cast<usize>(ArrayLiteral)] = {List, Count, Unused};
+    l[static_cast<usize>(IndexExpression)] = {Node, Node, Unused};
+    l[static_cast<usize>(HashLiteral)] = {List, Count, Unused};
+    l[static_cast<usize>(AssignExpression)] = {Node, Node, Unused};
+    l[static_cast<usize>(WhileStatement)] = {Node, Node, Unused};
+    return l;
+}()};
+
+class flattener {
+public:
+    auto add(const ast::node* n) -> node_index;
+
+    template <typename T>
+    auto add_list(const std::vector<ast::node_ptr<T>>& children) -> std::pair<u32, u32> {
+        std::vector<node_index> indices{};
+        indices.reserve(children.size());
+        for (const auto& child : children) {
+            indices.push_back(add(child.get()));
+        }
+
+        return append_list(indices);
+    }
+
+    auto append_list(const std::vector<node_index>& indices) -> std::pair<u32, u32>;
+    auto intern(std::string_view str) -> u32;
+
+public:
+    tree t{};
+    std::unordered_map<std::string_view, u32> interned{};
+};
+
+auto flattener::append_list(const std::vector<node_index>& indices) -> std::pair<u32, u32> {
+    auto start{static_cast<u32>(t.lists.size())};
+    t.lists.insert(t.lists.end(), indices.begin(), indices.end());
+
+    return {start, static_cast<u32>(indices.size())};
+}
+
+auto flattener::intern(std::string_view str) -> u32 {
+    if (auto it{interned.find(str)}; it != interned.end()) {
+        return it->second;
+    }
+
+    auto idx{static_cast<u32>(t.strings.size())};
+    t.strings.push_back(string_ref{static_cast<u32>(t.chars.size()), static_cast<u32>(str.size())});
+    t.chars.append(str);
+    interned[str] = idx;
+
+    return idx;
+}
+
+// Children are added after their parent, so the parent is written back once they are done.
+auto flattener::add(const ast::node* n) -> node_index {
+    if (n == nullptr) {
+        return none;
+    }
+
+    auto idx{static_cast<node_index>(t.nodes.size())};
+    t.nodes.emplace_back();
+    t.spans.emplace_back();
+
+    node out{n->type()};
+    ast::source_span span{};
+
+    switch (n->type()) {
+    case ast::node_type::Program: {
+        auto& p{static_cast<const ast::program&>(*n)};
+        std::tie(out.a, out.b) = add_list(p.statements);
+        out.c = static_cast<u32>(p.num_slots);
+    } break;
+
+    case ast::node_type::Identifier: {
+        auto& ident{static_cast<const ast::identifier&>(*n)};
+        span = ident.span;
+        out.a = ident.depth;
+        out.b = ident.slot;
+        out.c = intern(ident.value);
+        out.flag = ident.builtin;
+    } break;
+
+    case ast::node_type::LetStatement: {
+        auto& let{static_cast<const ast::let_statement&>(*n)};
+        span = let.span;
+        out.a = add(&let.name);
+        out.b = add(let.value.get());
+    } break;
+
+    case ast::node_type::ReturnStatement: {
+        auto& ret{static_cast<const ast::return_statement&>(*n)};
+        span = ret.span;
+        out.a = add(ret.value.get());
+    } break;
+
+    case ast::node_type::ExpressionStatement: {
+        auto& stmt{static_cast<const ast::expression_statement&>(*n)};
+        span = stmt.span;
+        out.a = add(stmt.expr.get());
+    } break;
+
+    case ast::node_type::IntegerLiteral: {
+        auto& lit{static_cast<const ast::integer_literal&>(*n)};
+        span = lit.span;
+        out.a = static_cast<u32>(static_cast<u64>(lit.value));
+        out.b = static_cast<u32>(static_cast<u64>(lit.value) >> 32);
+    } break;
+
+    case ast::node_type::PrefixExpression: {
+        auto& expr{static_cast<const ast::prefix_expression&>(*n)};
+        span = expr.span;
+        out.oper = expr.oper;
+        out.a = add(expr.right.get());
+    } break;
+
+    // Every operator of a chain is added before the operands, then the operands from the innermost operator out.
+    case ast::node_type::InfixExpression: {
+        auto spine{ast::left_spine(static_cast<const ast::infix_expression&>(*n))};
+        std::vector<node_index> indices{idx};
+        for (usize i{1}; i < spine.size(); i++) {
+            indices.push_back(static_cast<node_index>(t.nodes.size()));
+            t.nodes.emplace_back();
+            t.spans.emplace_back();
+        }
+
+        auto left{add(spine.back()->left.get())};
+        for (auto i{spine.size() - 1}; i > 0; i--) {
+            auto right{add(spine[i]->right.get())};
+            t.nodes[indices[i]] = node{ast::node_type::InfixExpression, spine[i]->oper, false, left, right};
+            t.spans[indices[i]] = spine[i]->span;
+            left = indices[i];
+        }
+
+        span = spine[0]->span;
+        out.oper = spine[0]->oper;
+        out.a = left;
+        out.b = add(spine[0]->right.get());
+    } break;
+
+    case ast::node_type::BooleanExpression: {
+        auto& expr{static_cast<const ast::boolean_expression&>(*n)};
+        span = expr.span;
+        out.flag = expr.value;
+    } break;
+
+    case ast::node_type::BlockStatement: {
+        auto& block{static_cast<const ast::block_statement&>(*n)};
+        span = block.span;
+        std::tie(out.a, out.b) = add_list(block.statements);
+    } break;
+
+    case ast::node_type::IfExpression: {
+        auto& expr{static_cast<const ast::if_expression&>(*n)};
+        span = expr.span;
+        out.a = add(expr.condition.get());
+        out.b = add(expr.consequence.get());
+        out.c = add(expr.alternative.get());
+    } break;
+
+    case ast::node_type::FnExpression: {
+        auto& expr{static_cast<const ast::fn_expression&>(*n)};
+        span = expr.span;
+        std::tie(out.a, out.b) = add_list(expr.prototype->parameters);
+        out.c = add(expr.prototype->body.get());
+        if (out.c != none) {
+            t.nodes[out.c].c = static_cast<u32>(expr.prototype->num_slots);
+        }
+    } break;
+
+    case ast::node_type::CallExpression: {
+        auto& expr{static_cast<const ast::call_expression&>(*n)};
+        span = expr.span;
+        out.a = add(expr.fn.get());
+        std::tie(out.b, out.c) = add_list(expr.arguments);
+    } break;
+
+    case ast::node_type::StringLiteral: {
+        auto& lit{static_cast<const ast::string_literal&>(*n)};
+        span = lit.span;
+        out.a = intern(lit.value);
+    } break;
+
+    case ast::node_type::ArrayLiteral: {
+        auto& lit{static_cast<const ast::array_literal&>(*n)};
+        span = lit.span;
+        std::tie(out.a, out.b) = add_list(lit.elements);
+    } break;
+
+    case ast::node_type::IndexExpression: {
+        auto& expr{static_cast<const ast::index_expression&>(*n)};
+        span = expr.span;
+        out.a = add(expr.left.get());
+        out.b = add(expr.index.get());
+    } break;
+
+    case ast::node_type::HashLiteral: {
+        auto& lit{static_cast<const ast::hash_literal&>(*n)};
+        span = lit.span;
+        std::vector<node_index> pairs{};
+        pairs.reserve(lit.pairs.size() * 2);
+        for (const auto& [key, val] : lit.pairs) {
+            pairs.push_back(add(key.get()));
+            pairs.push_back(add(val.get()));
+        }
+        std::tie(out.a, out.b) = append_list(pairs);
+    } break;
+
+    case ast::node_type::AssignExpression: {
+        auto& expr{static_cast<const ast::assign_expression&>(*n)};
+        span = expr.span;
+        out.a = add(expr.name.get());
+        out.b = add(expr.value.get());
+    } break;
+
+    case ast::node_type::WhileStatement: {
+        auto& stmt{static_cast<const ast::while_statement&>(*n)};
+        span = stmt.span;
+        out.a = add(stmt.condition.get());
+        out.b = add(stmt.body.get());
+        if (out.b != none) {
+            t.nodes[out.b].c = static_cast<u32>(stmt.num_slots);
+        }
+    } break;
+
+    case ast::node_type::BreakStatement: {
+        span = static_cast<const ast::break_statement&>(*n).span;
+    } break;
+
+    case ast::node_type::ContinueStatement: {
+        span = static_cast<const ast::continue_statement&>(*n).span;
+    } break;
+    }
+
+    t.nodes[idx] = out;
+    t.spans[idx] = span;
+
+    return idx;
+}
+
+auto flatten(const ast::program& program) -> tree {
+    flattener f{};
+    f.add(&program);
+
+    return std::move(f.t);
+}
+
+auto tree::to_string(node_index idx) const -> std::string {
+    if (idx == none) {
+        return {};
+    }
+
+    const auto& n{nodes[idx]};
+    auto join{[&](u32 start, u32 count, std::string_view sep) {
+        std::stringstream ss{};
+        for (u32 i{0}; i < count; i++) {
+            ss << to_string(lists[start + i]);
+            if (i != count - 1) {
+                ss << sep;
+            }
+        }
+
+        return ss.str();
+    }};
+
+    switch (n.type) {
+    case ast::node_type::Program:
+    case ast::node_type::BlockStatement:
+        return join(n.a, n.b, "");
+
+    case ast::node_type::Identifier:
+        return std::string{string(n.c)};
+
+    case ast::node_type::LetStatement:
+        return std::format("let {} = {};", to_string(n.a), to_string(n.b));
+
+    case ast::node_type::ReturnStatement:
+        return std::format("return {};", to_string(n.a));
+
+    case ast::node_type::ExpressionStatement:
+        return to_string(n.a);
+
+    case ast::node_type::IntegerLiteral:
+        return std::to_string(integer(idx));
+
+    case ast::node_type::PrefixExpression:
+        return std::format("({}{})", ast::get_operator_string(n.oper), to_string(n.a));
+
+    case ast::node_type::InfixExpression: {
+        std::vector<node_index> spine{idx};
+        while (nodes[spine.back()].a != none && nodes[nodes[spine.back()].a].type == ast::node_type::InfixExpression) {
+            spine.push_back(nodes[spine.back()].a);
+        }
+
+        std::string str(spine.size(), '(');
+        str += to_string(nodes[spine.back()].a);
+        for (auto it{spine.rbegin()}; it != spine.rend(); it++) {
+            str += std::format(" {} {})", ast::get_operator_string(nodes[*it].oper), to_string(nodes[*it].b));
+        }
+
+        return str;
+    }
+
+    case ast::node_type::BooleanExpression:
+        return n.flag ? "true" : "false";
+
+    case ast::node_type::IfExpression: {
+        auto str{std::format("if{} {}", to_string(n.a), to_string(n.b))};
+        if (n.c != none) {
+            str += std::format("else {}", to_string(n.c));
+        }
+
+        return str;
+    }
+
+    case ast::node_type::FnExpression:
+        return std::format("fn({}){}", join(n.a, n.b, ", "), to_string(n.c));
+
+    case ast::node_type::CallExpression:
+        return std::format("{}({})", to_string(n.a), join(n.b, n.c, ", "));
+
+    case ast::node_type::StringLiteral:
+        return std::string{string(n.a)};
+
+    case ast::node_type::ArrayLiteral:
+        return std::format("[{}]", join(n.a, n.b, ", "));
+
+    case ast::node_type::IndexExpression:
+        return std::format("({}[{}])", to_string(n.a), to_string(n.b));
+
+    case ast::node_type::HashLiteral: {
+        std::stringstream ss{};
+        ss << "{";
+        for (u32 i{0}; i < n.b; i += 2) {
+            ss << to_string(lists[n.a + i]) << ": " << to_string(lists[n.a + i + 1]);
+            if (i + 2 < n.b) {
+                ss << ", ";
+            }
+        }
+        ss << "}";
+
+        return ss.str();
+    }
+
+    case ast::node_type::AssignExpression:
+        return std::format("{} = {}", to_string(n.a), to_string(n.b));
+
+    case ast::node_type::WhileStatement:
+        return std::format("while {} {}", to_string(n.a), to_string(n.b));
+
+    case ast::node_type::BreakStatement:
+        return "break";
+
+    case ast::node_type::ContinueStatement:
+        return "continue";
+    }
+
+    std::unreachable();
+}
+
+// Serialized trees start with this, then the sizes of nodes, lists, strings and chars. Everything is in host byte
+// order, a tree is meant to be read back on the machine that wrote it.
+static constexpr u32 magic{0x54534146};
+static constexpr usize node_bytes{3 + 5 * sizeof(u32)};
+
+static auto put(std::vector<std::byte>& out, u8 val) -> void {
+    out.push_back(std::byte{val});
+}
+
+static auto put(std::vector<std::byte>& out, u32 val) -> void {
+    auto at{out.size()};
+    out.resize(at + sizeof(val));
+    std::memcpy(out.data() + at, &val, sizeof(val));
+}
+
+class reader {
+public:
+    reader(std::span<const std::byte> b) : bytes{b} {}
+
+    auto remaining() const -> usize {
+        return bytes.size() - pos;
+    }
+
+    auto read_u8() -> u8 {
+        if (remaining() < 1) {
+            ok = false;
+            return 0;
+        }
+
+        return static_cast<u8>(bytes[pos++]);
+    }
+
+    auto read_u32() -> u32 {
+        u32 val{};
+        if (remaining() < sizeof(val)) {
+            ok = false;
+            return 0;
+        }
+
+        std::memcpy(&val, bytes.data() + pos, sizeof(val));
+        pos += sizeof(val);
+
+        return val;
+    }
+
+public:
+    std::span<const std::byte> bytes{};
+    usize pos{};
+    bool ok{true};
+};
+
+auto tree::serialize() const -> std::vector<std::byte> {
+    std::vector<std::byte> out{};
+    out.reserve(5 * sizeof(u32) + nodes.size() * node_bytes + lists.size() * sizeof(u32) +
+                strings.size() * 2 * sizeof(u32) + chars.size());
+
+    put(out, magic);
+    put(out, static_cast<u32>(nodes.size()));
+    put(out, static_cast<u32>(lists.size()));
+    put(out, static_cast<u32>(strings.size()));
+    put(out, static_cast<u32>(chars.size()));
+
+    for (usize i{0}; i < nodes.size(); i++) {
+        put(out, static_cast<u8>(nodes[i].type));
+        put(out, static_cast<u8>(nodes[i].oper));
+        put(out, static_cast<u8>(nodes[i].flag));
+        put(out, nodes[i].a);
+        put(out, nodes[i].b);
+        put(out, nodes[i].c);
+        put(out, spans[i].offset);
+        put(out, spans[i].length);
+    }
+
+    for (auto idx : lists) {
+        put(out, idx);
+    }
+
+    for (auto str : strings) {
+        put(out, str.offset);
+        put(out, str.length);
+    }
+
+    auto at{out.size()};
+    out.resize(at + chars.size());
+    std::memcpy(out.data() + at, chars.data(), chars.size());
+
+    return out;
+}
+
+// Children have to come after their parent, which also rules out cycles.
+static auto valid_child(const tree& t, node_index parent, node_index child) -> bool {
+    return child > parent && child < t.nodes.size();
+}
+
+static auto valid_field(const tree& t, node_index idx, field kind, u32 val, u32 next) -> bool {
+    switch (kind) {
+    case field::Node:
+        return valid_child(t, idx, val);
+
+    case field::OptionalNode:
+        return val == none || valid_child(t, idx, val);
+
+    case field::List: {
+        if (static_cast<u64>(val) + next > t.lists.size()) {
+            return false;
+        }
+
+        for (auto child : t.list(val, next)) {
+            if (!valid_child(t, idx, child)) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    case field::String:
+        return val < t.strings.size();
+
+    default:
+        return true;
+    }
+}
+
+// The slots of a program, function or loop body, and the scope around it.
+struct scope_info {
+    u32 slots{};
+    u32 outer{};
+    u32 depth{};
+};
+
+// Checks that every identifier refers to a slot of an environment that exists when it is evaluated, and that functions
+// have a slot for every parameter. Nodes before their children means a node's scope is known before it is reached,
+// so one pass front to back does it. A node with two parents could be in two scopes, so that is rejected too.
+static auto valid_scopes(const tree& t) -> bool {
+    std::vector<scope_info> scopes{scope_info{t.nodes[0].c, 0, 0}};
+    std::vector<u32> scope_of(t.nodes.size(), none);
+    scope_of[0] = 0;
+
+    auto enter{[&](node_index child, u32 scope) {
+        if (child == none) {
+            return true;
+        } else if (scope_of[child] != none) {
+            return false;
+        }
+
+        scope_of[child] = scope;
+        return true;
+    }};
+
+    auto new_scope{[&](u32 slots, u32 outer) {
+        scopes.push_back(scope_info{slots, outer, scopes[outer].depth + 1});
+        return static_cast<u32>(scopes.size() - 1);
+    }};
+
+    for (node_index i{0}; i < t.nodes.size(); i++) {
+        const auto& n{t.nodes[i]};
+        auto scope{scope_of[i]};
+        if (scope == none) {
+            continue;
+        }
+
+        switch (n.type) {
+        case ast::node_type::Identifier: {
+            if (n.flag) {
+                if (n.b >= builtins::definitions.size()) {
+                    return false;
+                }
+                break;
+            }
+
+            if (n.a > scopes[scope].depth) {
+                return false;
+            }
+
+            auto target{scope};
+            for (u32 d{0}; d < n.a; d++) {
+                target = scopes[target].outer;
+            }
+
+            if (n.b >= scopes[target].slots) {
+                return false;
+            }
+        } break;
+
+        // The evaluator stores into the current environment whatever depth the name has.
+        case ast::node_type::LetStatement: {
+            if (t.nodes[n.a].flag || t.nodes[n.a].a != 0) {
+                return false;
+            }
+        } break;
+
+        case ast::node_type::FnExpression: {
+            if (n.b > t.nodes[n.c].c) {
+                return false;
+            }
+
+            auto inner{new_scope(t.nodes[n.c].c, scope)};
+            for (auto param : t.list(n.a, n.b)) {
+                if (!enter(param, inner)) {
+                    return false;
+                }
+            }
+            if (!enter(n.c, inner)) {
+                return false;
+            }
+            continue;
+        }
+
+        case ast::node_type::WhileStatement: {
+            if (!enter(n.a, scope) || !enter(n.b, new_scope(t.nodes[n.b].c, scope))) {
+                return false;
+            }
+            continue;
+        }
+
+        default: {
+        } break;
+        }
+
+        const auto& l{layouts[static_cast<usize>(n.type)]};
+        std::array fields{std::pair{l.a, n.a}, std::pair{l.b, n.b}, std::pair{l.c, n.c}};
+        for (usize f{0}; f < fields.size(); f++) {
+            auto [kind, val]{fields[f]};
+            if (kind == field::Node || kind == field::OptionalNode) {
+                if (!enter(val, scope)) {
+                    return false;
+                }
+            } else if (kind == field::List) {
+                for (auto child : t.list(val, fields[f + 1].second)) {
+                    if (!enter(child, scope)) {
+                        return false;
+                    }
+                }
+            }
+        }
+    }
+
+    return true;
+}
+
+// Checks the shape of the tree, so walking it never reads out of bounds, and the resolver's annotations, so
+// evaluating it never reads past an environment.
+static auto valid(const tree& t) -> bool {
+    if (t.nodes.empty() || t.nodes[0].type != ast::node_type::Program) {
+        return false;
+    }
+
+    for (auto str : t.strings) {
+        if (static_cast<u64>(str.offset) + str.length > t.chars.size()) {
+            return false;
+        }
+    }
+
+    for (node_index i{0}; i < t.nodes.size(); i++) {
+        const auto& n{t.nodes[i]};
+        const auto& l{layouts[static_cast<usize>(n.type)]};
+        if (!valid_field(t, i, l.a, n.a, n.b) || !valid_field(t, i, l.b, n.b, n.c) ||
+            !valid_field(t, i, l.c, n.c, 0)) {
+            return false;
+        }
+
+        if ((n.type == ast::node_type::LetStatement || n.type == ast::node_type::AssignExpression) &&
+            t.nodes[n.a].type != ast::node_type::Identifier) {
+            return false;
+        }
+
+        if ((n.type == ast::node_type::FnExpression && t.nodes[n.c].type != ast::node_type::BlockStatement) ||
+            (n.type == ast::node_type::WhileStatement && t.nodes[n.b].type != ast::node_type::BlockStatement)) {
+            return false;
+        }
+
+        if (n.type == ast::node_type::HashLiteral && n.b % 2 != 0) {
+            return false;
+        }
+    }
+
+    return valid_scopes(t);
+}
+
+auto tree::deserialize(std::span<const std::byte> bytes) -> std::optional<tree> {
+    reader r{bytes};
+    if (r.read_u32() != magic) {
+        return std::nullopt;
+    }
+
+    u64 num_nodes{r.read_u32()};
+    u64 num_lists{r.read_u32()};
+    u64 num_strings{r.read_u32()};
+    u64 num_chars{r.read_u32()};
+    if (!r.ok ||
+        num_nodes * node_bytes + num_lists * sizeof(u32) + num_strings * 2 * sizeof(u32) + num_chars != r.remaining()) {
+        return std::nullopt;
+    }
+
+    tree t{};
+    t.nodes.resize(num_nodes);
+    t.spans.resize(num_nodes);
+    for (usize i{0}; i < num_nodes; i++) {
+        auto type{r.read_u8()};
+        auto oper{r.read_u8()};
+        auto flag{r.read_u8()};
+        if (type >= num_node_types || oper >= ast::num_operators || flag > 1) {
+            return std::nullopt;
+        }
+
+        auto& n{t.nodes[i]};
+        n.type = static_cast<ast::node_type>(type);
+        n.oper = static_cast<ast::operator_type>(oper);
+        n.flag = flag == 1;
+        n.a = r.read_u32();
+        n.b = r.read_u32();
+        n.c = r.read_u32();
+        t.spans[i].offset = r.read_u32();
+        t.spans[i].length = r.read_u32();
+    }
+
+    t.lists.resize(num_lists);
+    for (auto& idx : t.lists) {
+        idx = r.read_u32();
+    }
+
+    t.strings.resize(num_strings);
+    for (auto& str : t.strings) {
+        str.offset = r.read_u32();
+        str.length = r.read_u32();
+    }
+
+    t.chars.resize(num_chars);
+    std::memcpy(t.chars.data(), bytes.data() + r.pos, num_chars);
+
+    if (!valid(t)) {
+        return std::nullopt;
+    }
+
+    return t;
+}
+
+}
+
+}
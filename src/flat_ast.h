@@ -0,0 +1,104 @@
+#pragma once
+
+#include "ast.h"
+#include "types.h"
+
+#include <cstddef>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace interp {
+
+namespace flat_ast {
+
+using node_index = u32;
+
+// Stands in for a missing child, like the alternative of an if without an else.
+static constexpr node_index none{~u32{0}};
+
+// What a, b and c hold depends on the type. Lists are ranges of `lists` given as (start, count) and strings are
+// indices into `strings`.
+//
+//   Program             a, b: statements                         c: number of slots
+//   Identifier          a: depth  b: slot  c: name               flag: builtin
+//   LetStatement        a: name (an Identifier)                  b: value
+//   ReturnStatement     a: value
+//   ExpressionStatement a: expression
+//   IntegerLiteral      a: low 32 bits  b: high 32 bits
+//   PrefixExpression    a: right                                 oper
+//   InfixExpression     a: left  b: right                        oper
+//   BooleanExpression                                            flag: value
+//   BlockStatement      a, b: statements                         c: number of slots, for function and loop bodies
+//   IfExpression        a: condition  b: consequence  c: alternative or none
+//   FnExpression        a, b: parameters                         c: body
+//   CallExpression      a: function  b, c: arguments
+//   StringLiteral       a: value
+//   ArrayLiteral        a, b: elements
+//   IndexExpression     a: left  b: index
+//   HashLiteral         a, b: every key followed by its value, so b is twice the number of pairs
+//   AssignExpression    a: name (an Identifier)                  b: value
+//   WhileStatement      a: condition  b: body
+struct node {
+    ast::node_type type{};
+    ast::operator_type oper{};
+    bool flag{};
+    u32 a{};
+    u32 b{};
+    u32 c{};
+};
+
+struct string_ref {
+    u32 offset{};
+    u32 length{};
+};
+
+// A program stored as plain arrays, with the program itself at index 0 and every node before its children. Nothing
+// in it points anywhere, so copying it is a handful of memcpys and it does not borrow from the source it was parsed
+// from. Walking `nodes` front to back visits every node without recursion.
+class tree {
+public:
+    inline auto size() const -> usize {
+        return nodes.size();
+    }
+
+    inline auto operator[](node_index idx) const -> const node& {
+        return nodes[idx];
+    }
+
+    inline auto list(u32 start, u32 count) const -> std::span<const node_index> {
+        return std::span{lists}.subspan(start, count);
+    }
+
+    inline auto string(u32 idx) const -> std::string_view {
+        return std::string_view{chars}.substr(strings[idx].offset, strings[idx].length);
+    }
+
+    inline auto integer(node_index idx) const -> i64 {
+        return static_cast<i64>(static_cast<u64>(nodes[idx].b) << 32 | nodes[idx].a);
+    }
+
+    // Same output as ast::node::to_string on the node it was flattened from.
+    auto to_string(node_index idx = 0) const -> std::string;
+
+    auto serialize() const -> std::vector<std::byte>;
+    // Returns nothing if `bytes` is not a tree written by serialize(), or if any identifier refers to a slot that the
+    // evaluator would not allocate, so whatever it returns can be evaluated.
+    static auto deserialize(std::span<const std::byte> bytes) -> std::optional<tree>;
+
+public:
+    std::vector<node> nodes{};
+    std::vector<ast::source_span> spans{};
+    std::vector<node_index> lists{};
+    std::vector<string_ref> strings{};
+    std::string chars{};
+};
+
+// Copies a parsed program into a tree, identifiers keep what the resolver annotated them with.
+auto flatten(const ast::program& program) -> tree;
+
+}
+
+}
@@ -1,6 +1,7 @@
 #include "helpers.h"
 
 #include <cctype>
+#include <charconv>
 
 namespace interp {
 
@@ -10,6 +11,20 @@ bool is_letter(i8 ch) {
     return std::isalpha(ch) || ch == '_';
 }
 
+auto parse_i64(std::string_view str, i64& value) -> std::errc {
+    // from_chars takes a leading minus but not a plus.
+    if (str.starts_with('+') && !str.substr(1).starts_with('-')) {
+        str.remove_prefix(1);
+    }
+
+    auto [ptr, ec]{std::from_chars(str.data(), str.data() + str.size(), value)};
+    if (ec == std::errc{} && ptr != str.data() + str.size()) {
+        return std::errc::invalid_argument;
+    }
+
+    return ec;
+}
+
 }
 
 }
@@ -2,12 +2,95 @@
 
 #include "types.h"
 
+#include <limits>
+#include <string_view>
+#include <system_error>
+
 namespace interp {
 
 namespace helpers {
 
 bool is_letter(i8 ch);
 
+// Parses all of `str` as a base 10 integer with an optional sign. Returns std::errc::invalid_argument when `str`
+// holds anything else and std::errc::result_out_of_range when the number does not fit in an i64.
+auto parse_i64(std::string_view str, i64& value) -> std::errc;
+
+// Integer arithmetic of the evaluator, the vm and the optimizer, so folded and unfolded code agree. Each returns
+// whether the result overflowed, `result` holds it wrapped around to 64 bits either way.
+inline auto add_overflow(i64 left, i64 right, i64& result) -> bool {
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_add_overflow(left, right, &result);
+#else
+    result = static_cast<i64>(static_cast<u64>(left) + static_cast<u64>(right));
+    return ((left ^ result) & (right ^ result)) < 0;
+#endif
+}
+
+inline auto sub_overflow(i64 left, i64 right, i64& result) -> bool {
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_sub_overflow(left, right, &result);
+#else
+    result = static_cast<i64>(static_cast<u64>(left) - static_cast<u64>(right));
+    return ((left ^ right) & (left ^ result)) < 0;
+#endif
+}
+
+inline auto mul_overflow(i64 left, i64 right, i64& result) -> bool {
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_mul_overflow(left, right, &result);
+#else
+    constexpr auto min{std::numeric_limits<i64>::min()};
+    result = static_cast<i64>(static_cast<u64>(left) * static_cast<u64>(right));
+    return (left == -1 && right == min) || (right == -1 && left == min) || (left != 0 && result / left != right);
+#endif
+}
+
+// `right` must not be 0, the only quotient that overflows is min / -1.
+inline auto div_overflow(i64 left, i64 right, i64& result) -> bool {
+    if (left == std::numeric_limits<i64>::min() && right == -1) {
+        result = left;
+        return true;
+    }
+
+    result = left / right;
+    return false;
+}
+
+inline auto neg_overflow(i64 val, i64& result) -> bool {
+    return sub_overflow(0, val, result);
+}
+
+inline auto wrapping_add(i64 left, i64 right) -> i64 {
+    i64 result{};
+    add_overflow(left, right, result);
+    return result;
+}
+
+inline auto wrapping_sub(i64 left, i64 right) -> i64 {
+    i64 result{};
+    sub_overflow(left, right, result);
+    return result;
+}
+
+inline auto wrapping_mul(i64 left, i64 right) -> i64 {
+    i64 result{};
+    mul_overflow(left, right, result);
+    return result;
+}
+
+inline auto wrapping_div(i64 left, i64 right) -> i64 {
+    i64 result{};
+    div_overflow(left, right, result);
+    return result;
+}
+
+inline auto wrapping_neg(i64 val) -> i64 {
+    i64 result{};
+    neg_overflow(val, result);
+    return result;
+}
+
 }
 
 }
@@ -2,11 +2,123 @@
 #include "helpers.h"
 #include "token.h"
 
+#include <algorithm>
+#include <bit>
+#include <cctype>
+#include <format>
+#include <iterator>
+#include <thread>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 namespace interp {
 
 namespace lexer {
 
+// Byte classes the lexer skips over in runs. `wide` marks the matching bytes of a 16 byte block.
+struct space_class {
+    static auto scalar(char c) -> bool {
+        return c == ' ' || (c >= '\t' && c <= '\r');
+    }
+#if defined(__SSE2__)
+    static auto wide(__m128i v) -> __m128i;
+#endif
+};
+
+struct ident_class {
+    static auto scalar(char c) -> bool {
+        return ((c | 0x20) >= 'a' && (c | 0x20) <= 'z') || c == '_';
+    }
+#if defined(__SSE2__)
+    static auto wide(__m128i v) -> __m128i;
+#endif
+};
+
+struct digit_class {
+    static auto scalar(char c) -> bool {
+        return c >= '0' && c <= '9';
+    }
+#if defined(__SSE2__)
+    static auto wide(__m128i v) -> __m128i;
+#endif
+};
+
+struct string_body_class {
+    static auto scalar(char c) -> bool {
+        return c != '"' && c != 0;
+    }
+#if defined(__SSE2__)
+    static auto wide(__m128i v) -> __m128i;
+#endif
+};
+
+#if defined(__SSE2__)
+// sse2 only has signed compares, so shift the range down to start at -128 and compare against its end.
+static auto in_range(__m128i v, char lo, char hi) -> __m128i {
+    auto shifted{_mm_add_epi8(v, _mm_set1_epi8(static_cast<char>(0x80 - lo)))};
+    return _mm_cmplt_epi8(shifted, _mm_set1_epi8(static_cast<char>(0x80 + (hi - lo) + 1)));
+}
+
+auto space_class::wide(__m128i v) -> __m128i {
+    return _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')), in_range(v, '\t', '\r'));
+}
+
+auto ident_class::wide(__m128i v) -> __m128i {
+    auto lower{_mm_or_si128(v, _mm_set1_epi8(0x20))};
+    return _mm_or_si128(in_range(lower, 'a', 'z'), _mm_cmpeq_epi8(v, _mm_set1_epi8('_')));
+}
+
+auto digit_class::wide(__m128i v) -> __m128i {
+    return in_range(v, '0', '9');
+}
+
+auto string_body_class::wide(__m128i v) -> __m128i {
+    auto stop{_mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('"')), _mm_cmpeq_epi8(v, _mm_setzero_si128()))};
+    return _mm_andnot_si128(stop, _mm_set1_epi8(-1));
+}
+#endif
+
+// Index of the first byte at or after `pos` that is not in `Class`, 16 bytes at a time while they last.
+template <typename Class>
+static auto scan(std::string_view input, usize pos) -> usize {
+#if defined(__SSE2__)
+    while (pos + 16 <= input.size()) {
+        auto block{_mm_loadu_si128(reinterpret_cast<const __m128i*>(input.data() + pos))};
+        auto misses{~static_cast<u32>(_mm_movemask_epi8(Class::wide(block))) & 0xffff};
+        if (misses != 0) {
+            return pos + static_cast<usize>(std::countr_zero(misses));
+        }
+        pos += 16;
+    }
+#endif
+
+    while (pos < input.size() && Class::scalar(input[pos])) {
+        pos++;
+    }
+
+    return pos;
+}
+
+auto token_buffer::at(usize idx) const -> token::token {
+    if (idx >= types.size()) {
+        return token::token{token::token_type::End, ""};
+    }
+
+    return token::token{types[idx], input.substr(offsets[idx], lengths[idx])};
+}
+
+static auto too_large(usize size) -> std::string {
+    return std::format("input is {} bytes long, the lexer handles at most {}", size, max_input_size);
+}
+
 lexer::lexer(std::string_view input) : input{input} {
+    if (input.size() > max_input_size) {
+        errors.push_back(too_large(input.size()));
+        this->input = {};
+    }
+
     read_char();
 }
 
@@ -18,70 +130,68 @@ auto lexer::next_token() -> token::token {
     switch (ch) {
     case '=': {
         if (peek_char() == '=') {
-            auto c = ch;
             read_char();
-            tok = token::token{token::token_type::Eq, std::string{c} + std::string{ch}};
+            tok = token::token{token::token_type::Eq, input.substr(pos - 1, 2)};
         } else {
-            tok = token::token{token::token_type::Assign, ch};
+            tok = token::token{token::token_type::Assign, input.substr(pos, 1)};
         }
     } break;
 
     case '+': {
-        tok = token::token{token::token_type::Plus, ch};
+        tok = token::token{token::token_type::Plus, input.substr(pos, 1)};
     } break;
 
     case '-': {
-        tok = token::token{token::token_type::Minus, ch};
+        tok = token::token{token::token_type::Minus, input.substr(pos, 1)};
     } break;
 
     case '!': {
         if (peek_char() == '=') {
-            auto c = ch;
             read_char();
-            tok = token::token{token::token_type::NotEq, std::string{c} + std::string{ch}};
+            tok = token::token{token::token_type::NotEq, input.substr(pos - 1, 2)};
         } else {
-            tok = token::token{token::token_type::Bang, ch};
+            tok = token::token{token::token_type::Bang, input.substr(pos, 1)};
         }
     } break;
 
     case '/': {
-        tok = token::token{token::token_type::Slash, ch};
+        tok = token::token{token::token_type::Slash, input.substr(pos, 1)};
     } break;
 
     case '*': {
-        tok = token::token{token::token_type::Asterisk, ch};
+        tok = token::token{token::token_type::Asterisk, input.substr(pos, 1)};
     } break;
 
     case '<': {
-        tok = token::token{token::token_type::Lt, ch};
+        tok = token::token{token::token_type::Lt, input.substr(pos, 1)};
     } break;
 
     case '>': {
-        tok = token::token{token::token_type::Gt, ch};
+        tok = token::token{token::token_type::Gt, input.substr(pos, 1)};
     } break;
 
     case ';': {
-        tok = token::token{token::token_type::Semicolon, ch};
+        tok = token::token{token::token_type::Semicolon, input.substr(pos, 1)};
     } break;
 
     case '(': {
-        tok = token::token{token::token_type::Lparen, ch};
+        tok = token::token{token::token_type::Lparen, input.substr(pos, 1)};
     } break;
 
     case ')': {
-        tok = token::token{token::token_type::Rparen, ch};
+        tok = token::token{token::token_type::Rparen, input.substr(pos, 1)};
     } break;
 
     case ',': {
-        tok = token::token{token::token_type::Comma, ch};
+        tok = token::token{token::token_type::Comma, input.substr(pos, 1)};
     } break;
 
     case '{': {
-        tok = token::token{token::token_type::Lbrace, ch};
+        tok = token::token{token::token_type::Lbrace, input.substr(pos, 1)};
     } break;
 
     case '}': {
-        tok = token::token{token::token_type::Rbrace, ch};
+        tok = token::token{token::token_type::Rbrace, input.substr(pos, 1)};
     } break;
 
     case '"': {
@@ -90,19 +200,19 @@ auto lexer::next_token() -> token::token {
     } break;
 
     case '[': {
-        tok = token::token{token::token_type::Lbracket, ch};
+        tok = token::token{token::token_type::Lbracket, input.substr(pos, 1)};
     } break;
 
     case ']': {
-        tok = token::token{token::token_type::Rbracket, ch};
+        tok = token::token{token::token_type::Rbracket, input.substr(pos, 1)};
     } break;
 
     case ':': {
-        tok = token::token{token::token_type::Colon, ch};
+        tok = token::token{token::token_type::Colon, input.substr(pos, 1)};
     } break;
 
     case 0: {
-        tok = token::token{token::token_type::End, ""};
+        return token::token{token::token_type::End, ""};
     } break;
 
     default: {
@@ -116,7 +226,7 @@ auto lexer::next_token() -> token::token {
 
             return tok;
         } else {
-            tok = token::token{token::token_type::Illegal, ch};
+            tok = token::token{token::token_type::Illegal, input.substr(pos, 1)};
         }
     } break;
     }
@@ -126,6 +236,33 @@ auto lexer::next_token() -> token::token {
     return tok;
 }
 
+auto lexer::tokenize() -> token_buffer {
+    token_buffer buf{};
+    buf.input = input;
+    buf.errors = errors;
+
+    // Most scripts average a token every few bytes.
+    auto expected{(input.size() - pos) / 4 + 1};
+    buf.types.reserve(expected);
+    buf.offsets.reserve(expected);
+    buf.lengths.reserve(expected);
+
+    while (true) {
+        auto tok{next_token()};
+        auto offset{
+            tok.type == token::token_type::End ? input.size() : static_cast<usize>(tok.literal.data() - input.data())
+        };
+
+        buf.types.push_back(tok.type);
+        buf.offsets.push_back(static_cast<u32>(offset));
+        buf.lengths.push_back(static_cast<u32>(tok.literal.size()));
+
+        if (tok.type == token::token_type::End) {
+            return buf;
+        }
+    }
+}
+
 auto lexer::read_char() -> void {
     if (read_pos >= input.size()) {
         ch = 0;
@@ -145,40 +282,129 @@ auto lexer::peek_char() -> i8 {
     }
 }
 
-auto lexer::read_ident() -> std::string {
-    auto p = pos;
-
-    while (helpers::is_letter(ch)) {
+auto lexer::skip_to(usize p) -> void {
+    if (p != pos) {
+        read_pos = p;
         read_char();
     }
+}
+
+auto lexer::read_ident() -> std::string_view {
+    auto p = pos;
+    skip_to(scan<ident_class>(input, pos));
 
     return input.substr(p, pos - p);
 }
 
-auto lexer::read_number() -> std::string {
+auto lexer::read_number() -> std::string_view {
     auto p = pos;
-
-    while (std::isdigit(ch)) {
-        read_char();
-    }
+    skip_to(scan<digit_class>(input, pos));
 
     return input.substr(p, pos - p);
 }
 
-auto lexer::read_string() -> std::string {
+auto lexer::read_string() -> std::string_view {
     auto p = pos + 1;
-
-    do {
-        read_char();
-    } while (ch != '"' && ch != 0);
+    skip_to(scan<string_body_class>(input, p));
 
     return input.substr(p, pos - p);
 }
 
 auto lexer::skip_whitespace() -> void {
-    while (std::isspace(ch)) {
-        read_char();
+    skip_to(scan<space_class>(input, pos));
+}
+
+// Chunks smaller than this are not worth a thread.
+static constexpr usize min_chunk_size{1 << 20};
+
+auto tokenize(std::string_view input, usize threads) -> token_buffer {
+    if (input.size() > max_input_size) {
+        token_buffer buf{};
+        buf.types.push_back(token::token_type::End);
+        buf.offsets.push_back(0);
+        buf.lengths.push_back(0);
+        buf.errors.push_back(too_large(input.size()));
+        return buf;
+    }
+
+    // A nul byte either ends the input or closes a string literal, depending on where it is, so inputs with one are
+    // left to a single lexer.
+    auto chunks{std::min(threads, input.size() / min_chunk_size)};
+    if (chunks <= 1 || input.find('\0') != std::string_view::npos) {
+        return lexer{input}.tokenize();
+    }
+
+    // Count the quotes in evenly sized slices first, so whether a slice starts inside a string literal is known
+    // without a sequential pass over everything before it.
+    std::vector<usize> slices(chunks + 1);
+    for (usize i{}; i <= chunks; i++) {
+        slices[i] = input.size() * i / chunks;
     }
+
+    std::vector<usize> quotes(chunks);
+    {
+        std::vector<std::jthread> workers{};
+        for (usize i{}; i < chunks; i++) {
+            workers.emplace_back([&, i] {
+                quotes[i] =
+                    static_cast<usize>(std::count(input.begin() + slices[i], input.begin() + slices[i + 1], '"'));
+            });
+        }
+    }
+
+    // Then move each slice start forward to the first whitespace outside of a string, no token spans it.
+    std::vector<usize> bounds{0};
+    usize quotes_before{};
+    for (usize i{1}; i < chunks; i++) {
+        quotes_before += quotes[i - 1];
+
+        auto in_string{quotes_before % 2 == 1};
+        auto b{slices[i]};
+        while (b < input.size() && (in_string || !space_class::scalar(input[b]))) {
+            in_string ^= input[b] == '"';
+            b++;
+        }
+
+        if (b < input.size() && b > bounds.back()) {
+            bounds.push_back(b);
+        }
+    }
+    bounds.push_back(input.size());
+
+    std::vector<token_buffer> parts(bounds.size() - 1);
+    {
+        std::vector<std::jthread> workers{};
+        for (usize i{}; i < parts.size(); i++) {
+            workers.emplace_back([&, i] {
+                parts[i] = lexer{input.substr(bounds[i], bounds[i + 1] - bounds[i])}.tokenize();
+            });
+        }
+    }
+
+    // Every chunk ends with an End token, only the last one is kept.
+    token_buffer buf{};
+    buf.input = input;
+
+    usize total{1};
+    for (const auto& part : parts) {
+        total += part.size() - 1;
+    }
+    buf.types.reserve(total);
+    buf.offsets.reserve(total);
+    buf.lengths.reserve(total);
+
+    for (usize i{}; i < parts.size(); i++) {
+        auto& part{parts[i]};
+        auto count{i + 1 == parts.size() ? part.size() : part.size() - 1};
+
+        std::copy_n(part.types.begin(), count, std::back_inserter(buf.types));
+        std::copy_n(part.lengths.begin(), count, std::back_inserter(buf.lengths));
+        for (usize j{}; j < count; j++) {
+            buf.offsets.push_back(part.offsets[j] + static_cast<u32>(bounds[i]));
+        }
+    }
+
+    return buf;
 }
 
 }
@@ -3,35 +3,79 @@
 #include "token.h"
 #include "types.h"
 
+#include <limits>
 #include <string>
+#include <string_view>
+#include <vector>
 
 namespace interp {
 
 namespace lexer {
 
+// Offsets into the input are stored as u32, longer inputs are rejected with an error instead of being lexed.
+static constexpr usize max_input_size{std::numeric_limits<u32>::max()};
+
+// Every token of an input, one array per field. Offsets and lengths are into `input`, so inputs are limited to
+// max_input_size.
+class token_buffer {
+public:
+    auto size() const -> usize {
+        return types.size();
+    }
+
+    // Past the last token this keeps returning End, like lexer::next_token does.
+    auto at(usize idx) const -> token::token;
+
+public:
+    std::string_view input{};
+    std::vector<token::token_type> types{};
+    std::vector<u32> offsets{};
+    std::vector<u32> lengths{};
+
+    std::vector<std::string> errors{};
+};
+
+// Tokens are views into the input, so it has to outlive them and everything built from them (the ast included).
+// An input longer than max_input_size is reported in `errors` and lexed as if it was empty.
 class lexer {
 public:
     lexer(std::string_view input);
 
     auto next_token() -> token::token;
+    // Lexes the rest of the input, the End token included.
+    auto tokenize() -> token_buffer;
+
+    inline auto get_input() const -> std::string_view {
+        return input;
+    }
 
 private:
     auto read_char() -> void;
     i8 peek_char();
 
-    auto read_ident() -> std::string;
-    auto read_number() -> std::string;
-    auto read_string() -> std::string;
+    // Moves to `p` as if read_char() was called until `pos == p`.
+    auto skip_to(usize p) -> void;
+
+    auto read_ident() -> std::string_view;
+    auto read_number() -> std::string_view;
+    auto read_string() -> std::string_view;
 
     auto skip_whitespace() -> void;
 
+public:
+    std::vector<std::string> errors{};
+
 private:
-    std::string input{};
+    std::string_view input{};
     usize pos{};
     usize read_pos{};
     i8 ch{};
 };
 
+// Tokenizes `input` on up to `threads` threads. The input is split into chunks at whitespace outside of string
+// literals and each chunk is lexed on its own, the result is the same as lexer{input}.tokenize().
+auto tokenize(std::string_view input, usize threads) -> token_buffer;
+
 }
 
 }
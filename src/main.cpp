@@ -1,53 +1,150 @@
+#include "compiler.h"
 #include "eval.h"
 #include "lexer.h"
 #include "object.h"
+#include "optimizer.h"
 #include "parser.h"
 #include "repl.h"
+#include "resolver.h"
+#include "source.h"
+#include "vm.h"
 
+#include <charconv>
 #include <filesystem>
-#include <fstream>
 #include <iostream>
 #include <print>
-#include <sstream>
+#include <string_view>
+#include <thread>
 
 int main(int argc, char* argv[]) {
-    if (argc == 1) {
-        interp::repl::start(std::cin, std::cout);
-    } else if (argc == 2) {
-        if (!std::filesystem::exists(argv[1])) {
-            std::println("file {} does not exist", argv[1]);
+    auto backend{interp::repl::backend::Eval};
+    const char* path{};
+    bool gc_stats{};
+    bool ast_stats{};
+    bool optimize{};
+    bool dump_ast{};
+
+    for (int i{1}; i < argc; i++) {
+        std::string_view arg{argv[i]};
+
+        if (arg == "--vm") {
+            backend = interp::repl::backend::Vm;
+        } else if (arg == "--eval") {
+            backend = interp::repl::backend::Eval;
+        } else if (arg == "--gc-stats") {
+            gc_stats = true;
+        } else if (arg == "--ast-stats") {
+            ast_stats = true;
+        } else if (arg == "--optimize") {
+            optimize = true;
+        } else if (arg == "--dump-ast") {
+            dump_ast = true;
+        } else if (arg.starts_with("--gc-threshold=")) {
+            auto num{arg.substr(std::string_view{"--gc-threshold="}.size())};
+            interp::usize bytes{};
+            auto [ptr, ec]{std::from_chars(num.data(), num.data() + num.size(), bytes)};
+            if (ec != std::errc{} || ptr != num.data() + num.size()) {
+                std::println("Invalid gc threshold: {}", num);
+                return 1;
+            }
+            interp::object::get_heap().set_threshold(bytes);
+        } else if (arg.starts_with("--max-depth=")) {
+            auto num{arg.substr(std::string_view{"--max-depth="}.size())};
+            interp::usize depth{};
+            auto [ptr, ec]{std::from_chars(num.data(), num.data() + num.size(), depth)};
+            if (ec != std::errc{} || ptr != num.data() + num.size()) {
+                std::println("Invalid max depth: {}", num);
+                return 1;
+            }
+            interp::eval::set_max_depth(depth);
+        } else if (!arg.starts_with("--") && path == nullptr) {
+            path = argv[i];
+        } else {
+            std::println("Invalid command");
             return 1;
         }
+    }
 
-        std::ifstream ifs{argv[1]};
-        std::ostringstream oss{};
-        oss << ifs.rdbuf();
-        auto str = oss.str();
+    if (path == nullptr) {
+        interp::repl::start(std::cin, std::cout, backend);
+        return 0;
+    }
 
-        if (str.empty()) {
-            std::println("file {} is empty", argv[1]);
-            return 1;
+    if (!std::filesystem::exists(path)) {
+        std::println("file {} does not exist", path);
+        return 1;
+    }
+
+    interp::source::file src{path};
+    auto str{src.text()};
+
+    if (str.empty()) {
+        std::println("file {} is empty", path);
+        return 1;
+    }
+
+    auto tokens{interp::lexer::tokenize(str, std::thread::hardware_concurrency())};
+    interp::parser::parser p{tokens};
+    auto program{p.parse_program()};
+    if (!p.errors.empty()) {
+        std::println(stderr, "parser had {} errors", p.errors.size());
+        for (const auto& err : p.errors) {
+            std::println(stderr, "parser error: {}", err);
         }
 
-        interp::lexer::lexer l{str};
-        interp::parser::parser p{l};
-        auto program{p.parse_program()};
-        if (!p.errors.empty()) {
-            std::println(stderr, "parser had {} errors", p.errors.size());
-            for (const auto& err : p.errors) {
-                std::println(stderr, "parser error: {}", err);
+        return 1;
+    }
+
+    // The evaluator and the optimizer both need to know what every identifier refers to.
+    interp::resolver::resolver r{};
+    if (optimize || backend == interp::repl::backend::Eval) {
+        r.resolve(program);
+    }
+
+    interp::optimizer::optimizer o{};
+    if (optimize) {
+        o.optimize(program);
+    }
+
+    if (dump_ast) {
+        std::println(stderr, "{}", program.to_string());
+    }
+
+    if (ast_stats) {
+        std::println(stderr, "{}", program.node_arena->report());
+        if (optimize) {
+            std::println(stderr, "{}", o.stats.report());
+        }
+    }
+
+    interp::object::value evaluated{};
+
+    if (backend == interp::repl::backend::Vm) {
+        interp::compiler::state state{};
+        interp::compiler::compiler c{state};
+        c.compile(program);
+        if (!c.errors.empty()) {
+            for (const auto& err : c.errors) {
+                std::println(stderr, "compiler error: {}", err);
             }
 
             return 1;
         }
 
-        interp::object::environment env{};
-        auto evaluated{interp::eval::eval(program, env)};
-        if (evaluated->type() == interp::object::object_type::Error) {
-            std::println("{}", evaluated->to_string());
-        }
+        std::vector<interp::object::value> globals{};
+        interp::vm::vm machine{c.get_bytecode(), globals};
+        evaluated = machine.run();
     } else {
-        std::println("Invalid command");
+        interp::object::environment env{};
+        evaluated = interp::eval::eval(program, env);
+    }
+
+    if (evaluated.is_error()) {
+        std::println("{}", evaluated.to_string());
+    }
+
+    if (gc_stats) {
+        std::println(stderr, "{}", interp::object::get_heap().stats.report());
     }
 
     return 0;
@@ -1,4 +1,5 @@
 #include "object.h"
+#include <algorithm>
 #include <functional>
 #include <sstream>
 #include <utility>
@@ -15,8 +16,6 @@ auto get_object_type_string(object_type obj) -> std::string_view {
         return "Boolean";
     case object_type::Null:
         return "Null";
-    case object_type::ReturnValue:
-        return "ReturnValue";
     case object_type::Error:
         return "Error";
     case object_type::Function:
@@ -29,10 +28,14 @@ auto get_object_type_string(object_type obj) -> std::string_view {
         return "Array";
     case object_type::Hash:
         return "Hash";
-    case object_type::BreakValue:
-        return "BreakValue";
-    case object_type::ContinueValue:
-        return "ContinueValue";
+    case object_type::CompiledFunction:
+        return "CompiledFunction";
+    case object_type::Closure:
+        return "Closure";
+    case object_type::Cell:
+        return "Cell";
+    case object_type::Environment:
+        return "Environment";
     }
 
     std::unreachable();
@@ -42,94 +45,167 @@ auto hash_key::operator==(const hash_key& other) const -> bool {
     return type == other.type && value == other.value;
 }
 
-auto integer::get_hash_key() const -> hash_key {
-    return hash_key{object_type::Integer, static_cast<u64>(value)};
+auto value::is_hashable() const -> bool {
+    switch (kind) {
+    case value_kind::Integer:
+    case value_kind::Boolean:
+        return true;
+    case value_kind::Object:
+        return obj->type() == object_type::String;
+    default:
+        return false;
+    }
 }
 
-auto boolean::get_hash_key() const -> hash_key {
-    return hash_key{object_type::Boolean, static_cast<u64>(value)};
+auto value::get_hash_key() const -> hash_key {
+    switch (kind) {
+    case value_kind::Integer:
+        return hash_key{object_type::Integer, static_cast<u64>(int_val)};
+    case value_kind::Boolean:
+        return hash_key{object_type::Boolean, static_cast<u64>(bool_val)};
+    default:
+        return as<string>().get_hash_key();
+    }
 }
 
-auto string::get_hash_key() const -> hash_key {
-    static std::hash<std::string> hasher{};
+auto value::to_string() const -> std::string {
+    switch (kind) {
+    case value_kind::Empty:
+        return "";
+    case value_kind::Null:
+        return "null";
+    case value_kind::Boolean:
+        return std::format("{}", bool_val);
+    case value_kind::Integer:
+        return std::format("{}", int_val);
+    case value_kind::Object:
+        return obj->to_string();
+    }
 
-    return hash_key{object_type::String, hasher(value)};
+    std::unreachable();
 }
 
-auto environment::get(const std::string& name) const -> const std::unique_ptr<object>* {
-    if (store.contains(name)) {
-        return &store.at(name);
+heap::~heap() {
+    while (objects) {
+        auto next{objects->next};
+        delete objects;
+        objects = next;
     }
+}
 
-    if (outer) {
-        return outer->get(name);
+auto heap::collect() -> void {
+    auto start{std::chrono::steady_clock::now()};
+    epoch++;
+
+    for (auto val : roots) {
+        mark(val);
     }
+    for (auto vals : root_vectors) {
+        for (auto val : *vals) {
+            mark(val);
+        }
+    }
+
+    while (!gray.empty()) {
+        auto obj{gray.back()};
+        gray.pop_back();
+        obj->trace(*this);
+    }
+
+    usize freed_objects{};
+    usize freed_bytes{};
+    for (auto link{&objects}; *link;) {
+        auto obj{*link};
+        if (obj->mark == epoch) {
+            link = &obj->next;
+            continue;
+        }
 
-    return nullptr;
+        *link = obj->next;
+        freed_objects++;
+        freed_bytes += obj->size;
+        delete obj;
+    }
+
+    num_objects -= freed_objects;
+    num_bytes -= freed_bytes;
+    next_collection = std::max(threshold, num_bytes * 2);
+
+    auto pause{std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start)};
+    stats.collections++;
+    stats.objects_reclaimed += freed_objects;
+    stats.bytes_reclaimed += freed_bytes;
+    stats.total_pause += pause;
+    stats.max_pause = std::max(stats.max_pause, pause);
 }
 
-auto environment::set(const std::string& name, std::unique_ptr<object> val) -> void {
-    store[name] = std::move(val);
+auto heap::set_threshold(usize bytes) -> void {
+    threshold = bytes;
+    next_collection = std::max(bytes, num_bytes);
 }
 
-auto environment::update(const std::string& name, std::unique_ptr<object> val) -> void {
-    if (outer && outer->store.contains(name)) {
-        outer->set(name, std::move(val));
-        return;
-    }
+auto heap::add_roots(const std::vector<value>& vals) -> void {
+    root_vectors.push_back(&vals);
+}
 
-    store[name] = std::move(val);
+auto heap::remove_roots(const std::vector<value>& vals) -> void {
+    std::erase(root_vectors, &vals);
 }
 
-auto environment::contains(const std::string& name) const -> bool {
-    if (store.contains(name)) {
-        return true;
-    }
+auto gc_stats::report() const -> std::string {
+    using ms = std::chrono::duration<double, std::milli>;
 
-    if (outer) {
-        return outer->contains(name);
-    }
+    return std::format(
+        "gc: {} collections, {} objects ({} bytes) reclaimed, {:.3f}ms total pause, {:.3f}ms max pause",
+        collections,
+        objects_reclaimed,
+        bytes_reclaimed,
+        ms{total_pause}.count(),
+        ms{max_pause}.count()
+    );
+}
+
+auto get_heap() -> heap& {
+    static heap h{};
+    return h;
+}
 
-    return false;
+auto string::get_hash_key() const -> hash_key {
+    static std::hash<std::string> hasher{};
+
+    return hash_key{object_type::String, hasher(value)};
 }
 
-auto environment::operator==(const environment& other) const -> bool {
-    return store == other.store && outer == other.outer && envs_inner == other.envs_inner;
+auto environment::trace(heap& h) const -> void {
+    for (auto val : slots) {
+        h.mark(val);
+    }
+    h.mark(outer);
 }
 
 auto function::to_string() const -> std::string {
+    const auto& fn{(*tree)[node]};
     std::stringstream ss{};
     ss << "fn(";
-    for (const auto& p : parameters) {
-        ss << p->to_string();
-        if (p != parameters.back()) {
+    auto parameters{tree->list(fn.a, fn.b)};
+    for (usize i{0}; i < parameters.size(); i++) {
+        ss << tree->to_string(parameters[i]);
+        if (i != parameters.size() - 1) {
             ss << ", ";
         }
     }
-    ss << ") {\n" << body->to_string() << "\n}";
+    ss << ") {\n" << tree->to_string(fn.c) << "\n}";
 
     return ss.str();
 }
 
-function::function(const function& other) : body{other.body->clone()}, env_outer{other.env_outer} {
-    for (const auto& param : other.parameters) {
-        parameters.emplace_back(param->clone());
-    }
-}
-
-array::array(const array& other) {
-    for (const auto& elem : other.elements) {
-        elements.emplace_back(elem->clone());
-    }
-}
-
 auto array::to_string() const -> std::string {
     std::stringstream ss{};
 
     ss << "[";
-    for (const auto& elem : elements) {
-        ss << elem->to_string();
-        if (elem != elements.back()) {
+    for (usize i{0}; i < elements.size(); i++) {
+        ss << elements[i].to_string();
+        if (i != elements.size() - 1) {
             ss << ", ";
         }
     }
@@ -138,9 +214,9 @@ auto array::to_string() const -> std::string {
     return ss.str();
 }
 
-hash::hash(const hash& other) {
-    for (const auto& [key, val] : other.pairs) {
-        pairs[key] = std::make_pair(val.first->clone(), val.second->clone());
+auto array::trace(heap& h) const -> void {
+    for (auto val : elements) {
+        h.mark(val);
     }
 }
 
@@ -148,17 +224,25 @@ auto hash::to_string() const -> std::string {
     std::stringstream ss{};
 
     ss << "{";
-    for (u32 i{0}; const auto& [k, val] : pairs) {
-        ss << val.first->to_string() << ": " << val.second->to_string();
-        if (i != pairs.size() - 1) {
+    usize i{0};
+    pairs.for_each([&](const hash_key&, const std::pair<value, value>& pair) {
+        ss << pair.first.to_string() << ": " << pair.second.to_string();
+        if (i++ != pairs.size() - 1) {
             ss << ", ";
         }
-    }
+    });
     ss << "}";
 
     return ss.str();
 }
 
+auto hash::trace(heap& h) const -> void {
+    pairs.for_each([&](const hash_key&, const std::pair<value, value>& pair) {
+        h.mark(pair.first);
+        h.mark(pair.second);
+    });
+}
+
 }
 
 }
@@ -1,10 +1,15 @@
 #pragma once
 
-#include "ast.h"
+#include "code.h"
+#include "flat_ast.h"
+#include "persistent_hash_map.h"
+#include "persistent_vector.h"
 #include "types.h"
+#include <chrono>
 #include <format>
 #include <functional>
 #include <memory>
+#include <span>
 #include <string>
 #include <unordered_map>
 
@@ -16,27 +21,36 @@ enum class object_type : u8 {
     Integer,
     Boolean,
     Null,
-    ReturnValue,
     Error,
     Function,
     String,
     Builtin,
     Array,
     Hash,
-    BreakValue,
-    ContinueValue,
+    CompiledFunction,
+    Closure,
+    Cell,
+    Environment,
 };
 
 auto get_object_type_string(object_type obj) -> std::string_view;
 
+class heap;
+
 class object {
 public:
     virtual ~object() = default;
 
-    virtual auto clone() const -> std::unique_ptr<object> = 0;
-
     virtual auto type() const -> object_type = 0;
     virtual auto to_string() const -> std::string = 0;
+
+    // Marks every object directly reachable from this one.
+    virtual auto trace(heap&) const -> void {}
+
+public:
+    object* next{};
+    mutable u32 mark{};
+    u32 size{};
 };
 
 class hash_key {
@@ -48,106 +62,203 @@ public:
     u64 value{};
 };
 
-class hashable {
-public:
-    virtual ~hashable() = default;
-
-    virtual auto get_hash_key() const -> hash_key = 0;
-};
-
-class integer : public object, public hashable {
+// Integers, booleans and null are stored inline, everything else lives on the heap and is shared between values.
+// Heap objects are never modified after creation, so copying a value is always O(1) and builtins like push and rest
+// return new objects. An empty value is the result of statements that do not produce anything.
+class value {
 public:
-    integer() {}
-    integer(i64 val) : value{val} {}
+    constexpr value() {}
+    explicit value(object* obj) : kind{value_kind::Object}, obj{obj} {}
 
-    inline auto clone() const -> std::unique_ptr<object> override {
-        return std::make_unique<integer>(*this);
+    static constexpr auto integer(i64 val) -> value {
+        value v{};
+        v.kind = value_kind::Integer;
+        v.int_val = val;
+        return v;
     }
 
-    inline auto type() const -> object_type override {
-        return object_type::Integer;
+    static constexpr auto boolean(bool val) -> value {
+        value v{};
+        v.kind = value_kind::Boolean;
+        v.bool_val = val;
+        return v;
     }
 
-    inline auto to_string() const -> std::string override {
-        return std::format("{}", value);
+    static constexpr auto null() -> value {
+        value v{};
+        v.kind = value_kind::Null;
+        return v;
     }
 
-    auto get_hash_key() const -> hash_key override;
+    inline auto has_value() const -> bool {
+        return kind != value_kind::Empty;
+    }
 
-public:
-    i64 value{};
-};
+    inline auto type() const -> object_type {
+        switch (kind) {
+        case value_kind::Integer:
+            return object_type::Integer;
+        case value_kind::Boolean:
+            return object_type::Boolean;
+        case value_kind::Object:
+            return obj->type();
+        default:
+            return object_type::Null;
+        }
+    }
 
-class boolean : public object, public hashable {
-public:
-    boolean() {}
-    boolean(bool val) : value{val} {}
+    inline auto is_integer() const -> bool {
+        return kind == value_kind::Integer;
+    }
 
-    inline auto clone() const -> std::unique_ptr<object> override {
-        return std::make_unique<boolean>(*this);
+    inline auto is_boolean() const -> bool {
+        return kind == value_kind::Boolean;
     }
 
-    inline auto type() const -> object_type override {
-        return object_type::Boolean;
+    inline auto is_null() const -> bool {
+        return kind == value_kind::Null;
     }
 
-    inline auto to_string() const -> std::string override {
-        return std::format("{}", value);
+    inline auto is_object() const -> bool {
+        return kind == value_kind::Object;
     }
 
-    auto get_hash_key() const -> hash_key override;
+    inline auto is_error() const -> bool {
+        return kind == value_kind::Object && obj->type() == object_type::Error;
+    }
 
-public:
-    bool value{};
-};
+    inline auto as_integer() const -> i64 {
+        return int_val;
+    }
 
-class null : public object {
-public:
-    inline auto clone() const -> std::unique_ptr<object> override {
-        return std::make_unique<null>(*this);
+    inline auto as_boolean() const -> bool {
+        return bool_val;
     }
 
-    inline auto type() const -> object_type override {
-        return object_type::Null;
+    inline auto as_object() const -> object* {
+        return obj;
     }
 
-    inline auto to_string() const -> std::string override {
-        return "null";
+    template <typename T>
+    inline auto as() const -> T& {
+        return static_cast<T&>(*obj);
     }
+
+    auto is_hashable() const -> bool;
+    auto get_hash_key() const -> hash_key;
+
+    auto to_string() const -> std::string;
+
+private:
+    enum class value_kind : u8 {
+        Empty,
+        Null,
+        Boolean,
+        Integer,
+        Object,
+    };
+
+    value_kind kind{value_kind::Empty};
+    union {
+        bool bool_val;
+        i64 int_val;
+        object* obj{};
+    };
+};
+
+static_assert(std::is_trivially_copyable_v<value>);
+
+class gc_stats {
+public:
+    auto report() const -> std::string;
+
+public:
+    usize collections{};
+    usize objects_reclaimed{};
+    usize bytes_reclaimed{};
+    std::chrono::nanoseconds total_pause{};
+    std::chrono::nanoseconds max_pause{};
 };
 
-class return_value : public object {
+// Owns every heap object. Once the objects allocated since the last collection exceed the threshold, a mark-sweep
+// collection frees everything that is not reachable from the roots: the vectors registered with add_roots and the
+// object being allocated. Sizes only count the objects themselves, not the memory they point to.
+class heap {
 public:
-    return_value() {}
-    return_value(std::unique_ptr<object> val) : value{std::move(val)} {}
+    static constexpr usize default_threshold{1 << 20};
+
+    heap() {}
+    heap(const heap&) = delete;
+    auto operator=(const heap&) -> heap& = delete;
+    ~heap();
 
-    return_value(const return_value& val) : value{val.value->clone()} {}
+    template <typename T, typename... Args>
+    auto make(Args&&... args) -> T* {
+        auto obj{new T(std::forward<Args>(args)...)};
+        obj->next = objects;
+        obj->size = sizeof(T);
+        objects = obj;
+        num_objects++;
+        num_bytes += sizeof(T);
 
-    inline auto clone() const -> std::unique_ptr<object> override {
-        return std::make_unique<return_value>(*this);
+        if (num_bytes >= next_collection) {
+            roots.push_back(value{obj});
+            collect();
+            roots.pop_back();
+        }
+
+        return obj;
     }
 
-    inline auto type() const -> object_type override {
-        return object_type::ReturnValue;
+    auto collect() -> void;
+    auto set_threshold(usize bytes) -> void;
+
+    auto add_roots(const std::vector<value>& vals) -> void;
+    auto remove_roots(const std::vector<value>& vals) -> void;
+
+    inline auto mark(const object* obj) -> void {
+        if (obj && obj->mark != epoch) {
+            obj->mark = epoch;
+            gray.push_back(obj);
+        }
     }
 
-    inline auto to_string() const -> std::string override {
-        return value->to_string();
+    inline auto mark(value val) -> void {
+        if (val.is_object()) {
+            mark(val.as_object());
+        }
     }
 
 public:
-    std::unique_ptr<object> value{};
+    usize num_objects{};
+    usize num_bytes{};
+    gc_stats stats{};
+
+    std::vector<value> roots{};
+
+private:
+    object* objects{};
+
+    usize threshold{default_threshold};
+    usize next_collection{default_threshold};
+    u32 epoch{};
+
+    std::vector<const std::vector<value>*> root_vectors{};
+    std::vector<const object*> gray{};
 };
 
+auto get_heap() -> heap&;
+
+template <typename T, typename... Args>
+auto make(Args&&... args) -> value {
+    return value{get_heap().make<T>(std::forward<Args>(args)...)};
+}
+
 class error : public object {
 public:
     error() {}
     error(std::string_view msg) : message{msg} {}
 
-    inline auto clone() const -> std::unique_ptr<object> override {
-        return std::make_unique<error>(*this);
-    }
-
     inline auto type() const -> object_type override {
         return object_type::Error;
     }
@@ -160,34 +271,42 @@ public:
     std::string message{};
 };
 
-class environment {
+// Variables are addressed by the (depth, slot) pairs the resolver assigned to them.
+// Function calls and loop iterations allocate their environments on the heap, so closures can outlive them.
+class environment : public object {
 public:
     environment() {}
-    environment(environment* outer) : outer{outer} {}
+    environment(environment* outer, usize num_slots) : slots(num_slots), outer{outer} {}
+
+    inline auto type() const -> object_type override {
+        return object_type::Environment;
+    }
+
+    inline auto to_string() const -> std::string override {
+        return "environment";
+    }
 
-    auto set(const std::string& name, std::unique_ptr<object> val) -> void;
-    auto get(const std::string& name) const -> const std::unique_ptr<object>*;
-    auto contains(const std::string& name) const -> bool;
-    auto update(const std::string& name, std::unique_ptr<object> val) -> void;
+    auto trace(heap& h) const -> void override;
 
-    auto operator==(const environment& other) const -> bool;
+    inline auto get(usize depth, usize slot) -> value& {
+        auto env{this};
+        for (; depth > 0; depth--) {
+            env = env->outer;
+        }
+
+        return env->slots[slot];
+    }
 
 public:
-    std::unordered_map<std::string, std::unique_ptr<object>> store{};
+    std::vector<value> slots{};
 
     environment* outer{};
-    std::vector<std::unique_ptr<environment>> envs_inner{};
 };
 
 class function : public object {
 public:
-    function(std::vector<std::unique_ptr<ast::expression>> params, std::unique_ptr<ast::statement> b, environment& e)
-        : parameters{std::move(params)}, body{std::move(b)}, env_outer{e} {}
-    function(const function& other);
-
-    inline auto clone() const -> std::unique_ptr<object> override {
-        return std::make_unique<function>(*this);
-    }
+    function(std::shared_ptr<const flat_ast::tree> t, flat_ast::node_index n, environment* e)
+        : tree{std::move(t)}, node{n}, env_outer{e} {}
 
     inline auto type() const -> object_type override {
         return object_type::Function;
@@ -195,21 +314,22 @@ public:
 
     auto to_string() const -> std::string override;
 
+    inline auto trace(heap& h) const -> void override {
+        h.mark(env_outer);
+    }
+
 public:
-    std::vector<std::unique_ptr<ast::expression>> parameters{};
-    std::unique_ptr<ast::statement> body{};
-    environment& env_outer;
+    // The FnExpression node in `tree` the function was created from.
+    std::shared_ptr<const flat_ast::tree> tree{};
+    flat_ast::node_index node{};
+    environment* env_outer{};
 };
 
-class string : public object, public hashable {
+class string : public object {
 public:
     string() {}
     string(const std::string& val) : value{val} {}
 
-    inline auto clone() const -> std::unique_ptr<object> override {
-        return std::make_unique<string>(*this);
-    }
-
     inline auto type() const -> object_type override {
         return object_type::String;
     }
@@ -218,25 +338,21 @@ public:
         return std::format("\"{}\"", value);
     }
 
-    auto get_hash_key() const -> hash_key override;
+    auto get_hash_key() const -> hash_key;
 
 public:
     std::string value{};
 };
 
-using builtin_function = std::function<std::unique_ptr<object>(std::vector<std::unique_ptr<object>>)>;
+using builtin_function = auto (*)(std::span<const value> args) -> value;
 
 class builtin : public object {
 public:
     builtin() {}
-    builtin(const builtin_function& f) : fn{f} {}
-
-    inline auto clone() const -> std::unique_ptr<object> override {
-        return std::make_unique<builtin>(*this);
-    }
+    builtin(builtin_function f) : fn{f} {}
 
     inline auto type() const -> object_type override {
-        return object_type::String;
+        return object_type::Builtin;
     }
 
     inline auto to_string() const -> std::string override {
@@ -244,26 +360,24 @@ public:
     }
 
 public:
-    builtin_function fn;
+    builtin_function fn{};
 };
 
 class array : public object {
 public:
     array() {}
-    array(const array& other);
-
-    inline auto clone() const -> std::unique_ptr<object> override {
-        return std::make_unique<array>(*this);
-    }
+    array(const std::vector<value>& elems) : elements{elems} {}
+    array(persistent::vector<value> elems) : elements{std::move(elems)} {}
 
     inline auto type() const -> object_type override {
         return object_type::Array;
     }
 
     auto to_string() const -> std::string override;
+    auto trace(heap& h) const -> void override;
 
 public:
-    std::vector<std::unique_ptr<object>> elements{};
+    persistent::vector<value> elements{};
 };
 
 }
@@ -286,50 +400,78 @@ namespace object {
 class hash : public object {
 public:
     hash() {}
-    hash(const hash& other);
-
-    inline auto clone() const -> std::unique_ptr<object> override {
-        return std::make_unique<hash>(*this);
-    }
+    hash(persistent::hash_map<hash_key, std::pair<value, value>> p) : pairs{std::move(p)} {}
 
     inline auto type() const -> object_type override {
         return object_type::Hash;
     }
 
     auto to_string() const -> std::string override;
+    auto trace(heap& h) const -> void override;
 
 public:
-    std::unordered_map<hash_key, std::pair<std::unique_ptr<object>, std::unique_ptr<object>>> pairs{};
+    persistent::hash_map<hash_key, std::pair<value, value>> pairs{};
 };
 
-class break_value : public object {
+class compiled_function : public object {
 public:
-    inline auto clone() const -> std::unique_ptr<object> override {
-        return std::make_unique<break_value>(*this);
-    }
+    compiled_function(code::instructions ins, usize num_locals, usize num_parameters)
+        : instructions{std::move(ins)}, num_locals{num_locals}, num_parameters{num_parameters} {}
 
     inline auto type() const -> object_type override {
-        return object_type::BreakValue;
+        return object_type::CompiledFunction;
     }
 
     inline auto to_string() const -> std::string override {
-        return "break";
+        return std::format("CompiledFunction[{}]", static_cast<const void*>(this));
     }
+
+public:
+    code::instructions instructions{};
+    usize num_locals{};
+    usize num_parameters{};
 };
 
-class continue_value : public object {
+class cell : public object {
 public:
-    inline auto clone() const -> std::unique_ptr<object> override {
-        return std::make_unique<continue_value>(*this);
+    inline auto type() const -> object_type override {
+        return object_type::Cell;
+    }
+
+    inline auto to_string() const -> std::string override {
+        return val.to_string();
     }
 
+    inline auto trace(heap& h) const -> void override {
+        h.mark(val);
+    }
+
+public:
+    value val{};
+};
+
+class closure : public object {
+public:
+    closure(const compiled_function* fn) : fn{fn} {}
+
     inline auto type() const -> object_type override {
-        return object_type::ContinueValue;
+        return object_type::Closure;
     }
 
     inline auto to_string() const -> std::string override {
-        return "continue";
+        return std::format("Closure[{}]", static_cast<const void*>(fn));
+    }
+
+    inline auto trace(heap& h) const -> void override {
+        h.mark(fn);
+        for (auto val : free) {
+            h.mark(val);
+        }
     }
+
+public:
+    const compiled_function* fn{};
+    std::vector<value> free{};
 };
 
 }
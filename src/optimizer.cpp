@@ -0,0 +1,670 @@
+#include "optimizer.h"
+#include "ast.h"
+#include "helpers.h"
+
+#include <algorithm>
+#include <format>
+#include <optional>
+#include <utility>
+
+namespace interp {
+
+namespace optimizer {
+
+auto opt_stats::report() const -> std::string {
+    return std::format(
+        "opt: {} expressions folded, {} reads propagated, {} nodes pruned", folded, propagated, pruned
+    );
+}
+
+static auto count_nodes(const ast::node& node) -> usize {
+    usize num{};
+    ast::walk(node, [&](const ast::node&) {
+        num++;
+        return true;
+    });
+
+    return num;
+}
+
+static auto is_literal(const ast::expression& expr) -> bool {
+    return expr.type() == ast::node_type::IntegerLiteral || expr.type() == ast::node_type::BooleanExpression ||
+           expr.type() == ast::node_type::StringLiteral;
+}
+
+// Only false is falsy among the literals, null has none.
+static auto literal_truthiness(const ast::expression& expr) -> std::optional<bool> {
+    if (expr.type() == ast::node_type::BooleanExpression) {
+        return static_cast<const ast::boolean_expression&>(expr).value;
+    } else if (is_literal(expr)) {
+        return true;
+    }
+
+    return std::nullopt;
+}
+
+// Evaluating it cannot fail, call anything or assign anything.
+static auto is_pure(const ast::expression& expr) -> bool {
+    if (is_literal(expr) || expr.type() == ast::node_type::FnExpression) {
+        return true;
+    } else if (expr.type() == ast::node_type::ArrayLiteral) {
+        return std::ranges::all_of(static_cast<const ast::array_literal&>(expr).elements, [](const auto& elem) {
+            return is_pure(*elem);
+        });
+    }
+
+    return false;
+}
+
+static auto is_terminator(const ast::statement& stmt) -> bool {
+    return stmt.type() == ast::node_type::ReturnStatement || stmt.type() == ast::node_type::BreakStatement ||
+           stmt.type() == ast::node_type::ContinueStatement;
+}
+
+// The branch an if with a literal condition always takes, which is null for a false if without an else.
+static auto taken_branch(ast::if_expression& expr) -> std::optional<ast::node_ptr<ast::statement>*> {
+    auto truthy{literal_truthiness(*expr.condition)};
+    if (!truthy.has_value()) {
+        return std::nullopt;
+    }
+
+    return *truthy ? &expr.consequence : &expr.alternative;
+}
+
+// The same for an if that is a statement of its own, nothing for any other statement.
+static auto taken_branch(ast::statement& stmt) -> std::optional<ast::node_ptr<ast::statement>*> {
+    if (stmt.type() != ast::node_type::ExpressionStatement) {
+        return std::nullopt;
+    }
+
+    auto& expr{static_cast<ast::expression_statement&>(stmt).expr};
+    if (expr == nullptr || expr->type() != ast::node_type::IfExpression) {
+        return std::nullopt;
+    }
+
+    return taken_branch(static_cast<ast::if_expression&>(*expr));
+}
+
+// Nothing if the result overflows, it is left to wrap around at runtime.
+static auto fold_integer(ast::operator_type oper, i64 left, i64 right) -> std::optional<i64> {
+    i64 result{};
+    bool overflow{};
+
+    switch (oper) {
+    case ast::operator_type::Plus: {
+        overflow = helpers::add_overflow(left, right, result);
+    } break;
+
+    case ast::operator_type::Minus: {
+        overflow = helpers::sub_overflow(left, right, result);
+    } break;
+
+    case ast::operator_type::Asterisk: {
+        overflow = helpers::mul_overflow(left, right, result);
+    } break;
+
+    case ast::operator_type::Slash: {
+        if (right == 0) {
+            return std::nullopt;
+        }
+        overflow = helpers::div_overflow(left, right, result);
+    } break;
+
+    default: {
+        return std::nullopt;
+    } break;
+    }
+
+    if (overflow) {
+        return std::nullopt;
+    }
+
+    return result;
+}
+
+static auto compare_integer(ast::operator_type oper, i64 left, i64 right) -> std::optional<bool> {
+    switch (oper) {
+    case ast::operator_type::Lt:
+        return left < right;
+    case ast::operator_type::Gt:
+        return left > right;
+    case ast::operator_type::Eq:
+        return left == right;
+    case ast::operator_type::NotEq:
+        return left != right;
+    default:
+        return std::nullopt;
+    }
+}
+
+auto optimizer::optimize(ast::program& program) -> void {
+    node_arena = program.node_arena.get();
+    lets.clear();
+    reads.clear();
+    assigned.clear();
+    constants.clear();
+
+    scopes = {&program};
+    for (auto& stmt : program.statements) {
+        count(*stmt);
+    }
+
+    scopes = {&program};
+    optimize_statements(program.statements, true);
+    constants.clear();
+
+    // Removing a let can leave the bindings its value read unread, so this runs until nothing changes.
+    usize pruned{};
+    do {
+        pruned = stats.pruned;
+
+        lets.clear();
+        reads.clear();
+        assigned.clear();
+
+        scopes = {&program};
+        for (auto& stmt : program.statements) {
+            count(*stmt);
+        }
+
+        scopes = {&program};
+        prune_statements(program.statements);
+    } while (stats.pruned != pruned);
+}
+
+auto optimizer::binding_of(const ast::identifier& ident) const -> binding {
+    return binding{scopes[scopes.size() - 1 - ident.depth], ident.slot};
+}
+
+// Counts the lets and reads of every binding and finds the ones that are assigned to, scopes follow the resolver's.
+auto optimizer::count(ast::node& node) -> void {
+    switch (node.type()) {
+    case ast::node_type::Identifier: {
+        auto& ident{static_cast<ast::identifier&>(node)};
+        if (!ident.builtin) {
+            reads[binding_of(ident)]++;
+        }
+    } break;
+
+    case ast::node_type::LetStatement: {
+        auto& let{static_cast<ast::let_statement&>(node)};
+        lets[binding_of(let.name)]++;
+        count(*let.value);
+    } break;
+
+    case ast::node_type::AssignExpression: {
+        auto& assign{static_cast<ast::assign_expression&>(node)};
+        if (assign.name->type() == ast::node_type::Identifier) {
+            auto& ident{static_cast<ast::identifier&>(*assign.name)};
+            if (!ident.builtin) {
+                assigned.insert(binding_of(ident));
+            }
+        }
+        count(*assign.value);
+    } break;
+
+    case ast::node_type::FnExpression: {
+        auto& proto{*static_cast<ast::fn_expression&>(node).prototype};
+        scopes.push_back(&proto);
+        count(*proto.body);
+        scopes.pop_back();
+    } break;
+
+    case ast::node_type::WhileStatement: {
+        auto& stmt{static_cast<ast::while_statement&>(node)};
+        count(*stmt.condition);
+        scopes.push_back(&stmt);
+        count(*stmt.body);
+        scopes.pop_back();
+    } break;
+
+    case ast::node_type::InfixExpression: {
+        auto spine{ast::left_spine(static_cast<ast::infix_expression&>(node))};
+        count(*spine.back()->left);
+        for (auto it{spine.rbegin()}; it != spine.rend(); it++) {
+            count(*(*it)->right);
+        }
+    } break;
+
+    default: {
+        ast::for_each_child(node, [&](ast::node& child) { count(child); });
+    } break;
+    }
+}
+
+// Only lets directly in the body of a scope are propagated: one inside an if might not run, and reads before the let
+// find the variable empty.
+auto optimizer::optimize_statements(std::vector<ast::node_ptr<ast::statement>>& statements, bool scope_body)
+    -> void {
+    for (auto& stmt : statements) {
+        optimize_node(*stmt);
+
+        if (!scope_body || stmt->type() != ast::node_type::LetStatement) {
+            continue;
+        }
+
+        auto& let{static_cast<ast::let_statement&>(*stmt)};
+        if (let.value == nullptr || !is_literal(*let.value)) {
+            continue;
+        }
+
+        auto b{binding_of(let.name)};
+        if (lets[b] == 1 && !assigned.contains(b)) {
+            constants[b] = let.value.get();
+        }
+    }
+}
+
+auto optimizer::optimize_node(ast::node& node) -> void {
+    switch (node.type()) {
+    case ast::node_type::BlockStatement: {
+        optimize_statements(static_cast<ast::block_statement&>(node).statements, false);
+    } break;
+
+    case ast::node_type::LetStatement: {
+        optimize_expr(static_cast<ast::let_statement&>(node).value);
+    } break;
+
+    case ast::node_type::ReturnStatement: {
+        optimize_expr(static_cast<ast::return_statement&>(node).value);
+    } break;
+
+    case ast::node_type::ExpressionStatement: {
+        optimize_expr(static_cast<ast::expression_statement&>(node).expr);
+    } break;
+
+    case ast::node_type::WhileStatement: {
+        auto& stmt{static_cast<ast::while_statement&>(node)};
+        optimize_expr(stmt.condition);
+
+        scopes.push_back(&stmt);
+        optimize_statements(static_cast<ast::block_statement&>(*stmt.body).statements, true);
+        scopes.pop_back();
+    } break;
+
+    default: {
+    } break;
+    }
+}
+
+auto optimizer::optimize_expr(ast::node_ptr<ast::expression>& expr) -> void {
+    if (expr == nullptr) {
+        return;
+    }
+
+    switch (expr->type()) {
+    case ast::node_type::Identifier: {
+        auto& ident{static_cast<ast::identifier&>(*expr)};
+        if (ident.builtin) {
+            break;
+        }
+
+        if (auto it{constants.find(binding_of(ident))}; it != constants.end()) {
+            expr = copy_literal(*it->second, ident.span);
+            stats.propagated++;
+        }
+    } break;
+
+    case ast::node_type::PrefixExpression: {
+        auto& prefix{static_cast<ast::prefix_expression&>(*expr)};
+        optimize_expr(prefix.right);
+
+        if (auto folded{fold_prefix(prefix)}) {
+            expr = std::move(folded);
+            stats.folded++;
+        }
+    } break;
+
+    // Folded from the innermost operator out, each one replacing itself in its parent.
+    case ast::node_type::InfixExpression: {
+        auto spine{ast::left_spine(static_cast<ast::infix_expression&>(*expr))};
+        optimize_expr(spine.back()->left);
+        for (auto i{spine.size()}; i-- > 0;) {
+            auto& infix{*spine[i]};
+            optimize_expr(infix.right);
+
+            if (auto folded{fold_infix(infix)}) {
+                (i == 0 ? expr : spine[i - 1]->left) = std::move(folded);
+                stats.folded++;
+            }
+        }
+    } break;
+
+    case ast::node_type::IfExpression: {
+        auto& if_expr{static_cast<ast::if_expression&>(*expr)};
+        optimize_expr(if_expr.condition);
+        optimize_node(*if_expr.consequence);
+        if (if_expr.alternative != nullptr) {
+            optimize_node(*if_expr.alternative);
+        }
+    } break;
+
+    case ast::node_type::FnExpression: {
+        auto& proto{*static_cast<ast::fn_expression&>(*expr).prototype};
+
+        scopes.push_back(&proto);
+        optimize_statements(static_cast<ast::block_statement&>(*proto.body).statements, true);
+        scopes.pop_back();
+    } break;
+
+    case ast::node_type::CallExpression: {
+        auto& call{static_cast<ast::call_expression&>(*expr)};
+        optimize_expr(call.fn);
+        for (auto& arg : call.arguments) {
+            optimize_expr(arg);
+        }
+    } break;
+
+    case ast::node_type::ArrayLiteral: {
+        for (auto& elem : static_cast<ast::array_literal&>(*expr).elements) {
+            optimize_expr(elem);
+        }
+    } break;
+
+    case ast::node_type::IndexExpression: {
+        auto& index{static_cast<ast::index_expression&>(*expr)};
+        optimize_expr(index.left);
+        optimize_expr(index.index);
+    } break;
+
+    case ast::node_type::HashLiteral: {
+        rewrite_pairs(static_cast<ast::hash_literal&>(*expr), &optimizer::optimize_expr);
+    } break;
+
+    case ast::node_type::AssignExpression: {
+        optimize_expr(static_cast<ast::assign_expression&>(*expr).value);
+    } break;
+
+    default: {
+    } break;
+    }
+}
+
+auto optimizer::fold_prefix(ast::prefix_expression& expr) -> ast::node_ptr<ast::expression> {
+    if (expr.right == nullptr || !is_literal(*expr.right)) {
+        return nullptr;
+    }
+
+    const auto& right{*expr.right};
+
+    switch (expr.oper) {
+    // Only false and null are falsy, so every other literal negates to false.
+    case ast::operator_type::Bang: {
+        auto value{right.type() == ast::node_type::BooleanExpression &&
+                   !static_cast<const ast::boolean_expression&>(right).value};
+        return node_arena->make<ast::boolean_expression>(expr.span, value);
+    } break;
+
+    case ast::operator_type::Minus: {
+        if (right.type() != ast::node_type::IntegerLiteral) {
+            return nullptr;
+        }
+
+        i64 value{};
+        if (helpers::neg_overflow(static_cast<const ast::integer_literal&>(right).value, value)) {
+            return nullptr;
+        }
+
+        return node_arena->make<ast::integer_literal>(expr.span, value);
+    } break;
+
+    default: {
+        return nullptr;
+    } break;
+    }
+}
+
+// Mirrors the operand combinations eval_infix_expression accepts, everything else is left to fail at runtime.
+auto optimizer::fold_infix(ast::infix_expression& expr) -> ast::node_ptr<ast::expression> {
+    if (expr.left == nullptr || expr.right == nullptr || expr.left->type() != expr.right->type()) {
+        return nullptr;
+    }
+
+    switch (expr.left->type()) {
+    case ast::node_type::IntegerLiteral: {
+        auto left{static_cast<const ast::integer_literal&>(*expr.left).value};
+        auto right{static_cast<const ast::integer_literal&>(*expr.right).value};
+
+        if (auto value{fold_integer(expr.oper, left, right)}) {
+            return node_arena->make<ast::integer_literal>(expr.span, *value);
+        } else if (auto value{compare_integer(expr.oper, left, right)}) {
+            return node_arena->make<ast::boolean_expression>(expr.span, *value);
+        }
+    } break;
+
+    case ast::node_type::BooleanExpression: {
+        auto left{static_cast<const ast::boolean_expression&>(*expr.left).value};
+        auto right{static_cast<const ast::boolean_expression&>(*expr.right).value};
+
+        if (expr.oper == ast::operator_type::Eq) {
+            return node_arena->make<ast::boolean_expression>(expr.span, left == right);
+        } else if (expr.oper == ast::operator_type::NotEq) {
+            return node_arena->make<ast::boolean_expression>(expr.span, left != right);
+        }
+    } break;
+
+    case ast::node_type::StringLiteral: {
+        if (expr.oper == ast::operator_type::Plus) {
+            auto value{concat(
+                static_cast<const ast::string_literal&>(*expr.left).value,
+                static_cast<const ast::string_literal&>(*expr.right).value
+            )};
+            return node_arena->make<ast::string_literal>(expr.span, value);
+        }
+    } break;
+
+    default: {
+    } break;
+    }
+
+    return nullptr;
+}
+
+auto optimizer::copy_literal(const ast::expression& literal, ast::source_span span) -> ast::node_ptr<ast::expression> {
+    switch (literal.type()) {
+    case ast::node_type::IntegerLiteral:
+        return node_arena->make<ast::integer_literal>(span, static_cast<const ast::integer_literal&>(literal).value);
+    case ast::node_type::BooleanExpression:
+        return node_arena->make<ast::boolean_expression>(
+            span, static_cast<const ast::boolean_expression&>(literal).value
+        );
+    case ast::node_type::StringLiteral:
+        return node_arena->make<ast::string_literal>(span, static_cast<const ast::string_literal&>(literal).value);
+    default:
+        std::unreachable();
+    }
+}
+
+// Folded strings are not in the source, they are kept in the arena next to the nodes that view them.
+auto optimizer::concat(std::string_view left, std::string_view right) -> std::string_view {
+    auto len{left.size() + right.size()};
+    auto mem{static_cast<char*>(node_arena->allocate(len, alignof(char)))};
+
+    std::ranges::copy(left, mem);
+    std::ranges::copy(right, mem + left.size());
+
+    return std::string_view{mem, len};
+}
+
+// Ifs whose branch is known are replaced by the statements of that branch, they are in the same scope.
+auto optimizer::prune_statements(std::vector<ast::node_ptr<ast::statement>>& statements) -> void {
+    std::vector<ast::node_ptr<ast::statement>> kept{};
+
+    for (usize i{0}; i < statements.size(); i++) {
+        auto& stmt{statements[i]};
+        auto last{i == statements.size() - 1};
+        prune_node(*stmt);
+
+        if (!last && stmt->type() == ast::node_type::LetStatement &&
+            unused(static_cast<const ast::let_statement&>(*stmt))) {
+            stats.pruned += count_nodes(*stmt);
+            continue;
+        }
+
+        auto branch{taken_branch(*stmt)};
+        if (!branch.has_value()) {
+            kept.push_back(std::move(stmt));
+        } else if (auto block{static_cast<ast::block_statement*>((*branch)->get())};
+                   block != nullptr && !block->statements.empty()) {
+            for (auto& inner : block->statements) {
+                kept.push_back(std::move(inner));
+            }
+            block->statements.clear();
+            stats.pruned += count_nodes(*stmt);
+        } else if (!last) {
+            stats.pruned += count_nodes(*stmt);
+        } else {
+            kept.push_back(std::move(stmt));
+        }
+
+        if (!kept.empty() && is_terminator(*kept.back())) {
+            for (usize j{i + 1}; j < statements.size(); j++) {
+                stats.pruned += count_nodes(*statements[j]);
+            }
+            break;
+        }
+    }
+
+    statements = std::move(kept);
+}
+
+auto optimizer::prune_node(ast::node& node) -> void {
+    switch (node.type()) {
+    case ast::node_type::BlockStatement: {
+        prune_statements(static_cast<ast::block_statement&>(node).statements);
+    } break;
+
+    case ast::node_type::LetStatement: {
+        prune_expr(static_cast<ast::let_statement&>(node).value);
+    } break;
+
+    case ast::node_type::ReturnStatement: {
+        prune_expr(static_cast<ast::return_statement&>(node).value);
+    } break;
+
+    case ast::node_type::ExpressionStatement: {
+        prune_expr(static_cast<ast::expression_statement&>(node).expr);
+    } break;
+
+    case ast::node_type::WhileStatement: {
+        auto& stmt{static_cast<ast::while_statement&>(node)};
+        prune_expr(stmt.condition);
+
+        scopes.push_back(&stmt);
+        prune_node(*stmt.body);
+        scopes.pop_back();
+    } break;
+
+    default: {
+    } break;
+    }
+}
+
+auto optimizer::prune_expr(ast::node_ptr<ast::expression>& expr) -> void {
+    if (expr == nullptr) {
+        return;
+    }
+
+    switch (expr->type()) {
+    case ast::node_type::PrefixExpression: {
+        prune_expr(static_cast<ast::prefix_expression&>(*expr).right);
+    } break;
+
+    case ast::node_type::InfixExpression: {
+        auto spine{ast::left_spine(static_cast<ast::infix_expression&>(*expr))};
+        prune_expr(spine.back()->left);
+        for (auto it{spine.rbegin()}; it != spine.rend(); it++) {
+            prune_expr((*it)->right);
+        }
+    } break;
+
+    // A taken branch holding a single expression replaces the if wherever it is, other ifs are only replaced when
+    // they are a statement of their own.
+    case ast::node_type::IfExpression: {
+        auto& if_expr{static_cast<ast::if_expression&>(*expr)};
+        prune_expr(if_expr.condition);
+        prune_node(*if_expr.consequence);
+        if (if_expr.alternative != nullptr) {
+            prune_node(*if_expr.alternative);
+        }
+
+        auto branch{taken_branch(if_expr)};
+        if (!branch.has_value() || **branch == nullptr) {
+            break;
+        }
+
+        auto& statements{static_cast<ast::block_statement&>(***branch).statements};
+        if (statements.size() != 1 || statements[0]->type() != ast::node_type::ExpressionStatement) {
+            break;
+        }
+
+        auto kept{std::move(static_cast<ast::expression_statement&>(*statements[0]).expr)};
+        stats.pruned += count_nodes(*expr) - count_nodes(*kept);
+        expr = std::move(kept);
+    } break;
+
+    case ast::node_type::FnExpression: {
+        auto& proto{*static_cast<ast::fn_expression&>(*expr).prototype};
+
+        scopes.push_back(&proto);
+        prune_node(*proto.body);
+        scopes.pop_back();
+    } break;
+
+    case ast::node_type::CallExpression: {
+        auto& call{static_cast<ast::call_expression&>(*expr)};
+        prune_expr(call.fn);
+        for (auto& arg : call.arguments) {
+            prune_expr(arg);
+        }
+    } break;
+
+    case ast::node_type::ArrayLiteral: {
+        for (auto& elem : static_cast<ast::array_literal&>(*expr).elements) {
+            prune_expr(elem);
+        }
+    } break;
+
+    case ast::node_type::IndexExpression: {
+        auto& index{static_cast<ast::index_expression&>(*expr)};
+        prune_expr(index.left);
+        prune_expr(index.index);
+    } break;
+
+    case ast::node_type::HashLiteral: {
+        rewrite_pairs(static_cast<ast::hash_literal&>(*expr), &optimizer::prune_expr);
+    } break;
+
+    case ast::node_type::AssignExpression: {
+        prune_expr(static_cast<ast::assign_expression&>(*expr).value);
+    } break;
+
+    default: {
+    } break;
+    }
+}
+
+// Keys are const inside the map, so every pair is taken out, rewritten by `fn` and put back.
+auto optimizer::rewrite_pairs(ast::hash_literal& hash, expr_fn fn) -> void {
+    std::vector<decltype(ast::hash_literal::pairs)::node_type> entries{};
+    while (!hash.pairs.empty()) {
+        entries.push_back(hash.pairs.extract(hash.pairs.begin()));
+    }
+
+    for (auto& entry : entries) {
+        (this->*fn)(entry.key());
+        (this->*fn)(entry.mapped());
+        hash.pairs.insert(std::move(entry));
+    }
+}
+
+// Assigning to a variable without a let fails, so assigned bindings keep theirs even if they are never read.
+auto optimizer::unused(const ast::let_statement& let) -> bool {
+    auto b{binding_of(let.name)};
+
+    return let.value != nullptr && reads[b] == 0 && !assigned.contains(b) && is_pure(*let.value);
+}
+
+}
+
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include "ast.h"
+#include "types.h"
+
+#include <map>
+#include <set>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace interp {
+
+namespace optimizer {
+
+class opt_stats {
+public:
+    auto report() const -> std::string;
+
+public:
+    usize folded{};
+    usize propagated{};
+    // Counts every node of a removed subtree, not only its root.
+    usize pruned{};
+};
+
+// Folds prefix and infix expressions whose operands are integer, boolean or string literals, and replaces reads of
+// let bindings that always hold a literal with that literal. The program has to be resolved first. Expressions that
+// would fail at runtime (type mismatches, division by zero, overflow) are left for the evaluator to report.
+//
+// Afterwards dead code is removed: branches of ifs with a literal condition that are never taken, statements after a
+// return, break or continue, and lets of bindings that are never read or assigned whose value has no side effects.
+// The last statement of a list is what the list evaluates to, so it is only removed when it cannot be reached.
+class optimizer {
+public:
+    auto optimize(ast::program& program) -> void;
+
+public:
+    opt_stats stats{};
+
+private:
+    // The node owning the scope a variable lives in (the program, a fn_prototype or a while_statement) and its slot.
+    using binding = std::pair<const void*, u32>;
+    using expr_fn = auto (optimizer::*)(ast::node_ptr<ast::expression>& expr) -> void;
+
+    auto binding_of(const ast::identifier& ident) const -> binding;
+
+    auto count(ast::node& node) -> void;
+
+    auto optimize_statements(std::vector<ast::node_ptr<ast::statement>>& statements, bool scope_body) -> void;
+    auto optimize_node(ast::node& node) -> void;
+    auto optimize_expr(ast::node_ptr<ast::expression>& expr) -> void;
+
+    auto fold_prefix(ast::prefix_expression& expr) -> ast::node_ptr<ast::expression>;
+    auto fold_infix(ast::infix_expression& expr) -> ast::node_ptr<ast::expression>;
+    auto copy_literal(const ast::expression& literal, ast::source_span span) -> ast::node_ptr<ast::expression>;
+    auto concat(std::string_view left, std::string_view right) -> std::string_view;
+
+    auto prune_statements(std::vector<ast::node_ptr<ast::statement>>& statements) -> void;
+    auto prune_node(ast::node& node) -> void;
+    auto prune_expr(ast::node_ptr<ast::expression>& expr) -> void;
+    auto unused(const ast::let_statement& let) -> bool;
+
+    auto rewrite_pairs(ast::hash_literal& hash, expr_fn fn) -> void;
+
+private:
+    ast::arena* node_arena{};
+    std::vector<const void*> scopes{};
+
+    std::map<binding, usize> lets{};
+    std::map<binding, usize> reads{};
+    std::set<binding> assigned{};
+    // Bindings whose let has run by the time the statements after it run, with the literal they hold.
+    std::map<binding, const ast::expression*> constants{};
+};
+
+}
+
+}
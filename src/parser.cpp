@@ -1,89 +1,55 @@
 #include "parser.h"
 #include "ast.h"
+#include "helpers.h"
 #include "token.h"
 
+#include <algorithm>
+#include <array>
+#include <cstdint>
 #include <format>
 #include <memory>
-#include <stdexcept>
+#include <system_error>
 
 namespace interp {
 
 namespace parser {
 
-std::unordered_map<token::token_type, expr_precedence> parser::precedences{
-    {token::token_type::Eq,       expr_precedence::Equals     },
-    {token::token_type::NotEq,    expr_precedence::Equals     },
-    {token::token_type::Lt,       expr_precedence::LessGreater},
-    {token::token_type::Gt,       expr_precedence::LessGreater},
-    {token::token_type::Plus,     expr_precedence::Sum        },
-    {token::token_type::Minus,    expr_precedence::Sum        },
-    {token::token_type::Slash,    expr_precedence::Product    },
-    {token::token_type::Asterisk, expr_precedence::Product    },
-    {token::token_type::Lparen,   expr_precedence::Call       },
-    {token::token_type::Lbracket, expr_precedence::Index      },
-    {token::token_type::Assign,   expr_precedence::Assign     },
-};
-
 auto parser::no_prefix_parse_fn(token::token_type tt) -> void {
     errors.push_back(std::format("no prefix parse function found for token_type '{}'", token::get_token_type_string(tt))
     );
 }
 
-auto parse_identifier(parser& p) -> std::unique_ptr<ast::identifier> {
-    return std::make_unique<ast::identifier>(p.curr_token, p.curr_token.literal);
+// Every enclosing expression gives up too, only the first of them reports it.
+auto parser::too_deep() -> void {
+    auto msg{std::format("expression nested deeper than {} levels", max_depth)};
+    if (errors.empty() || errors.back() != msg) {
+        errors.push_back(std::move(msg));
+    }
+}
+
+auto parse_identifier(parser& p) -> ast::node_ptr<ast::expression> {
+    return p.make<ast::identifier>(p.curr_token.literal);
 }
 
-auto parse_integer_literal(parser& p) -> std::unique_ptr<ast::integer_literal> {
+auto parse_integer_literal(parser& p) -> ast::node_ptr<ast::expression> {
     i64 value = 0;
-    try {
-        value = std::stol(p.curr_token.literal);
-    } catch (const std::exception& e) {
+    if (auto ec{helpers::parse_i64(p.curr_token.literal, value)}; ec == std::errc::result_out_of_range) {
+        p.errors.push_back(std::format("integer {} is out of range", p.curr_token.literal));
+        return nullptr;
+    } else if (ec != std::errc{}) {
         p.errors.push_back(std::format("couldnt parse {} as integer", p.curr_token.literal));
         return nullptr;
     }
 
-    return std::make_unique<ast::integer_literal>(p.curr_token, value);
-}
-
-auto parse_prefix_expression(parser& p) -> std::unique_ptr<ast::prefix_expression> {
-    auto expr = std::make_unique<ast::prefix_expression>(p.curr_token, p.curr_token.literal);
-
-    p.next_token();
-
-    expr->right = p.parse_expr(expr_precedence::Prefix);
-
-    return expr;
-}
-
-auto parse_infix_expression(std::unique_ptr<ast::expression> left, parser& p)
-    -> std::unique_ptr<ast::infix_expression> {
-    auto expr = std::make_unique<ast::infix_expression>(p.curr_token, p.curr_token.literal, std::move(left));
-
-    auto precedence{p.curr_precedence()};
-    p.next_token();
-    expr->right = p.parse_expr(precedence);
-
-    return expr;
-}
-
-auto parse_boolean_expression(parser& p) -> std::unique_ptr<ast::boolean_expression> {
-    return std::make_unique<ast::boolean_expression>(p.curr_token, p.curr_token.type == token::token_type::True);
+    return p.make<ast::integer_literal>(value);
 }
 
-auto parse_grouped_expression(parser& p) -> std::unique_ptr<ast::expression> {
-    p.next_token();
-
-    auto expr{p.parse_expr(expr_precedence::Lowest)};
-
-    if (!p.expect_peek(token::token_type::Rparen)) {
-        return nullptr;
-    }
-
-    return expr;
+auto parse_boolean_expression(parser& p) -> ast::node_ptr<ast::expression> {
+    return p.make<ast::boolean_expression>(p.curr_token.type == token::token_type::True);
 }
 
-auto parse_if_expression(parser& p) -> std::unique_ptr<ast::if_expression> {
-    auto expr{std::make_unique<ast::if_expression>(p.curr_token)};
+auto parse_if_expression(parser& p) -> ast::node_ptr<ast::expression> {
+    auto expr{p.make<ast::if_expression>()};
 
     p.next_token();
     expr->condition = p.parse_expr(expr_precedence::Lowest);
@@ -93,6 +59,9 @@ auto parse_if_expression(parser& p) -> std::unique_ptr<ast::if_expression> {
     }
 
     expr->consequence = p.parse_block_stmt();
+    if (expr->consequence == nullptr) {
+        return nullptr;
+    }
 
     if (p.peek_token.type != token::token_type::Else) {
         return expr;
@@ -105,50 +74,57 @@ auto parse_if_expression(parser& p) -> std::unique_ptr<ast::if_expression> {
     }
 
     expr->alternative = p.parse_block_stmt();
+    if (expr->alternative == nullptr) {
+        return nullptr;
+    }
 
     return expr;
 }
 
-auto parse_fn_expression(parser& p) -> std::unique_ptr<ast::fn_expression> {
-    auto expr{std::make_unique<ast::fn_expression>(p.curr_token)};
+auto parse_fn_expression(parser& p) -> ast::node_ptr<ast::expression> {
+    auto expr{p.make<ast::fn_expression>()};
+    expr->prototype->node_arena = p.node_arena;
 
     if (!p.expect_peek(token::token_type::Lparen)) {
         return nullptr;
     }
 
-    expr->parameters = p.parse_fn_parameters();
+    expr->prototype->parameters = p.parse_fn_parameters();
 
     if (!p.expect_peek(token::token_type::Lbrace)) {
         return nullptr;
     }
 
-    expr->body = p.parse_block_stmt();
+    expr->prototype->body = p.parse_block_stmt();
+    if (expr->prototype->body == nullptr) {
+        return nullptr;
+    }
 
     return expr;
 }
 
-auto parse_call_expression(std::unique_ptr<ast::expression> left, parser& p) -> std::unique_ptr<ast::call_expression> {
-    auto expr{std::make_unique<ast::call_expression>(p.curr_token, std::move(left))};
+auto parse_call_expression(ast::node_ptr<ast::expression> left, parser& p) -> ast::node_ptr<ast::expression> {
+    auto expr{p.make<ast::call_expression>(std::move(left))};
 
     expr->arguments = p.parse_expression_list(token::token_type::Rparen);
 
     return expr;
 }
 
-auto parse_string_literal(parser& p) -> std::unique_ptr<ast::expression> {
-    return std::make_unique<ast::string_literal>(p.curr_token, p.curr_token.literal);
+auto parse_string_literal(parser& p) -> ast::node_ptr<ast::expression> {
+    return p.make<ast::string_literal>(p.curr_token.literal);
 }
 
-auto parse_array_literal(parser& p) -> std::unique_ptr<ast::expression> {
-    auto expr{std::make_unique<ast::array_literal>(p.curr_token)};
+auto parse_array_literal(parser& p) -> ast::node_ptr<ast::expression> {
+    auto expr{p.make<ast::array_literal>()};
 
     expr->elements = p.parse_expression_list(token::token_type::Rbracket);
 
     return expr;
 }
 
-auto parse_index_expression(std::unique_ptr<ast::expression> left, parser& p) -> std::unique_ptr<ast::expression> {
-    auto expr{std::make_unique<ast::index_expression>(p.curr_token, std::move(left))};
+auto parse_index_expression(ast::node_ptr<ast::expression> left, parser& p) -> ast::node_ptr<ast::expression> {
+    auto expr{p.make<ast::index_expression>(std::move(left))};
 
     p.next_token();
 
@@ -161,8 +137,8 @@ auto parse_index_expression(std::unique_ptr<ast::expression> left, parser& p) ->
     return expr;
 }
 
-auto parse_hash_literal(parser& p) -> std::unique_ptr<ast::expression> {
-    auto expr{std::make_unique<ast::hash_literal>(p.curr_token)};
+auto parse_hash_literal(parser& p) -> ast::node_ptr<ast::expression> {
+    auto expr{p.make<ast::hash_literal>()};
 
     while (p.peek_token.type != token::token_type::Rbrace) {
         p.next_token();
@@ -189,56 +165,63 @@ auto parse_hash_literal(parser& p) -> std::unique_ptr<ast::expression> {
     return expr;
 }
 
-auto parse_assign_expression(std::unique_ptr<ast::expression> left, parser& p) -> std::unique_ptr<ast::expression> {
-    if (!dynamic_cast<ast::identifier*>(left.get())) {
-        return nullptr;
-    }
-
-    auto expr{std::make_unique<ast::assign_expression>(p.curr_token, std::move(left))};
-
-    p.next_token();
-
-    expr->value = p.parse_expr(expr_precedence::Lowest);
-
-    if (p.peek_token.type == token::token_type::Semicolon) {
-        p.next_token();
-    }
-
-    return expr;
+static constexpr usize num_token_types{static_cast<usize>(token::token_type::Continue) + 1};
+
+// Prefix operators and parentheses are handled by parse_expr itself.
+static constexpr auto prefix_parser_fns{[] {
+    std::array<prefix_parser_fn, num_token_types> fns{};
+    fns[static_cast<usize>(token::token_type::Ident)] = parse_identifier;
+    fns[static_cast<usize>(token::token_type::Int)] = parse_integer_literal;
+    fns[static_cast<usize>(token::token_type::True)] = parse_boolean_expression;
+    fns[static_cast<usize>(token::token_type::False)] = parse_boolean_expression;
+    fns[static_cast<usize>(token::token_type::If)] = parse_if_expression;
+    fns[static_cast<usize>(token::token_type::Function)] = parse_fn_expression;
+    fns[static_cast<usize>(token::token_type::String)] = parse_string_literal;
+    fns[static_cast<usize>(token::token_type::Lbracket)] = parse_array_literal;
+    fns[static_cast<usize>(token::token_type::Lbrace)] = parse_hash_literal;
+    return fns;
+}()};
+
+// Binary operators and assignments are handled by parse_expr itself.
+static constexpr auto infix_parser_fns{[] {
+    std::array<infix_parser_fn, num_token_types> fns{};
+    fns[static_cast<usize>(token::token_type::Lparen)] = parse_call_expression;
+    fns[static_cast<usize>(token::token_type::Lbracket)] = parse_index_expression;
+    return fns;
+}()};
+
+// Tokens that cannot continue an expression stay at Lowest.
+static constexpr auto precedences{[] {
+    std::array<expr_precedence, num_token_types> precs{};
+    precs[static_cast<usize>(token::token_type::Eq)] = expr_precedence::Equals;
+    precs[static_cast<usize>(token::token_type::NotEq)] = expr_precedence::Equals;
+    precs[static_cast<usize>(token::token_type::Lt)] = expr_precedence::LessGreater;
+    precs[static_cast<usize>(token::token_type::Gt)] = expr_precedence::LessGreater;
+    precs[static_cast<usize>(token::token_type::Plus)] = expr_precedence::Sum;
+    precs[static_cast<usize>(token::token_type::Minus)] = expr_precedence::Sum;
+    precs[static_cast<usize>(token::token_type::Slash)] = expr_precedence::Product;
+    precs[static_cast<usize>(token::token_type::Asterisk)] = expr_precedence::Product;
+    precs[static_cast<usize>(token::token_type::Lparen)] = expr_precedence::Call;
+    precs[static_cast<usize>(token::token_type::Lbracket)] = expr_precedence::Index;
+    precs[static_cast<usize>(token::token_type::Assign)] = expr_precedence::Assign;
+    return precs;
+}()};
+
+parser::parser(lexer::lexer& l) : lexer{&l}, input{l.get_input()} {
+    errors = l.errors;
+    next_token();
+    next_token();
 }
 
-parser::parser(lexer::lexer& l) : lexer{l} {
-    prefix_parser_fns[token::token_type::Ident] = parse_identifier;
-    prefix_parser_fns[token::token_type::Int] = parse_integer_literal;
-    prefix_parser_fns[token::token_type::Bang] = parse_prefix_expression;
-    prefix_parser_fns[token::token_type::Minus] = parse_prefix_expression;
-    prefix_parser_fns[token::token_type::True] = parse_boolean_expression;
-    prefix_parser_fns[token::token_type::False] = parse_boolean_expression;
-    prefix_parser_fns[token::token_type::Lparen] = parse_grouped_expression;
-    prefix_parser_fns[token::token_type::If] = parse_if_expression;
-    prefix_parser_fns[token::token_type::Function] = parse_fn_expression;
-    prefix_parser_fns[token::token_type::String] = parse_string_literal;
-    prefix_parser_fns[token::token_type::Lbracket] = parse_array_literal;
-    prefix_parser_fns[token::token_type::Lbrace] = parse_hash_literal;
-
-    infix_parser_fns[token::token_type::Eq] = parse_infix_expression;
-    infix_parser_fns[token::token_type::NotEq] = parse_infix_expression;
-    infix_parser_fns[token::token_type::Lt] = parse_infix_expression;
-    infix_parser_fns[token::token_type::Gt] = parse_infix_expression;
-    infix_parser_fns[token::token_type::Plus] = parse_infix_expression;
-    infix_parser_fns[token::token_type::Minus] = parse_infix_expression;
-    infix_parser_fns[token::token_type::Slash] = parse_infix_expression;
-    infix_parser_fns[token::token_type::Asterisk] = parse_infix_expression;
-    infix_parser_fns[token::token_type::Lparen] = parse_call_expression;
-    infix_parser_fns[token::token_type::Lbracket] = parse_index_expression;
-    infix_parser_fns[token::token_type::Assign] = parse_assign_expression;
-
+parser::parser(const lexer::token_buffer& t) : tokens{&t}, input{t.input} {
+    errors = t.errors;
     next_token();
     next_token();
 }
 
 auto parser::parse_program() -> ast::program {
     ast::program program{};
+    program.node_arena = node_arena;
 
     while (curr_token.type != token::token_type::End) {
         auto stmt{parse_stmt()};
@@ -252,9 +235,25 @@ auto parser::parse_program() -> ast::program {
     return program;
 }
 
+auto parser::span_of(const token::token& tok) const -> ast::source_span {
+    auto begin{reinterpret_cast<std::uintptr_t>(input.data())};
+    auto at{reinterpret_cast<std::uintptr_t>(tok.literal.data())};
+
+    // The End token does not point into the input.
+    if (at < begin || at > begin + input.size()) {
+        return ast::source_span{static_cast<u32>(input.size()), 0};
+    }
+
+    return ast::source_span{static_cast<u32>(at - begin), static_cast<u32>(tok.literal.size())};
+}
+
 auto parser::next_token() -> void {
     curr_token = peek_token;
-    peek_token = lexer.next_token();
+    if (tokens != nullptr) {
+        peek_token = tokens->at(token_idx++);
+    } else {
+        peek_token = lexer->next_token();
+    }
 }
 
 auto parser::expect_peek(token::token_type tok) -> bool {
@@ -269,7 +268,7 @@ auto parser::expect_peek(token::token_type tok) -> bool {
     return false;
 }
 
-auto parser::parse_stmt() -> std::unique_ptr<ast::statement> {
+auto parser::parse_stmt() -> ast::node_ptr<ast::statement> {
     switch (curr_token.type) {
     case token::token_type::Let:
         return parse_let_stmt();
@@ -291,14 +290,14 @@ auto parser::parse_stmt() -> std::unique_ptr<ast::statement> {
     }
 }
 
-auto parser::parse_let_stmt() -> std::unique_ptr<ast::let_statement> {
-    auto stmt{std::make_unique<ast::let_statement>(curr_token)};
+auto parser::parse_let_stmt() -> ast::node_ptr<ast::let_statement> {
+    auto stmt{make<ast::let_statement>()};
 
     if (!expect_peek(token::token_type::Ident)) {
         return nullptr;
     }
 
-    stmt->name = ast::identifier{curr_token, curr_token.literal};
+    stmt->name = ast::identifier{span_of(curr_token), curr_token.literal};
 
     if (!expect_peek(token::token_type::Assign)) {
         return nullptr;
@@ -315,8 +314,8 @@ auto parser::parse_let_stmt() -> std::unique_ptr<ast::let_statement> {
     return stmt;
 }
 
-auto parser::parse_return_stmt() -> std::unique_ptr<ast::return_statement> {
-    auto stmt{std::make_unique<ast::return_statement>(curr_token)};
+auto parser::parse_return_stmt() -> ast::node_ptr<ast::return_statement> {
+    auto stmt{make<ast::return_statement>()};
 
     next_token();
 
@@ -329,8 +328,8 @@ auto parser::parse_return_stmt() -> std::unique_ptr<ast::return_statement> {
     return stmt;
 }
 
-auto parser::parse_expr_stmt() -> std::unique_ptr<ast::statement> {
-    auto stmt{std::make_unique<ast::expression_statement>(curr_token)};
+auto parser::parse_expr_stmt() -> ast::node_ptr<ast::statement> {
+    auto stmt{make<ast::expression_statement>()};
 
     stmt->expr = parse_expr(expr_precedence::Lowest);
 
@@ -341,31 +340,172 @@ auto parser::parse_expr_stmt() -> std::unique_ptr<ast::statement> {
     return stmt;
 }
 
-auto parser::parse_expr(expr_precedence precedence) -> std::unique_ptr<ast::expression> {
-    auto prefix{prefix_parser_fns[curr_token.type]};
-    if (!static_cast<bool>(prefix)) {
-        no_prefix_parse_fn(curr_token.type);
+auto parser::parse_expr(expr_precedence precedence) -> ast::node_ptr<ast::expression> {
+    if (nesting >= max_depth) {
+        too_deep();
         return nullptr;
     }
 
-    auto left_expr{prefix(*this)};
-    while (peek_token.type != token::token_type::Semicolon && precedence < peek_precedence()) {
-        auto infix{infix_parser_fns[peek_token.type]};
-        if (!static_cast<bool>(infix)) {
-            return left_expr;
+    nesting++;
+    usize depth{};
+    auto expr{parse_operators(precedence, depth)};
+    nesting--;
+
+    expr_depth = std::max(expr_depth, depth);
+
+    return expr;
+}
+
+// An operator waiting for its right operand, or an open parenthesis waiting for its expression.
+struct pending_operator {
+    enum class kind : u8 {
+        Prefix,
+        Infix,
+        Group,
+        Assign,
+    };
+
+    kind k{};
+    // Operators after the operand only extend it if they bind tighter than this.
+    expr_precedence precedence{};
+    usize left_depth{};
+    ast::node_ptr<ast::expression> node{};
+};
+
+// Operators, prefix operators and parentheses are kept on an explicit stack instead of recursing for every operand,
+// which only happens for the expressions inside calls, indexes, literals and blocks. `depth` is set to the depth of
+// the expression.
+auto parser::parse_operators(expr_precedence precedence, usize& depth) -> ast::node_ptr<ast::expression> {
+    std::vector<pending_operator> ops{};
+
+    while (true) {
+        while (curr_token.type == token::token_type::Bang || curr_token.type == token::token_type::Minus ||
+               curr_token.type == token::token_type::Lparen) {
+            if (curr_token.type == token::token_type::Lparen) {
+                ops.push_back(pending_operator{pending_operator::kind::Group, expr_precedence::Lowest});
+            } else {
+                auto node{make<ast::prefix_expression>(ast::get_operator_type(curr_token.type))};
+                ops.push_back(
+                    pending_operator{pending_operator::kind::Prefix, expr_precedence::Prefix, 0, std::move(node)}
+                );
+            }
+
+            next_token();
         }
 
-        next_token();
+        ast::node_ptr<ast::expression> left{};
+        usize left_depth{};
+
+        // Without a prefix parse function the operand's operator gets nothing, and nothing after it is parsed.
+        auto prefix{prefix_parser_fns[static_cast<usize>(curr_token.type)]};
+        bool failed{prefix == nullptr};
+        if (failed) {
+            no_prefix_parse_fn(curr_token.type);
+        } else {
+            auto outer{std::exchange(expr_depth, 0)};
+            left = prefix(*this);
+            left_depth = expr_depth + 1;
+            expr_depth = outer;
+        }
 
-        left_expr = infix(std::move(left_expr), *this);
+        bool next_operand{};
+        while (!next_operand) {
+            auto level{ops.empty() ? precedence : ops.back().precedence};
+            while (!failed && peek_token.type != token::token_type::Semicolon && level < peek_precedence()) {
+                next_token();
+
+                if (auto infix{infix_parser_fns[static_cast<usize>(curr_token.type)]}) {
+                    auto outer{std::exchange(expr_depth, 0)};
+                    left = infix(std::move(left), *this);
+                    left_depth = std::max(left_depth, expr_depth) + 1;
+                    expr_depth = outer;
+                    continue;
+                }
+
+                if (curr_token.type == token::token_type::Assign) {
+                    if (left == nullptr || left->type() != ast::node_type::Identifier) {
+                        left = nullptr;
+                        continue;
+                    }
+
+                    auto node{make<ast::assign_expression>(std::move(left))};
+                    ops.push_back(pending_operator{
+                        pending_operator::kind::Assign, expr_precedence::Lowest, left_depth, std::move(node)
+                    });
+                } else {
+                    auto node{make<ast::infix_expression>(ast::get_operator_type(curr_token.type), std::move(left))};
+                    ops.push_back(
+                        pending_operator{pending_operator::kind::Infix, curr_precedence(), left_depth, std::move(node)}
+                    );
+                }
+
+                next_token();
+                next_operand = true;
+                break;
+            }
+
+            if (next_operand) {
+                break;
+            }
+            failed = false;
+
+            if (ops.empty()) {
+                depth = left_depth;
+                return left;
+            }
+
+            auto op{std::move(ops.back())};
+            ops.pop_back();
+
+            switch (op.k) {
+            case pending_operator::kind::Prefix: {
+                static_cast<ast::prefix_expression&>(*op.node).right = std::move(left);
+                left = std::move(op.node);
+                left_depth++;
+            } break;
+
+            // Only the right operand is one level deeper, passes walk down the left ones of a chain without recursing.
+            case pending_operator::kind::Infix: {
+                static_cast<ast::infix_expression&>(*op.node).right = std::move(left);
+                left = std::move(op.node);
+                left_depth = std::max(left_depth + 1, op.left_depth);
+            } break;
+
+            case pending_operator::kind::Group: {
+                if (!expect_peek(token::token_type::Rparen)) {
+                    left = nullptr;
+                }
+            } break;
+
+            case pending_operator::kind::Assign: {
+                static_cast<ast::assign_expression&>(*op.node).value = std::move(left);
+                left = std::move(op.node);
+                left_depth = std::max(left_depth + 1, op.left_depth);
+
+                if (peek_token.type == token::token_type::Semicolon) {
+                    next_token();
+                }
+            } break;
+            }
+
+            if (left_depth > max_depth) {
+                too_deep();
+                return nullptr;
+            }
+        }
     }
-
-    return left_expr;
 }
 
-auto parser::parse_block_stmt() -> std::unique_ptr<ast::block_statement> {
-    auto block{std::make_unique<ast::block_statement>(curr_token)};
+// Blocks count towards the nesting like expressions do, a while inside a while never goes through parse_expr.
+auto parser::parse_block_stmt() -> ast::node_ptr<ast::block_statement> {
+    if (nesting >= max_depth) {
+        too_deep();
+        return nullptr;
+    }
+
+    auto block{make<ast::block_statement>()};
 
+    nesting++;
     next_token();
 
     while (curr_token.type != token::token_type::Rbrace && curr_token.type != token::token_type::End) {
@@ -376,12 +516,13 @@ auto parser::parse_block_stmt() -> std::unique_ptr<ast::block_statement> {
 
         next_token();
     }
+    nesting--;
 
     return block;
 }
 
-auto parser::parse_fn_parameters() -> std::vector<std::unique_ptr<ast::expression>> {
-    std::vector<std::unique_ptr<ast::expression>> parameters{};
+auto parser::parse_fn_parameters() -> std::vector<ast::node_ptr<ast::expression>> {
+    std::vector<ast::node_ptr<ast::expression>> parameters{};
 
     next_token();
 
@@ -389,13 +530,13 @@ auto parser::parse_fn_parameters() -> std::vector<std::unique_ptr<ast::expressio
         return parameters;
     }
 
-    parameters.emplace_back(std::make_unique<ast::identifier>(curr_token, curr_token.literal));
+    parameters.emplace_back(make<ast::identifier>(curr_token.literal));
 
     while (peek_token.type == token::token_type::Comma) {
         next_token();
         next_token();
 
-        parameters.emplace_back(std::make_unique<ast::identifier>(curr_token, curr_token.literal));
+        parameters.emplace_back(make<ast::identifier>(curr_token.literal));
     }
 
     if (!expect_peek(token::token_type::Rparen)) {
@@ -405,8 +546,8 @@ auto parser::parse_fn_parameters() -> std::vector<std::unique_ptr<ast::expressio
     return parameters;
 }
 
-auto parser::parse_expression_list(token::token_type tok_type) -> std::vector<std::unique_ptr<ast::expression>> {
-    std::vector<std::unique_ptr<ast::expression>> parameters{};
+auto parser::parse_expression_list(token::token_type tok_type) -> std::vector<ast::node_ptr<ast::expression>> {
+    std::vector<ast::node_ptr<ast::expression>> parameters{};
 
     next_token();
 
@@ -430,8 +571,8 @@ auto parser::parse_expression_list(token::token_type tok_type) -> std::vector<st
     return parameters;
 }
 
-auto parser::parse_while_stmt() -> std::unique_ptr<ast::while_statement> {
-    auto stmt{std::make_unique<ast::while_statement>(curr_token)};
+auto parser::parse_while_stmt() -> ast::node_ptr<ast::while_statement> {
+    auto stmt{make<ast::while_statement>()};
 
     next_token();
     stmt->condition = parse_expr(expr_precedence::Lowest);
@@ -441,12 +582,15 @@ auto parser::parse_while_stmt() -> std::unique_ptr<ast::while_statement> {
     }
 
     stmt->body = parse_block_stmt();
+    if (stmt->body == nullptr) {
+        return nullptr;
+    }
 
     return stmt;
 }
 
-auto parser::parse_break_stmt() -> std::unique_ptr<ast::break_statement> {
-    auto stmt{std::make_unique<ast::break_statement>(curr_token)};
+auto parser::parse_break_stmt() -> ast::node_ptr<ast::break_statement> {
+    auto stmt{make<ast::break_statement>()};
 
     if (peek_token.type == token::token_type::Semicolon) {
         next_token();
@@ -455,8 +599,8 @@ auto parser::parse_break_stmt() -> std::unique_ptr<ast::break_statement> {
     return stmt;
 }
 
-auto parser::parse_continue_stmt() -> std::unique_ptr<ast::continue_statement> {
-    auto stmt{std::make_unique<ast::continue_statement>(curr_token)};
+auto parser::parse_continue_stmt() -> ast::node_ptr<ast::continue_statement> {
+    auto stmt{make<ast::continue_statement>()};
 
     if (peek_token.type == token::token_type::Semicolon) {
         next_token();
@@ -474,19 +618,11 @@ auto parser::peek_error(token::token_type t) -> void {
 }
 
 auto parser::curr_precedence() -> expr_precedence {
-    try {
-        return precedences.at(curr_token.type);
-    } catch (const std::out_of_range&) {
-        return expr_precedence::Lowest;
-    }
+    return precedences[static_cast<usize>(curr_token.type)];
 }
 
 auto parser::peek_precedence() -> expr_precedence {
-    try {
-        return precedences.at(peek_token.type);
-    } catch (const std::out_of_range&) {
-        return expr_precedence::Lowest;
-    }
+    return precedences[static_cast<usize>(peek_token.type)];
 }
 
 }
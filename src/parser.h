@@ -4,9 +4,11 @@
 #include "lexer.h"
 #include "token.h"
 
-#include <functional>
 #include <memory>
-#include <unordered_map>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
 
 namespace interp {
 
@@ -14,8 +16,13 @@ namespace parser {
 
 class parser;
 
-using prefix_parser_fn = std::function<std::unique_ptr<ast::expression>(parser& p)>;
-using infix_parser_fn = std::function<std::unique_ptr<ast::expression>(std::unique_ptr<ast::expression>, parser& p)>;
+using prefix_parser_fn = auto (*)(parser& p) -> ast::node_ptr<ast::expression>;
+using infix_parser_fn = auto (*)(ast::node_ptr<ast::expression> left, parser& p) -> ast::node_ptr<ast::expression>;
+
+// Expressions nested deeper than this are reported as an error, so the passes after the parser, which walk the ast
+// recursively, never run out of stack. The left operands of a chain like `a + b + c` do not count, passes go down
+// those with ast::left_spine.
+static constexpr usize default_max_depth{1000};
 
 enum class expr_precedence {
     Lowest,
@@ -32,59 +39,77 @@ enum class expr_precedence {
 class parser {
 public:
     parser(lexer::lexer& lexer);
+    // Walks a buffer tokenized up front instead of pulling tokens from a lexer one at a time.
+    parser(const lexer::token_buffer& tokens);
 
     auto parse_program() -> ast::program;
 
 private:
+    auto span_of(const token::token& tok) const -> ast::source_span;
     auto next_token() -> void;
     auto expect_peek(token::token_type tok) -> bool;
 
-    auto parse_stmt() -> std::unique_ptr<ast::statement>;
-    auto parse_let_stmt() -> std::unique_ptr<ast::let_statement>;
-    auto parse_return_stmt() -> std::unique_ptr<ast::return_statement>;
-    auto parse_expr_stmt() -> std::unique_ptr<ast::statement>;
-    auto parse_expr(expr_precedence precedence) -> std::unique_ptr<ast::expression>;
-    auto parse_block_stmt() -> std::unique_ptr<ast::block_statement>;
-    auto parse_fn_parameters() -> std::vector<std::unique_ptr<ast::expression>>;
-    auto parse_expression_list(token::token_type tok_type) -> std::vector<std::unique_ptr<ast::expression>>;
-    auto parse_while_stmt() -> std::unique_ptr<ast::while_statement>;
-    auto parse_break_stmt() -> std::unique_ptr<ast::break_statement>;
-    auto parse_continue_stmt() -> std::unique_ptr<ast::continue_statement>;
+    auto parse_stmt() -> ast::node_ptr<ast::statement>;
+    auto parse_let_stmt() -> ast::node_ptr<ast::let_statement>;
+    auto parse_return_stmt() -> ast::node_ptr<ast::return_statement>;
+    auto parse_expr_stmt() -> ast::node_ptr<ast::statement>;
+    auto parse_expr(expr_precedence precedence) -> ast::node_ptr<ast::expression>;
+    auto parse_operators(expr_precedence precedence, usize& depth) -> ast::node_ptr<ast::expression>;
+    auto parse_block_stmt() -> ast::node_ptr<ast::block_statement>;
+    auto parse_fn_parameters() -> std::vector<ast::node_ptr<ast::expression>>;
+    auto parse_expression_list(token::token_type tok_type) -> std::vector<ast::node_ptr<ast::expression>>;
+    auto parse_while_stmt() -> ast::node_ptr<ast::while_statement>;
+    auto parse_break_stmt() -> ast::node_ptr<ast::break_statement>;
+    auto parse_continue_stmt() -> ast::node_ptr<ast::continue_statement>;
 
     auto peek_error(token::token_type t) -> void;
 
     auto no_prefix_parse_fn(token::token_type tt) -> void;
-
-    friend auto parse_prefix_expression(parser& p) -> std::unique_ptr<ast::prefix_expression>;
-    friend auto parse_infix_expression(std::unique_ptr<ast::expression> left, parser& p)
-        -> std::unique_ptr<ast::infix_expression>;
-    friend auto parse_grouped_expression(parser& p) -> std::unique_ptr<ast::expression>;
-    friend auto parse_if_expression(parser& p) -> std::unique_ptr<ast::if_expression>;
-    friend auto parse_fn_expression(parser& p) -> std::unique_ptr<ast::fn_expression>;
-    friend auto parse_call_expression(std::unique_ptr<ast::expression> left, parser& p)
-        -> std::unique_ptr<ast::call_expression>;
-    friend auto parse_array_literal(parser& p) -> std::unique_ptr<ast::expression>;
-    friend auto parse_index_expression(std::unique_ptr<ast::expression> left, parser& p)
-        -> std::unique_ptr<ast::expression>;
-    friend auto parse_hash_literal(parser& p) -> std::unique_ptr<ast::expression>;
-    friend auto parse_assign_expression(std::unique_ptr<ast::expression> left, parser& p)
-        -> std::unique_ptr<ast::expression>;
+    auto too_deep() -> void;
+
+    friend auto parse_identifier(parser& p) -> ast::node_ptr<ast::expression>;
+    friend auto parse_integer_literal(parser& p) -> ast::node_ptr<ast::expression>;
+    friend auto parse_boolean_expression(parser& p) -> ast::node_ptr<ast::expression>;
+    friend auto parse_string_literal(parser& p) -> ast::node_ptr<ast::expression>;
+    friend auto parse_if_expression(parser& p) -> ast::node_ptr<ast::expression>;
+    friend auto parse_fn_expression(parser& p) -> ast::node_ptr<ast::expression>;
+    friend auto parse_call_expression(ast::node_ptr<ast::expression> left, parser& p)
+        -> ast::node_ptr<ast::expression>;
+    friend auto parse_array_literal(parser& p) -> ast::node_ptr<ast::expression>;
+    friend auto parse_index_expression(ast::node_ptr<ast::expression> left, parser& p)
+        -> ast::node_ptr<ast::expression>;
+    friend auto parse_hash_literal(parser& p) -> ast::node_ptr<ast::expression>;
+
+    // Allocates a node in the program's arena, spanning the current token.
+    template <typename T, typename... Args>
+    auto make(Args&&... args) -> ast::node_ptr<T> {
+        return node_arena->make<T>(span_of(curr_token), std::forward<Args>(args)...);
+    }
 
     auto curr_precedence() -> expr_precedence;
     auto peek_precedence() -> expr_precedence;
 
 public:
-    lexer::lexer& lexer;
+    // Exactly one of `lexer` and `tokens` is set.
+    lexer::lexer* lexer{};
+    const lexer::token_buffer* tokens{};
+    usize token_idx{};
+    std::string_view input{};
+
+    std::shared_ptr<ast::arena> node_arena{std::make_shared<ast::arena>()};
 
     token::token curr_token{};
     token::token peek_token{};
 
     std::vector<std::string> errors{};
 
-    std::unordered_map<token::token_type, prefix_parser_fn> prefix_parser_fns{};
-    std::unordered_map<token::token_type, infix_parser_fn> infix_parser_fns{};
+    usize max_depth{default_max_depth};
 
-    static std::unordered_map<token::token_type, expr_precedence> precedences;
+private:
+    // parse_expr and parse_block_stmt calls in progress, and the depth of the deepest expression returned by
+    // parse_expr since it was last reset.
+    usize nesting{};
+    usize expr_depth{};
 };
 }
 
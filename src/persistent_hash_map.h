@@ -0,0 +1,283 @@
+#pragma once
+
+#include "types.h"
+
+#include <bit>
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace interp {
+
+namespace persistent {
+
+// Immutable hash array mapped trie. Every level consumes 5 bits of the hash and only stores the occupied slots,
+// keys whose whole hash collides end up together in a node past the last level.
+// insert and erase copy a single path from the root, everything else is shared with the original map.
+template <typename K, typename V, typename Hash = std::hash<K>>
+class hash_map {
+public:
+    hash_map() {}
+
+    inline auto size() const -> usize {
+        return count;
+    }
+
+    inline auto empty() const -> bool {
+        return count == 0;
+    }
+
+    auto find(const K& key) const -> const V* {
+        auto h{static_cast<u64>(Hash{}(key))};
+        auto n{root.get()};
+
+        for (usize shift{0}; n; shift += bits) {
+            if (shift >= hash_bits) {
+                for (const auto& e : n->entries) {
+                    if (e.key == key) {
+                        return &e.value;
+                    }
+                }
+                return nullptr;
+            }
+
+            auto bit{slot_bit(h, shift)};
+            if (!(n->bitmap & bit)) {
+                return nullptr;
+            }
+
+            auto& e{n->entries[slot_index(n->bitmap, bit)]};
+            if (!e.child) {
+                return e.key == key ? &e.value : nullptr;
+            }
+
+            n = e.child.get();
+        }
+
+        return nullptr;
+    }
+
+    inline auto contains(const K& key) const -> bool {
+        return find(key) != nullptr;
+    }
+
+    auto insert(const K& key, const V& value) const -> hash_map {
+        entry e{static_cast<u64>(Hash{}(key)), key, value};
+        bool added{!root};
+
+        hash_map ret{};
+        ret.root = root ? insert(*root, 0, std::move(e), added) : single(0, std::move(e));
+        ret.count = added ? count + 1 : count;
+
+        return ret;
+    }
+
+    auto erase(const K& key) const -> hash_map {
+        if (!root) {
+            return *this;
+        }
+
+        bool removed{};
+        auto new_root{erase(root, 0, static_cast<u64>(Hash{}(key)), key, removed)};
+        if (!removed) {
+            return *this;
+        }
+
+        hash_map ret{};
+        ret.root = std::move(new_root);
+        ret.count = count - 1;
+
+        return ret;
+    }
+
+    template <typename F>
+    auto for_each(const F& f) const -> void {
+        if (root) {
+            for_each(*root, f);
+        }
+    }
+
+private:
+    static constexpr usize bits{5};
+    static constexpr usize hash_bits{64};
+
+    class node;
+
+    class entry {
+    public:
+        u64 hash{};
+        K key{};
+        V value{};
+        std::shared_ptr<const node> child{};
+    };
+
+    class node {
+    public:
+        u32 bitmap{};
+        std::vector<entry> entries{};
+    };
+
+    static inline auto slot_bit(u64 hash, usize shift) -> u32 {
+        return u32{1} << ((hash >> shift) & 0x1f);
+    }
+
+    static inline auto slot_index(u32 bitmap, u32 bit) -> usize {
+        return static_cast<usize>(std::popcount(bitmap & (bit - 1)));
+    }
+
+    static auto single(usize shift, entry e) -> std::shared_ptr<const node> {
+        auto ret{std::make_shared<node>()};
+        if (shift < hash_bits) {
+            ret->bitmap = slot_bit(e.hash, shift);
+        }
+        ret->entries.push_back(std::move(e));
+
+        return ret;
+    }
+
+    static auto merge(usize shift, entry e1, entry e2) -> std::shared_ptr<const node> {
+        auto ret{std::make_shared<node>()};
+        if (shift >= hash_bits) {
+            ret->entries.push_back(std::move(e1));
+            ret->entries.push_back(std::move(e2));
+            return ret;
+        }
+
+        auto bit1{slot_bit(e1.hash, shift)};
+        auto bit2{slot_bit(e2.hash, shift)};
+        if (bit1 == bit2) {
+            ret->bitmap = bit1;
+            ret->entries.push_back(entry{.child = merge(shift + bits, std::move(e1), std::move(e2))});
+            return ret;
+        }
+
+        ret->bitmap = bit1 | bit2;
+        if (bit1 < bit2) {
+            ret->entries.push_back(std::move(e1));
+            ret->entries.push_back(std::move(e2));
+        } else {
+            ret->entries.push_back(std::move(e2));
+            ret->entries.push_back(std::move(e1));
+        }
+
+        return ret;
+    }
+
+    static auto insert(const node& n, usize shift, entry e, bool& added) -> std::shared_ptr<const node> {
+        auto ret{std::make_shared<node>(n)};
+
+        if (shift >= hash_bits) {
+            for (auto& existing : ret->entries) {
+                if (existing.key == e.key) {
+                    existing.value = std::move(e.value);
+                    return ret;
+                }
+            }
+
+            ret->entries.push_back(std::move(e));
+            added = true;
+            return ret;
+        }
+
+        auto bit{slot_bit(e.hash, shift)};
+        auto idx{slot_index(n.bitmap, bit)};
+
+        if (!(n.bitmap & bit)) {
+            ret->bitmap |= bit;
+            ret->entries.insert(ret->entries.begin() + static_cast<std::ptrdiff_t>(idx), std::move(e));
+            added = true;
+            return ret;
+        }
+
+        auto& existing{ret->entries[idx]};
+        if (existing.child) {
+            existing.child = insert(*existing.child, shift + bits, std::move(e), added);
+        } else if (existing.key == e.key) {
+            existing.value = std::move(e.value);
+        } else {
+            existing = entry{.child = merge(shift + bits, std::move(existing), std::move(e))};
+            added = true;
+        }
+
+        return ret;
+    }
+
+    static auto erase(const std::shared_ptr<const node>& n, usize shift, u64 hash, const K& key, bool& removed)
+        -> std::shared_ptr<const node> {
+        if (shift >= hash_bits) {
+            for (usize i{0}; i < n->entries.size(); i++) {
+                if (n->entries[i].key == key) {
+                    removed = true;
+                    return remove_entry(*n, i, 0);
+                }
+            }
+            return n;
+        }
+
+        auto bit{slot_bit(hash, shift)};
+        if (!(n->bitmap & bit)) {
+            return n;
+        }
+
+        auto idx{slot_index(n->bitmap, bit)};
+        auto& existing{n->entries[idx]};
+
+        if (!existing.child) {
+            if (!(existing.key == key)) {
+                return n;
+            }
+
+            removed = true;
+            return remove_entry(*n, idx, bit);
+        }
+
+        auto child{erase(existing.child, shift + bits, hash, key, removed)};
+        if (!removed) {
+            return n;
+        }
+
+        if (!child) {
+            return remove_entry(*n, idx, bit);
+        }
+
+        auto ret{std::make_shared<node>(*n)};
+        if (child->entries.size() == 1 && !child->entries[0].child) {
+            ret->entries[idx] = child->entries[0];
+        } else {
+            ret->entries[idx].child = std::move(child);
+        }
+
+        return ret;
+    }
+
+    static auto remove_entry(const node& n, usize idx, u32 bit) -> std::shared_ptr<const node> {
+        if (n.entries.size() == 1) {
+            return nullptr;
+        }
+
+        auto ret{std::make_shared<node>(n)};
+        ret->bitmap &= ~bit;
+        ret->entries.erase(ret->entries.begin() + static_cast<std::ptrdiff_t>(idx));
+
+        return ret;
+    }
+
+    template <typename F>
+    static auto for_each(const node& n, const F& f) -> void {
+        for (const auto& e : n.entries) {
+            if (e.child) {
+                for_each(*e.child, f);
+            } else {
+                f(e.key, e.value);
+            }
+        }
+    }
+
+private:
+    std::shared_ptr<const node> root{};
+    usize count{};
+};
+
+}
+
+}
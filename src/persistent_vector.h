@@ -0,0 +1,195 @@
+#pragma once
+
+#include "types.h"
+
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <vector>
+
+namespace interp {
+
+namespace persistent {
+
+// Immutable vector with structural sharing, a 32-way trie with the last leaf kept separately as the tail.
+// push_back copies at most one path from the root plus the tail, pop_front only moves the start offset.
+template <typename T>
+class vector {
+public:
+    class iterator {
+    public:
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+
+        iterator() {}
+        iterator(const vector* vec, usize idx) : vec{vec}, idx{idx} {}
+
+        inline auto operator*() const -> const T& {
+            return (*vec)[idx];
+        }
+
+        inline auto operator++() -> iterator& {
+            idx++;
+            return *this;
+        }
+
+        inline auto operator++(int) -> iterator {
+            auto tmp{*this};
+            idx++;
+            return tmp;
+        }
+
+        inline auto operator==(const iterator& other) const -> bool {
+            return idx == other.idx;
+        }
+
+    private:
+        const vector* vec{};
+        usize idx{};
+    };
+
+    vector() : root{std::make_shared<node>()}, tail{std::make_shared<node>()} {}
+    vector(const std::vector<T>& elems) : vector{} {
+        for (const auto& elem : elems) {
+            *this = push_back(elem);
+        }
+    }
+
+    inline auto size() const -> usize {
+        return count - offset;
+    }
+
+    inline auto empty() const -> bool {
+        return size() == 0;
+    }
+
+    auto operator[](usize idx) const -> const T& {
+        idx += offset;
+        if (idx >= tail_offset()) {
+            return tail->values[idx - tail_offset()];
+        }
+
+        auto n{root.get()};
+        for (usize level{shift}; level > 0; level -= bits) {
+            n = n->children[(idx >> level) & mask].get();
+        }
+
+        return n->values[idx & mask];
+    }
+
+    inline auto front() const -> const T& {
+        return (*this)[0];
+    }
+
+    inline auto back() const -> const T& {
+        return (*this)[size() - 1];
+    }
+
+    inline auto begin() const -> iterator {
+        return iterator{this, 0};
+    }
+
+    inline auto end() const -> iterator {
+        return iterator{this, size()};
+    }
+
+    auto push_back(const T& val) const -> vector {
+        auto ret{*this};
+        ret.count++;
+
+        if (count - tail_offset() < width) {
+            auto new_tail{std::make_shared<node>(*tail)};
+            new_tail->values.push_back(val);
+            ret.tail = std::move(new_tail);
+
+            return ret;
+        }
+
+        if ((count >> bits) > (usize{1} << shift)) {
+            auto new_root{std::make_shared<node>()};
+            new_root->children.push_back(root);
+            new_root->children.push_back(new_path(shift, tail));
+            ret.root = std::move(new_root);
+            ret.shift += bits;
+        } else {
+            ret.root = push_tail(shift, *root, tail);
+        }
+
+        auto new_tail{std::make_shared<node>()};
+        new_tail->values.push_back(val);
+        ret.tail = std::move(new_tail);
+
+        return ret;
+    }
+
+    auto pop_front() const -> vector {
+        if (size() <= 1) {
+            return vector{};
+        }
+
+        auto ret{*this};
+        ret.offset++;
+
+        return ret;
+    }
+
+private:
+    static constexpr usize bits{5};
+    static constexpr usize width{usize{1} << bits};
+    static constexpr usize mask{width - 1};
+
+    class node {
+    public:
+        std::vector<std::shared_ptr<const node>> children{};
+        std::vector<T> values{};
+    };
+
+    inline auto tail_offset() const -> usize {
+        return count < width ? 0 : ((count - 1) >> bits) << bits;
+    }
+
+    static auto new_path(usize level, std::shared_ptr<const node> n) -> std::shared_ptr<const node> {
+        if (level == 0) {
+            return n;
+        }
+
+        auto ret{std::make_shared<node>()};
+        ret->children.push_back(new_path(level - bits, std::move(n)));
+
+        return ret;
+    }
+
+    auto push_tail(usize level, const node& parent, std::shared_ptr<const node> leaf) const
+        -> std::shared_ptr<const node> {
+        auto ret{std::make_shared<node>(parent)};
+        auto idx{((count - 1) >> level) & mask};
+
+        std::shared_ptr<const node> child{};
+        if (level == bits) {
+            child = std::move(leaf);
+        } else if (idx < parent.children.size()) {
+            child = push_tail(level - bits, *parent.children[idx], std::move(leaf));
+        } else {
+            child = new_path(level - bits, std::move(leaf));
+        }
+
+        if (idx < ret->children.size()) {
+            ret->children[idx] = std::move(child);
+        } else {
+            ret->children.push_back(std::move(child));
+        }
+
+        return ret;
+    }
+
+private:
+    std::shared_ptr<const node> root{};
+    std::shared_ptr<const node> tail{};
+    usize count{};
+    usize shift{bits};
+    usize offset{};
+};
+
+}
+
+}
@@ -1,28 +1,41 @@
 #include "repl.h"
+#include "compiler.h"
 #include "eval.h"
 #include "lexer.h"
 #include "object.h"
 #include "parser.h"
+#include "resolver.h"
+#include "vm.h"
 
+#include <deque>
 #include <iostream>
 #include <print>
+#include <string>
 #include <string_view>
 
 namespace interp {
 
 namespace repl {
 
-void start(std::istream& is, std::ostream& os) {
+void start(std::istream& is, std::ostream& os, backend b) {
     std::println("Hello user! This is the {{name}} programming language!");
     std::println("Feel free to type in commands");
 
     static constexpr std::string_view prompt{">> "};
     auto env{object::environment{}};
+    resolver::resolver r{};
+
+    compiler::state state{};
+    std::vector<object::value> globals{};
+    object::get_heap().add_roots(globals);
+
+    // Functions and resolved names outlive the line they were defined on and still point into its text.
+    std::deque<std::string> lines{};
 
     while (true) {
         std::print(os, prompt);
 
-        std::string line;
+        auto& line{lines.emplace_back()};
         std::getline(is, line);
 
         lexer::lexer lex{line};
@@ -36,12 +49,29 @@ void start(std::istream& is, std::ostream& os) {
             continue;
         }
 
-        auto evaluated{eval::eval(program, env)};
-        if (evaluated == nullptr) {
+        object::value evaluated{};
+        if (b == backend::Vm) {
+            compiler::compiler c{state};
+            c.compile(program);
+            if (!c.errors.empty()) {
+                for (const auto& err : c.errors) {
+                    std::println(os, "\t{}", err);
+                }
+                continue;
+            }
+
+            vm::vm machine{c.get_bytecode(), globals};
+            evaluated = machine.run();
+        } else {
+            r.resolve(program);
+            evaluated = eval::eval(program, env);
+        }
+
+        if (!evaluated.has_value()) {
             continue;
         }
 
-        std::println(os, "{}", evaluated->to_string());
+        std::println(os, "{}", evaluated.to_string());
         std::println(os);
     }
 }
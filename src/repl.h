@@ -6,7 +6,12 @@ namespace interp {
 
 namespace repl {
 
-void start(std::istream& is, std::ostream& os);
+enum class backend {
+    Eval,
+    Vm,
+};
+
+void start(std::istream& is, std::ostream& os, backend b = backend::Eval);
 
 }
 
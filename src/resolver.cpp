@@ -0,0 +1,116 @@
+#include "resolver.h"
+#include "ast.h"
+#include "builtins.h"
+
+namespace interp {
+
+namespace resolver {
+
+auto scope::declare(std::string_view name) -> usize {
+    if (auto it{slots.find(name)}; it != slots.end()) {
+        return it->second;
+    }
+
+    slots[name] = num_slots;
+
+    return num_slots++;
+}
+
+auto resolver::resolve(ast::program& program) -> void {
+    scopes = {&globals};
+
+    for (auto& stmt : program.statements) {
+        resolve_node(*stmt);
+    }
+
+    program.num_slots = globals.num_slots;
+}
+
+auto resolver::resolve_node(ast::node& node) -> void {
+    switch (node.type()) {
+    case ast::node_type::Identifier: {
+        resolve_identifier(static_cast<ast::identifier&>(node));
+    } break;
+
+    case ast::node_type::LetStatement: {
+        auto& let{static_cast<ast::let_statement&>(node)};
+
+        // A function is declared before its value is resolved so it can call itself, anything else only after.
+        if (let.value->type() == ast::node_type::FnExpression) {
+            scopes.back()->declare(let.name.value);
+        }
+        resolve_node(*let.value);
+        scopes.back()->declare(let.name.value);
+        resolve_identifier(let.name);
+    } break;
+
+    case ast::node_type::FnExpression: {
+        auto& proto{*static_cast<ast::fn_expression&>(node).prototype};
+
+        scope s{};
+        for (auto& param : proto.parameters) {
+            auto& ident{static_cast<ast::identifier&>(*param)};
+            ident.slot = static_cast<u32>(s.declare(ident.value));
+        }
+
+        proto.num_slots = resolve_scope(*proto.body, std::move(s));
+    } break;
+
+    case ast::node_type::WhileStatement: {
+        auto& stmt{static_cast<ast::while_statement&>(node)};
+        resolve_node(*stmt.condition);
+        stmt.num_slots = resolve_scope(*stmt.body, scope{});
+    } break;
+
+    case ast::node_type::InfixExpression: {
+        auto spine{ast::left_spine(static_cast<ast::infix_expression&>(node))};
+        resolve_node(*spine.back()->left);
+        for (auto it{spine.rbegin()}; it != spine.rend(); it++) {
+            resolve_node(*(*it)->right);
+        }
+    } break;
+
+    default: {
+        ast::for_each_child(node, [&](ast::node& child) { resolve_node(child); });
+    } break;
+    }
+}
+
+auto resolver::resolve_scope(ast::node& body, scope s) -> usize {
+    scopes.push_back(&s);
+
+    resolve_node(body);
+
+    scopes.pop_back();
+
+    return s.num_slots;
+}
+
+auto resolver::resolve_identifier(ast::identifier& ident) -> void {
+    for (usize depth{0}; depth < scopes.size(); depth++) {
+        auto& s{*scopes[scopes.size() - 1 - depth]};
+        if (auto it{s.slots.find(ident.value)}; it != s.slots.end()) {
+            ident.depth = static_cast<u32>(depth);
+            ident.slot = static_cast<u32>(it->second);
+            ident.builtin = false;
+            return;
+        }
+    }
+
+    for (usize i{0}; i < builtins::definitions.size(); i++) {
+        if (builtins::definitions[i].name == ident.value) {
+            ident.slot = static_cast<u32>(i);
+            ident.builtin = true;
+            return;
+        }
+    }
+
+    // Unknown names become globals, they stay empty (and report "identifier not found") until something defines them.
+    ident.depth = static_cast<u32>(scopes.size() - 1);
+    ident.slot = static_cast<u32>(globals.declare(ident.value));
+    ident.builtin = false;
+}
+
+}
+
+}
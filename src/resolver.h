@@ -0,0 +1,43 @@
+#pragma once
+
+#include "ast.h"
+#include "types.h"
+
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace interp {
+
+namespace resolver {
+
+// Every scope is backed by one environment at runtime: the global one, one per function call and one per
+// iteration of a while loop. `let` names are declared in order, so reads before a let resolve to the outer scopes.
+class scope {
+public:
+    auto declare(std::string_view name) -> usize;
+
+public:
+    std::unordered_map<std::string_view, usize> slots{};
+    usize num_slots{};
+};
+
+// Annotates every identifier with the (depth, slot) of the variable it refers to, so the evaluator never has
+// to look variables up by name. Keeps the global scope between calls, for the repl.
+class resolver {
+public:
+    auto resolve(ast::program& program) -> void;
+
+private:
+    auto resolve_node(ast::node& node) -> void;
+    auto resolve_identifier(ast::identifier& ident) -> void;
+    auto resolve_scope(ast::node& body, scope s) -> usize;
+
+private:
+    scope globals{};
+    std::vector<scope*> scopes{};
+};
+
+}
+
+}
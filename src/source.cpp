@@ -0,0 +1,61 @@
+#include "source.h"
+
+#include <filesystem>
+#include <fstream>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#define INTERP_HAS_MMAP
+#endif
+
+namespace interp {
+
+namespace source {
+
+file::file(const char* path) {
+    auto size{std::filesystem::file_size(path)};
+    if (size == 0) {
+        return;
+    }
+
+#ifdef INTERP_HAS_MMAP
+    if (auto fd{::open(path, O_RDONLY)}; fd != -1) {
+        auto addr{::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0)};
+        ::close(fd);
+
+        if (addr != MAP_FAILED) {
+            ::madvise(addr, size, MADV_SEQUENTIAL);
+            mapped = static_cast<const char*>(addr);
+            mapped_size = size;
+            return;
+        }
+    }
+#endif
+
+    buffer.resize(size);
+    std::ifstream ifs{path, std::ios::binary};
+    ifs.read(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+    buffer.resize(static_cast<usize>(ifs.gcount()));
+}
+
+file::~file() {
+#ifdef INTERP_HAS_MMAP
+    if (mapped != nullptr) {
+        ::munmap(const_cast<char*>(mapped), mapped_size);
+    }
+#endif
+}
+
+auto file::text() const -> std::string_view {
+    if (mapped != nullptr) {
+        return std::string_view{mapped, mapped_size};
+    }
+
+    return buffer;
+}
+
+}
+
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include "types.h"
+
+#include <string>
+#include <string_view>
+
+namespace interp {
+
+namespace source {
+
+// Contents of a script file. On posix systems the file is mapped read only and the lexer reads the pages directly,
+// elsewhere (or when mapping fails) it is read once into a buffer.
+class file {
+public:
+    explicit file(const char* path);
+    file(const file&) = delete;
+    auto operator=(const file&) -> file& = delete;
+    ~file();
+
+    auto text() const -> std::string_view;
+
+private:
+    const char* mapped{};
+    usize mapped_size{};
+    std::string buffer{};
+};
+
+}
+
+}
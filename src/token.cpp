@@ -1,26 +1,66 @@
 #include "token.h"
+
+#include <array>
 #include <utility>
 
 namespace interp {
 
 namespace token {
 
-std::unordered_map<std::string_view, token_type> keywords{
-    {"fn",       token_type::Function},
-    {"let",      token_type::Let     },
-    {"true",     token_type::True    },
-    {"false",    token_type::False   },
-    {"if",       token_type::If      },
-    {"else",     token_type::Else    },
-    {"return",   token_type::Return  },
-    {"while",    token_type::While   },
-    {"break",    token_type::Break   },
-    {"continue", token_type::Continue},
+struct keyword {
+    std::string_view name{};
+    token_type type{};
+};
+
+static constexpr std::array<keyword, 10> keywords{
+    keyword{"fn",       token_type::Function},
+    keyword{"let",      token_type::Let     },
+    keyword{"true",     token_type::True    },
+    keyword{"false",    token_type::False   },
+    keyword{"if",       token_type::If      },
+    keyword{"else",     token_type::Else    },
+    keyword{"return",   token_type::Return  },
+    keyword{"while",    token_type::While   },
+    keyword{"break",    token_type::Break   },
+    keyword{"continue", token_type::Continue},
 };
 
+static constexpr usize keyword_min_len{2};
+static constexpr usize keyword_max_len{8};
+
+// Perfect hash over the keywords above, every one of them lands in its own slot of `keyword_table`.
+static constexpr auto keyword_hash(std::string_view ident) -> usize {
+    return (ident.size() * 4 + static_cast<u8>(ident[0]) + static_cast<u8>(ident[1])) & 15;
+}
+
+static constexpr auto keyword_table{[] {
+    std::array<keyword, 16> table{};
+    for (const auto& kw : keywords) {
+        table[keyword_hash(kw.name)] = kw;
+    }
+    return table;
+}()};
+
+static_assert(
+    [] {
+        for (const auto& kw : keywords) {
+            if (keyword_table[keyword_hash(kw.name)].name != kw.name) {
+                return false;
+            }
+        }
+        return true;
+    }(),
+    "keyword_hash has collisions"
+);
+
 auto lookup_ident(std::string_view ident) -> token_type {
-    if (keywords.contains(ident)) {
-        return keywords[ident];
+    if (ident.size() < keyword_min_len || ident.size() > keyword_max_len) {
+        return token_type::Ident;
+    }
+
+    const auto& kw{keyword_table[keyword_hash(ident)]};
+    if (kw.name == ident) {
+        return kw.type;
     }
 
     return token_type::Ident;
@@ -2,8 +2,7 @@
 
 #include "types.h"
 
-#include <string>
-#include <unordered_map>
+#include <string_view>
 
 namespace interp {
 
@@ -53,19 +52,18 @@ enum class token_type : u8 {
     Continue,
 };
 
-extern std::unordered_map<std::string_view, token_type> keywords;
 auto lookup_ident(std::string_view ident) -> token_type;
 auto get_token_type_string(token_type t) -> std::string_view;
 
+// `literal` borrows from the source the lexer was given.
 class token {
 public:
     token() {}
-    token(token_type type, i8 literal) : type{type}, literal{literal} {}
     token(token_type type, std::string_view literal) : type{type}, literal{literal} {}
 
 public:
     token_type type{};
-    std::string literal{};
+    std::string_view literal{};
 };
 
 }
@@ -0,0 +1,468 @@
+#include "vm.h"
+#include "builtins.h"
+#include "code.h"
+#include "eval.h"
+#include "helpers.h"
+#include "object.h"
+
+#include <algorithm>
+#include <format>
+#include <span>
+
+namespace interp {
+
+namespace vm {
+
+static auto error(std::string_view msg) -> object::value {
+    return object::make<object::error>(msg);
+}
+
+static auto is_truthy(object::value val) -> bool {
+    if (val.is_boolean()) {
+        return val.as_boolean();
+    }
+
+    return !val.is_null();
+}
+
+static auto operator_string(code::opcode op) -> std::string_view {
+    switch (op) {
+    case code::opcode::Add:
+        return "+";
+    case code::opcode::Sub:
+        return "-";
+    case code::opcode::Mul:
+        return "*";
+    case code::opcode::Div:
+        return "/";
+    case code::opcode::Equal:
+        return "==";
+    case code::opcode::NotEqual:
+        return "!=";
+    case code::opcode::GreaterThan:
+        return ">";
+    case code::opcode::LessThan:
+        return "<";
+    default:
+        return "?";
+    }
+}
+
+static auto unknown_operator(code::opcode op, object::value left, object::value right) -> object::value {
+    return error(std::format(
+        "unknown operator: {} {} {}",
+        object::get_object_type_string(left.type()),
+        operator_string(op),
+        object::get_object_type_string(right.type())
+    ));
+}
+
+vm::vm(const compiler::bytecode& bytecode, std::vector<object::value>& globals)
+    : constants{bytecode.constants},
+      global_names{bytecode.global_names},
+      globals{globals},
+      main_fn{bytecode.main},
+      main{&main_fn},
+      stack(stack_size) {
+    if (globals.size() < global_names.size()) {
+        globals.resize(global_names.size());
+    }
+
+    frames.push_back(frame{&main, 0, 0});
+    sp = main_fn.num_locals;
+
+    // The whole stack is scanned, values above sp only stay alive until they get overwritten.
+    object::get_heap().add_roots(constants);
+    object::get_heap().add_roots(globals);
+    object::get_heap().add_roots(stack);
+}
+
+vm::~vm() {
+    object::get_heap().remove_roots(stack);
+    object::get_heap().remove_roots(globals);
+    object::get_heap().remove_roots(constants);
+}
+
+auto vm::push(object::value val) -> void {
+    if (sp >= stack.size()) {
+        stack.resize(stack.size() * 2);
+    }
+
+    stack[sp++] = val;
+}
+
+auto vm::pop() -> object::value {
+    return stack[--sp];
+}
+
+auto vm::run() -> object::value {
+    while (true) {
+        auto& fr{frames.back()};
+        const auto& ins{fr.cl->fn->instructions};
+
+        auto read_u8{[&] {
+            auto val{code::read_u8(std::span{ins}.subspan(fr.ip))};
+            fr.ip += 1;
+            return static_cast<usize>(val);
+        }};
+        auto read_u16{[&] {
+            auto val{code::read_u16(std::span{ins}.subspan(fr.ip))};
+            fr.ip += 2;
+            return static_cast<usize>(val);
+        }};
+        auto read_u32{[&] {
+            auto val{code::read_u32(std::span{ins}.subspan(fr.ip))};
+            fr.ip += 4;
+            return static_cast<usize>(val);
+        }};
+
+        auto op{static_cast<code::opcode>(ins[fr.ip++])};
+        object::value result{};
+
+        switch (op) {
+        case code::opcode::Constant: {
+            result = constants[read_u32()];
+        } break;
+
+        case code::opcode::Pop: {
+            sp--;
+            continue;
+        } break;
+
+        case code::opcode::Add:
+        case code::opcode::Sub:
+        case code::opcode::Mul:
+        case code::opcode::Div:
+        case code::opcode::Equal:
+        case code::opcode::NotEqual:
+        case code::opcode::GreaterThan:
+        case code::opcode::LessThan: {
+            result = execute_binary(op);
+            if (result.is_error()) {
+                return result;
+            }
+        } break;
+
+        case code::opcode::True: {
+            result = object::value::boolean(true);
+        } break;
+
+        case code::opcode::False: {
+            result = object::value::boolean(false);
+        } break;
+
+        case code::opcode::Null: {
+            result = object::value::null();
+        } break;
+
+        case code::opcode::Minus: {
+            auto operand{pop()};
+            if (!operand.is_integer()) {
+                return error(std::format("unknown operator: -{}", object::get_object_type_string(operand.type())));
+            }
+
+            result = object::value::integer(helpers::wrapping_neg(operand.as_integer()));
+        } break;
+
+        case code::opcode::Bang: {
+            auto operand{pop()};
+            result = object::value::boolean(!is_truthy(operand));
+        } break;
+
+        case code::opcode::JumpNotTruthy: {
+            auto target{read_u32()};
+            if (!is_truthy(pop())) {
+                fr.ip = target;
+            }
+            continue;
+        } break;
+
+        case code::opcode::Jump: {
+            fr.ip = read_u32();
+            continue;
+        } break;
+
+        case code::opcode::GetGlobal: {
+            auto idx{read_u16()};
+            if (!globals[idx].has_value()) {
+                return error(std::format("identifier not found: {}", global_names[idx]));
+            }
+
+            result = globals[idx];
+        } break;
+
+        case code::opcode::SetGlobal: {
+            globals[read_u16()] = pop();
+            continue;
+        } break;
+
+        case code::opcode::AssignGlobal: {
+            auto idx{read_u16()};
+            if (!globals[idx].has_value()) {
+                return error(std::format("variable {} does not exist yet", global_names[idx]));
+            }
+
+            globals[idx] = pop();
+            continue;
+        } break;
+
+        case code::opcode::GetLocal: {
+            auto local{stack[fr.bp + read_u8()]};
+            result = local.has_value() ? local : object::value::null();
+        } break;
+
+        case code::opcode::SetLocal: {
+            auto idx{read_u8()};
+            stack[fr.bp + idx] = pop();
+            continue;
+        } break;
+
+        case code::opcode::NewCell: {
+            stack[fr.bp + read_u8()] = object::make<object::cell>();
+            continue;
+        } break;
+
+        case code::opcode::GetDeref: {
+            auto& c{stack[fr.bp + read_u8()].as<object::cell>()};
+            result = c.val.has_value() ? c.val : object::value::null();
+        } break;
+
+        case code::opcode::SetDeref: {
+            auto& c{stack[fr.bp + read_u8()].as<object::cell>()};
+            c.val = pop();
+            continue;
+        } break;
+
+        case code::opcode::GetFree: {
+            auto& c{fr.cl->free[read_u8()].as<object::cell>()};
+            result = c.val.has_value() ? c.val : object::value::null();
+        } break;
+
+        case code::opcode::SetFree: {
+            auto& c{fr.cl->free[read_u8()].as<object::cell>()};
+            c.val = pop();
+            continue;
+        } break;
+
+        case code::opcode::LoadFree: {
+            result = fr.cl->free[read_u8()];
+        } break;
+
+        case code::opcode::GetBuiltin: {
+            result = builtins::get(read_u8());
+        } break;
+
+        case code::opcode::Array: {
+            auto n{read_u32()};
+            result = object::make<object::array>(
+                std::vector<object::value>{stack.begin() + sp - n, stack.begin() + sp}
+            );
+            sp -= n;
+        } break;
+
+        case code::opcode::Hash: {
+            auto n{read_u32()};
+            result = build_hash(sp - n, sp);
+            if (result.is_error()) {
+                return result;
+            }
+            sp -= n;
+        } break;
+
+        case code::opcode::Index: {
+            auto index{pop()};
+            auto left{pop()};
+            result = execute_index(left, index);
+            if (result.is_error()) {
+                return result;
+            }
+        } break;
+
+        case code::opcode::Call: {
+            auto num_args{read_u8()};
+            if (auto err{execute_call(num_args)}; err.has_value()) {
+                return err;
+            }
+            continue;
+        } break;
+
+        case code::opcode::ReturnValue:
+        case code::opcode::Return: {
+            auto ret{op == code::opcode::ReturnValue ? pop() : object::value{}};
+            auto bp{fr.bp};
+
+            frames.pop_back();
+            if (frames.empty()) {
+                return ret;
+            }
+
+            sp = bp - 1;
+            result = ret.has_value() ? ret : object::value::null();
+        } break;
+
+        case code::opcode::Closure: {
+            auto idx{read_u32()};
+            auto num_free{read_u8()};
+
+            result = object::make<object::closure>(&constants[idx].as<object::compiled_function>());
+            auto& cl{result.as<object::closure>()};
+            cl.free.assign(stack.begin() + sp - num_free, stack.begin() + sp);
+            sp -= num_free;
+        } break;
+        }
+
+        push(result);
+    }
+}
+
+auto vm::execute_binary(code::opcode op) -> object::value {
+    auto right{pop()};
+    auto left{pop()};
+
+    if (left.is_integer() && right.is_integer()) {
+        auto left_val{left.as_integer()};
+        auto right_val{right.as_integer()};
+
+        switch (op) {
+        case code::opcode::Add:
+            return object::value::integer(helpers::wrapping_add(left_val, right_val));
+        case code::opcode::Sub:
+            return object::value::integer(helpers::wrapping_sub(left_val, right_val));
+        case code::opcode::Mul:
+            return object::value::integer(helpers::wrapping_mul(left_val, right_val));
+        case code::opcode::Div:
+            if (right_val == 0) {
+                return error("division by zero");
+            }
+            return object::value::integer(helpers::wrapping_div(left_val, right_val));
+        case code::opcode::GreaterThan:
+            return object::value::boolean(left_val > right_val);
+        case code::opcode::LessThan:
+            return object::value::boolean(left_val < right_val);
+        case code::opcode::Equal:
+            return object::value::boolean(left_val == right_val);
+        case code::opcode::NotEqual:
+            return object::value::boolean(left_val != right_val);
+        default:
+            return unknown_operator(op, left, right);
+        }
+    } else if (left.is_boolean() && right.is_boolean()) {
+        auto left_val{left.as_boolean()};
+        auto right_val{right.as_boolean()};
+
+        switch (op) {
+        case code::opcode::Equal:
+            return object::value::boolean(left_val == right_val);
+        case code::opcode::NotEqual:
+            return object::value::boolean(left_val != right_val);
+        default:
+            return unknown_operator(op, left, right);
+        }
+    } else if (left.type() == object::object_type::String && right.type() == object::object_type::String) {
+        if (op != code::opcode::Add) {
+            return unknown_operator(op, left, right);
+        }
+
+        return object::make<object::string>(left.as<object::string>().value + right.as<object::string>().value);
+    }
+
+    return error(std::format(
+        "type mismatch: {} {} {}",
+        object::get_object_type_string(left.type()),
+        operator_string(op),
+        object::get_object_type_string(right.type())
+    ));
+}
+
+auto vm::execute_index(object::value left, object::value index) -> object::value {
+    if (left.type() == object::object_type::Array && index.is_integer()) {
+        auto& arr{left.as<object::array>()};
+        auto idx{index.as_integer()};
+
+        if (idx >= static_cast<i64>(arr.elements.size()) || idx < 0) {
+            return object::value::null();
+        }
+
+        return arr.elements[static_cast<usize>(idx)];
+    } else if (left.type() == object::object_type::Hash) {
+        if (!index.is_hashable()) {
+            return error(std::format("unusable as hash key: {}", object::get_object_type_string(index.type())));
+        }
+
+        auto& hash{left.as<object::hash>()};
+        auto pair{hash.pairs.find(index.get_hash_key())};
+        if (!pair) {
+            return object::value::null();
+        }
+
+        return pair->second;
+    }
+
+    return error(std::format("index not supported: {}", object::get_object_type_string(left.type())));
+}
+
+auto vm::execute_call(usize num_args) -> object::value {
+    auto callee{stack[sp - 1 - num_args]};
+
+    if (callee.type() == object::object_type::Closure) {
+        auto cl{&callee.as<object::closure>()};
+        if (num_args != cl->fn->num_parameters) {
+            return error(
+                std::format("wrong number of arguments: want={}, got={}", cl->fn->num_parameters, num_args)
+            );
+        }
+
+        // The main function's frame is not a call.
+        if (frames.size() > eval::get_max_depth()) {
+            return error("stack overflow");
+        }
+
+        auto bp{sp - num_args};
+        if (bp + cl->fn->num_locals >= stack.size()) {
+            stack.resize(std::max(stack.size() * 2, bp + cl->fn->num_locals + 1));
+        }
+
+        for (usize i{bp + num_args}; i < bp + cl->fn->num_locals; i++) {
+            stack[i] = {};
+        }
+
+        frames.push_back(frame{cl, 0, bp});
+        sp = bp + cl->fn->num_locals;
+
+        return {};
+    } else if (callee.type() == object::object_type::Builtin) {
+        auto result{callee.as<object::builtin>().fn(std::span{stack}.subspan(sp - num_args, num_args))};
+        sp -= num_args + 1;
+
+        if (!result.has_value()) {
+            result = object::value::null();
+        } else if (result.is_error()) {
+            return result;
+        }
+
+        push(result);
+
+        return {};
+    }
+
+    return error(std::format("not a function: {}", object::get_object_type_string(callee.type())));
+}
+
+auto vm::build_hash(usize start, usize end) -> object::value {
+    auto hash{object::make<object::hash>()};
+    auto& pairs{hash.as<object::hash>().pairs};
+
+    for (usize i{start}; i < end; i += 2) {
+        if (!stack[i].is_hashable()) {
+            return error(std::format("unusable as hash key: {}", object::get_object_type_string(stack[i].type())));
+        }
+
+        pairs = pairs.insert(stack[i].get_hash_key(), std::make_pair(stack[i], stack[i + 1]));
+    }
+
+    return hash;
+}
+
+}
+
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "code.h"
+#include "compiler.h"
+#include "object.h"
+#include "types.h"
+
+#include <memory>
+#include <string_view>
+#include <vector>
+
+namespace interp {
+
+namespace vm {
+
+// The value stack starts out this big and doubles whenever it is full. How deep calls go is limited by
+// eval::get_max_depth, same as in the evaluator.
+static constexpr usize stack_size{2048};
+
+class frame {
+public:
+    const object::closure* cl{};
+    usize ip{};
+    usize bp{};
+};
+
+class vm {
+public:
+    vm(const compiler::bytecode& bytecode, std::vector<object::value>& globals);
+    vm(const vm&) = delete;
+    auto operator=(const vm&) -> vm& = delete;
+    ~vm();
+
+    auto run() -> object::value;
+
+private:
+    auto push(object::value val) -> void;
+    auto pop() -> object::value;
+
+    auto execute_binary(code::opcode op) -> object::value;
+    auto execute_index(object::value left, object::value index) -> object::value;
+    auto execute_call(usize num_args) -> object::value;
+    auto build_hash(usize start, usize end) -> object::value;
+
+private:
+    const std::vector<object::value>& constants;
+    const std::vector<std::string>& global_names;
+    std::vector<object::value>& globals;
+
+    object::compiled_function main_fn;
+    object::closure main;
+
+    std::vector<object::value> stack;
+    usize sp{};
+
+    std::vector<frame> frames{};
+};
+
+}
+
+}
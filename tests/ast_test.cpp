@@ -7,31 +7,32 @@ TEST(ast, let_string) {
 
     ast::program p{};
 
-    token::token let_tok{};
-    let_tok.literal = "let";
-    let_tok.type = token::token_type::Let;
+    auto let{p.node_arena->make<ast::let_statement>(ast::source_span{0, 3})};
+    let->name = ast::identifier{ast::source_span{4, 5}, "myVar"};
+    let->value = p.node_arena->make<ast::identifier>(ast::source_span{12, 10}, "anotherVal");
 
-    token::token let_ident_tok{};
-    let_ident_tok.literal = "myVar";
-    let_ident_tok.type = token::token_type::Ident;
+    p.statements.push_back(std::move(let));
 
-    ast::identifier let_ident{};
-    let_ident.token = let_ident_tok;
-    let_ident.value = "myVar";
-
-    token::token ident_tok{};
-    ident_tok.type = token::token_type::Ident;
-    ident_tok.literal = "anotherVal";
-
-    ast::identifier ident{};
-    ident.token = ident_tok;
-    ident.value = "anotherVal";
-
-    ast::let_statement let{let_tok};
-    let.name = let_ident;
-    let.value = std::make_unique<ast::identifier>(ident);
+    ASSERT_STREQ(p.to_string().c_str(), "let myVar = anotherVal;");
+}
 
-    p.statements.push_back(std::make_unique<ast::let_statement>(std::move(let)));
+TEST(ast, arena) {
+    using namespace interp;
 
-    ASSERT_STREQ(p.to_string().c_str(), "let myVar = anotherVal;");
+    ast::arena a{};
+    ASSERT_EQ(a.num_nodes, 0);
+    ASSERT_EQ(a.bytes_reserved, 0);
+
+    std::vector<ast::node_ptr<ast::integer_literal>> ints{};
+    for (i64 i{0}; i < 10000; i++) {
+        ints.push_back(a.make<ast::integer_literal>(ast::source_span{static_cast<u32>(i), 1}, i));
+    }
+
+    ASSERT_EQ(a.num_nodes, 10000);
+    ASSERT_GE(a.bytes_used, 10000 * sizeof(ast::integer_literal));
+    ASSERT_GE(a.bytes_reserved, a.bytes_used);
+    for (i64 i{0}; i < 10000; i++) {
+        ASSERT_EQ(ints[static_cast<usize>(i)]->value, i);
+        ASSERT_EQ(ints[static_cast<usize>(i)]->span.offset, i);
+    }
 }
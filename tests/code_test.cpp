@@ -0,0 +1,95 @@
+#include <gtest/gtest.h>
+
+#include "code.h"
+
+TEST(code, make) {
+    using namespace interp;
+
+    struct make_test {
+        code::opcode op{};
+        std::vector<usize> operands{};
+        code::instructions expected{};
+    };
+
+    std::array tests{
+        make_test{code::opcode::Constant, {65534},  {static_cast<u8>(code::opcode::Constant), 0, 0, 255, 254}},
+        make_test{code::opcode::GetGlobal, {65534}, {static_cast<u8>(code::opcode::GetGlobal), 255, 254}      },
+        make_test{code::opcode::GetLocal, {255},    {static_cast<u8>(code::opcode::GetLocal), 255}            },
+        make_test{code::opcode::Add,      {},       {static_cast<u8>(code::opcode::Add)}                      },
+        make_test{
+                  code::opcode::Closure,
+                  {65534, 255},
+                  {static_cast<u8>(code::opcode::Closure), 0, 0, 255, 254, 255}
+        },
+    };
+
+    for (const auto& test : tests) {
+        code::instructions ins{};
+        switch (test.operands.size()) {
+        case 0:
+            ins = code::make(test.op);
+            break;
+        case 1:
+            ins = code::make(test.op, {test.operands[0]});
+            break;
+        case 2:
+            ins = code::make(test.op, {test.operands[0], test.operands[1]});
+            break;
+        }
+
+        ASSERT_EQ(ins, test.expected);
+    }
+}
+
+TEST(code, instructions_string) {
+    using namespace interp;
+
+    std::vector<code::instructions> instructions{
+        code::make(code::opcode::Add),
+        code::make(code::opcode::GetLocal, {1}),
+        code::make(code::opcode::Constant, {2}),
+        code::make(code::opcode::Constant, {65535}),
+        code::make(code::opcode::Closure, {65535, 255}),
+    };
+
+    static constexpr std::string_view expected{R"(0000 OpAdd
+0001 OpGetLocal 1
+0003 OpConstant 2
+0008 OpConstant 65535
+0013 OpClosure 65535 255
+)"};
+
+    code::instructions concatted{};
+    for (const auto& ins : instructions) {
+        concatted.insert(concatted.end(), ins.begin(), ins.end());
+    }
+
+    ASSERT_EQ(code::to_string(concatted), expected);
+}
+
+TEST(code, read_operands) {
+    using namespace interp;
+
+    struct read_test {
+        code::opcode op{};
+        std::vector<usize> operands{};
+        usize bytes_read{};
+    };
+
+    std::array tests{
+        read_test{code::opcode::Constant, {65535},   4},
+        read_test{code::opcode::GetLocal, {255},     1},
+        read_test{code::opcode::Closure,  {65535, 255}, 5},
+    };
+
+    for (const auto& test : tests) {
+        auto ins{
+            test.operands.size() == 1 ? code::make(test.op, {test.operands[0]})
+                                      : code::make(test.op, {test.operands[0], test.operands[1]})
+        };
+
+        auto [operands, read]{code::read_operands(code::lookup(test.op), std::span{ins}.subspan(1))};
+        ASSERT_EQ(read, test.bytes_read);
+        ASSERT_EQ(operands, test.operands);
+    }
+}
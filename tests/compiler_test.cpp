@@ -0,0 +1,194 @@
+#include <gtest/gtest.h>
+
+#include "code.h"
+#include "compiler.h"
+#include "lexer.h"
+#include "parser.h"
+
+#include <stdexcept>
+
+static auto concat(std::initializer_list<interp::code::instructions> instructions) -> interp::code::instructions {
+    interp::code::instructions out{};
+    for (const auto& ins : instructions) {
+        out.insert(out.end(), ins.begin(), ins.end());
+    }
+
+    return out;
+}
+
+static auto compile(std::string_view input, interp::compiler::state& state) -> interp::compiler::compiler {
+    using namespace interp;
+
+    auto l{lexer::lexer{input}};
+    auto p{parser::parser{l}};
+    auto program{p.parse_program()};
+    if (!p.errors.empty()) {
+        throw std::runtime_error{"parser errors"};
+    }
+
+    compiler::compiler c{state};
+    c.compile(program);
+
+    return c;
+}
+
+TEST(compiler, symbol_table) {
+    using namespace interp;
+
+    compiler::symbol_table global{};
+    auto a{global.define("a")};
+    ASSERT_EQ(a.scope, compiler::symbol_scope::Global);
+    ASSERT_EQ(a.index, 0);
+
+    compiler::symbol_table fn{&global, false};
+    fn.captured.insert("c");
+    auto b{fn.define("b")};
+    auto c{fn.define("c")};
+    ASSERT_EQ(b.scope, compiler::symbol_scope::Local);
+    ASSERT_EQ(b.index, 0);
+    ASSERT_FALSE(b.boxed);
+    ASSERT_EQ(c.index, 1);
+    ASSERT_TRUE(c.boxed);
+
+    compiler::symbol_table block{&fn, true};
+    auto d{block.define("d")};
+    ASSERT_EQ(d.scope, compiler::symbol_scope::Local);
+    ASSERT_EQ(d.index, 2);
+    ASSERT_EQ(fn.num_locals, 3);
+    ASSERT_EQ(block.resolve("b")->scope, compiler::symbol_scope::Local);
+
+    compiler::symbol_table nested{&block, false};
+    ASSERT_EQ(nested.resolve("a")->scope, compiler::symbol_scope::Global);
+
+    auto free_c{nested.resolve("c")};
+    ASSERT_EQ(free_c->scope, compiler::symbol_scope::Free);
+    ASSERT_EQ(free_c->index, 0);
+    ASSERT_EQ(nested.free_symbols.size(), 1);
+    ASSERT_EQ(nested.free_symbols[0].index, 1);
+
+    ASSERT_FALSE(nested.resolve("e").has_value());
+}
+
+TEST(compiler, integer_arithmetic) {
+    using namespace interp;
+
+    compiler::state state{};
+    auto c{compile("1 + 2; 3 * 4", state)};
+    ASSERT_TRUE(c.errors.empty());
+
+    auto expected{concat({
+        code::make(code::opcode::Constant, {0}),
+        code::make(code::opcode::Constant, {1}),
+        code::make(code::opcode::Add),
+        code::make(code::opcode::Pop),
+        code::make(code::opcode::Constant, {2}),
+        code::make(code::opcode::Constant, {3}),
+        code::make(code::opcode::Mul),
+        code::make(code::opcode::ReturnValue),
+        code::make(code::opcode::Return),
+    })};
+
+    ASSERT_EQ(code::to_string(c.get_bytecode().main.instructions), code::to_string(expected));
+    ASSERT_EQ(state.constants.size(), 4);
+}
+
+TEST(compiler, while_statement) {
+    using namespace interp;
+
+    compiler::state state{};
+    auto c{compile("let x = 0; while (x < 5) { x = x + 1; if (x == 3) { break; } }", state)};
+    ASSERT_TRUE(c.errors.empty());
+
+    auto expected{concat({
+        code::make(code::opcode::Constant, {0}),
+        code::make(code::opcode::SetGlobal, {0}),
+        // 0008
+        code::make(code::opcode::GetGlobal, {0}),
+        code::make(code::opcode::Constant, {1}),
+        code::make(code::opcode::LessThan),
+        code::make(code::opcode::JumpNotTruthy, {70}),
+        // 0022
+        code::make(code::opcode::GetGlobal, {0}),
+        code::make(code::opcode::Constant, {2}),
+        code::make(code::opcode::Add),
+        code::make(code::opcode::AssignGlobal, {0}),
+        code::make(code::opcode::GetGlobal, {0}),
+        code::make(code::opcode::Pop),
+        // 0038
+        code::make(code::opcode::GetGlobal, {0}),
+        code::make(code::opcode::Constant, {3}),
+        code::make(code::opcode::Equal),
+        code::make(code::opcode::JumpNotTruthy, {63}),
+        code::make(code::opcode::Jump, {70}),
+        code::make(code::opcode::Null),
+        // 0058
+        code::make(code::opcode::Jump, {64}),
+        // 0063
+        code::make(code::opcode::Null),
+        code::make(code::opcode::Pop),
+        code::make(code::opcode::Jump, {8}),
+        // 0070
+        code::make(code::opcode::Return),
+    })};
+
+    ASSERT_EQ(code::to_string(c.get_bytecode().main.instructions), code::to_string(expected));
+}
+
+TEST(compiler, closures) {
+    using namespace interp;
+
+    compiler::state state{};
+    auto c{compile("fn(a) { let b = 1; fn(c) { a + b + c } }", state)};
+    ASSERT_TRUE(c.errors.empty());
+
+    auto& inner{dynamic_cast<object::compiled_function&>(*state.constants[1].as_object())};
+    auto inner_expected{concat({
+        code::make(code::opcode::GetFree, {0}),
+        code::make(code::opcode::GetFree, {1}),
+        code::make(code::opcode::Add),
+        code::make(code::opcode::GetLocal, {0}),
+        code::make(code::opcode::Add),
+        code::make(code::opcode::ReturnValue),
+    })};
+    ASSERT_EQ(code::to_string(inner.instructions), code::to_string(inner_expected));
+
+    auto& outer{dynamic_cast<object::compiled_function&>(*state.constants[2].as_object())};
+    auto outer_expected{concat({
+        code::make(code::opcode::GetLocal, {0}),
+        code::make(code::opcode::NewCell, {0}),
+        code::make(code::opcode::SetDeref, {0}),
+        code::make(code::opcode::NewCell, {1}),
+        code::make(code::opcode::Constant, {0}),
+        code::make(code::opcode::SetDeref, {1}),
+        code::make(code::opcode::GetLocal, {0}),
+        code::make(code::opcode::GetLocal, {1}),
+        code::make(code::opcode::Closure, {1, 2}),
+        code::make(code::opcode::ReturnValue),
+    })};
+    ASSERT_EQ(code::to_string(outer.instructions), code::to_string(outer_expected));
+    ASSERT_EQ(outer.num_locals, 2);
+    ASSERT_EQ(outer.num_parameters, 1);
+}
+
+TEST(compiler, errors) {
+    using namespace interp;
+
+    struct error_test {
+        std::string_view input{};
+        std::string_view expected{};
+    };
+
+    std::array tests{
+        error_test{"break;",                         "break statement is illegal in current context"   },
+        error_test{"if (true) { continue; }",        "continue statement is illegal in current context"},
+        error_test{"while (true) { fn() { break; } }", "break statement is illegal in current context"   },
+        error_test{"len = 5",                        "variable len does not exist yet"                 },
+    };
+
+    for (const auto& test : tests) {
+        compiler::state state{};
+        auto c{compile(test.input, state)};
+        ASSERT_EQ(c.errors.size(), 1);
+        ASSERT_EQ(c.errors[0], test.expected);
+    }
+}
@@ -5,19 +5,22 @@
 #include "lexer.h"
 #include "object.h"
 #include "parser.h"
+#include "resolver.h"
 #include "types.h"
+#include <limits>
 #include <memory>
 #include <optional>
 #include <ranges>
 #include <string_view>
 #include <type_traits>
 
-static auto test_eval(std::string_view input) -> std::unique_ptr<interp::object::object> {
+static auto test_eval(std::string_view input) -> interp::object::value {
     using namespace interp;
 
     auto l{lexer::lexer{input}};
     auto p{parser::parser{l}};
     auto program{p.parse_program()};
+    resolver::resolver{}.resolve(program);
     auto env{object::environment{}};
 
     auto x = eval::eval(program, env);
@@ -25,30 +28,30 @@ static auto test_eval(std::string_view input) -> std::unique_ptr<interp::object:
     return x;
 }
 
-static auto test_int_object(const interp::object::object& obj, interp::i64 expected) -> void {
-    using namespace interp;
-
-    auto& result{dynamic_cast<const object::integer&>(obj)};
+static auto test_int_object(interp::object::value obj, interp::i64 expected) -> void {
+    if (!obj.is_integer()) {
+        throw std::runtime_error{std::format("obj should be Integer is {}.", obj.to_string())};
+    }
 
-    if (result.value != expected) {
-        throw std::runtime_error{std::format("result.value should be {} is {}.", expected, result.value)};
+    if (obj.as_integer() != expected) {
+        throw std::runtime_error{std::format("result.value should be {} is {}.", expected, obj.as_integer())};
     }
 }
 
-static auto test_bool_object(const interp::object::object& obj, bool expected) -> void {
-    using namespace interp;
-
-    auto& result{dynamic_cast<const object::boolean&>(obj)};
+static auto test_bool_object(interp::object::value obj, bool expected) -> void {
+    if (!obj.is_boolean()) {
+        throw std::runtime_error{std::format("obj should be Boolean is {}.", obj.to_string())};
+    }
 
-    if (result.value != expected) {
-        throw std::runtime_error{std::format("result.value should be {} is {}.", expected, result.value)};
+    if (obj.as_boolean() != expected) {
+        throw std::runtime_error{std::format("result.value should be {} is {}.", expected, obj.as_boolean())};
     }
 }
 
-static auto test_null_object(const interp::object::object& obj) -> void {
-    using namespace interp;
-
-    [[maybe_unused]] auto& result{dynamic_cast<const object::null&>(obj)};
+static auto test_null_object(interp::object::value obj) -> void {
+    if (!obj.is_null()) {
+        throw std::runtime_error{std::format("obj should be Null is {}.", obj.to_string())};
+    }
 }
 
 TEST(eval, int_expression) {
@@ -79,7 +82,32 @@ TEST(eval, int_expression) {
 
     for (const auto& test : tests) {
         auto evaluated{test_eval(test.input)};
-        test_int_object(*evaluated, test.expected);
+        test_int_object(evaluated, test.expected);
+    }
+}
+
+TEST(eval, integer_overflow) {
+    using namespace interp;
+
+    struct int_test {
+        std::string_view input{};
+        i64 expected{};
+    };
+
+    static constexpr auto min{std::numeric_limits<i64>::min()};
+    static constexpr auto max{std::numeric_limits<i64>::max()};
+
+    static constexpr std::array tests{
+        int_test{"9223372036854775807 + 1",         min},
+        int_test{"-9223372036854775807 - 2",        max},
+        int_test{"9223372036854775807 * 2",         -2 },
+        int_test{"(-9223372036854775807 - 1) / -1", min},
+        int_test{"-(-9223372036854775807 - 1)",     min},
+    };
+
+    for (const auto& test : tests) {
+        auto evaluated{test_eval(test.input)};
+        test_int_object(evaluated, test.expected);
     }
 }
 
@@ -115,7 +143,7 @@ TEST(eval, bool_expression) {
 
     for (const auto& test : tests) {
         auto evaluated{test_eval(test.input)};
-        test_bool_object(*evaluated, test.expected);
+        test_bool_object(evaluated, test.expected);
     }
 }
 
@@ -138,7 +166,7 @@ TEST(eval, bang_operator) {
 
     for (const auto& test : tests) {
         auto evaluated{test_eval(test.input)};
-        test_bool_object(*evaluated, test.expected);
+        test_bool_object(evaluated, test.expected);
     }
 }
 
@@ -166,9 +194,9 @@ TEST(eval, if_else) {
             [&](const auto& val) {
                 using T = std::decay_t<decltype(val)>;
                 if constexpr (std::is_same_v<T, i64>) {
-                    test_int_object(*evaluated, val);
+                    test_int_object(evaluated, val);
                 } else if constexpr (std::is_same_v<T, std::nullptr_t>) {
-                    test_null_object(*evaluated);
+                    test_null_object(evaluated);
                 }
             },
             test.expected
@@ -221,7 +249,7 @@ TEST(eval, return) {
 
     for (const auto& test : tests) {
         auto evaluated{test_eval(test.input)};
-        test_int_object(*evaluated, test.expected);
+        test_int_object(evaluated, test.expected);
     }
 }
 
@@ -256,7 +284,7 @@ TEST(eval, error) {
 
     for (const auto& test : tests) {
         auto evaluated{test_eval(test.input)};
-        auto err = dynamic_cast<object::error&>(*evaluated);
+        auto err = dynamic_cast<object::error&>(*evaluated.as_object());
         ASSERT_EQ(err.message, test.expected_message);
     }
 }
@@ -278,7 +306,7 @@ TEST(eval, let_statement) {
 
     for (const auto& test : tests) {
         auto evaluated{test_eval(test.input)};
-        test_int_object(*evaluated, test.expected);
+        test_int_object(evaluated, test.expected);
     }
 }
 
@@ -288,12 +316,14 @@ TEST(eval, function_object) {
     static constexpr std::string_view input{"fn(x) { x + 2; };"};
 
     auto evaluated{test_eval(input)};
-    auto& fn = dynamic_cast<object::function&>(*evaluated);
-    ASSERT_EQ(fn.parameters.size(), 1);
-    ASSERT_EQ(fn.parameters[0]->to_string(), "x");
+    auto& fn = dynamic_cast<object::function&>(*evaluated.as_object());
+    const auto& proto{(*fn.tree)[fn.node]};
+    auto parameters{fn.tree->list(proto.a, proto.b)};
+    ASSERT_EQ(parameters.size(), 1);
+    ASSERT_EQ(fn.tree->to_string(parameters[0]), "x");
 
     static constexpr std::string_view expected_body = "(x + 2)";
-    ASSERT_EQ(expected_body, fn.body->to_string());
+    ASSERT_EQ(expected_body, fn.tree->to_string(proto.c));
 }
 
 TEST(eval, function_application) {
@@ -315,7 +345,7 @@ TEST(eval, function_application) {
 
     for (const auto& test : tests) {
         auto evaluated{test_eval(test.input)};
-        test_int_object(*evaluated, test.expected);
+        test_int_object(evaluated, test.expected);
     }
 }
 
@@ -330,7 +360,34 @@ let addTwo = newAdder(2);
 addTwo(2);)"};
 
     auto evaluated{test_eval(input)};
-    test_int_object(*evaluated, 4);
+    test_int_object(evaluated, 4);
+}
+
+TEST(eval, closures_in_loop) {
+    using namespace interp;
+
+    static constexpr std::array tests{
+        std::pair{
+            std::string_view{"let fns = []; let i = 0; "
+                             "while (i < 3) { let j = i; fns = push(fns, fn() { j * 10 }); i = i + 1; } "
+                             "fns[0]() + fns[1]() + fns[2]()"},
+            30
+        },
+        std::pair{
+            std::string_view{"let newAdder = fn(x) { fn(y) { x + y } }; let sum = 0; let i = 0; "
+                             "while (i < 100) { sum = sum + newAdder(i)(1); i = i + 1; } sum"},
+            5050
+        },
+        std::pair{
+            std::string_view{"let twice = fn() { fn(x) { x * 2 } }; let a = twice(); let b = twice(); a(b(3))"},
+            12
+        },
+    };
+
+    for (const auto& [input, expected] : tests) {
+        auto evaluated{test_eval(input)};
+        test_int_object(evaluated, expected);
+    }
 }
 
 TEST(eval, strings) {
@@ -339,7 +396,7 @@ TEST(eval, strings) {
     static constexpr std::string_view input{"\"Hello World!\""};
 
     auto evaluated{test_eval(input)};
-    auto& str{dynamic_cast<object::string&>(*evaluated)};
+    auto& str{dynamic_cast<object::string&>(*evaluated.as_object())};
     ASSERT_EQ(str.value, "Hello World!");
 }
 
@@ -349,7 +406,7 @@ TEST(eval, string_concat) {
     static constexpr std::string_view input{"\"Hello\" + \" \" + \"World\""};
 
     auto evaluated{test_eval(input)};
-    auto& str{dynamic_cast<object::string&>(*evaluated)};
+    auto& str{dynamic_cast<object::string&>(*evaluated.as_object())};
     ASSERT_EQ(str.value, "Hello World");
 }
 
@@ -362,23 +419,29 @@ TEST(eval, builtins) {
     };
 
     std::array tests{
-        builtin_test{"len(\"\")",             0                                               },
-        builtin_test{"len(\"four\")",         4                                               },
-        builtin_test{"len(\"hello world\")",  11                                              },
-        builtin_test{"len(1)",                "argument to 'len' not supported, got: Integer" },
-        builtin_test{"len(\"one\", \"two\")", "wrong number of arguments. got: 2, want: 1"    },
-        builtin_test{"len([1, 2, 3])",        3                                               },
-        builtin_test{"len([])",               0                                               },
-        builtin_test{"first([1, 2, 3])",      1                                               },
-        builtin_test{"first([])",             nullptr                                         },
-        builtin_test{"first(1)",              "argument to 'first' must be Array, got Integer"},
-        builtin_test{"last([1, 2, 3])",       3                                               },
-        builtin_test{"last([])",              nullptr                                         },
-        builtin_test{"last(1)",               "argument to 'last' must be Array, got Integer" },
-        builtin_test{"rest([1, 2, 3])",       std::vector<i64>{2, 3}                          },
-        builtin_test{"rest([])",              nullptr                                         },
-        builtin_test{"push([], 1)",           std::vector<i64>{1}                             },
-        builtin_test{"push(1, 1)",            "argument to 'push' must be Array, got Integer" },
+        builtin_test{"len(\"\")",                                         0                                               },
+        builtin_test{"len(\"four\")",                                     4                                               },
+        builtin_test{"len(\"hello world\")",                              11                                              },
+        builtin_test{"len(1)",                                            "argument to 'len' not supported, got: Integer" },
+        builtin_test{"len(\"one\", \"two\")",                             "wrong number of arguments. got: 2, want: 1"    },
+        builtin_test{"len([1, 2, 3])",                                    3                                               },
+        builtin_test{"len([])",                                           0                                               },
+        builtin_test{"first([1, 2, 3])",                                  1                                               },
+        builtin_test{"first([])",                                         nullptr                                         },
+        builtin_test{"first(1)",                                          "argument to 'first' must be Array, got Integer"},
+        builtin_test{"last([1, 2, 3])",                                   3                                               },
+        builtin_test{"last([])",                                          nullptr                                         },
+        builtin_test{"last(1)",                                           "argument to 'last' must be Array, got Integer" },
+        builtin_test{"rest([1, 2, 3])",                                   std::vector<i64>{2, 3}                          },
+        builtin_test{"rest([])",                                          nullptr                                         },
+        builtin_test{"push([], 1)",                                       std::vector<i64>{1}                             },
+        builtin_test{"push(1, 1)",                                        "argument to 'push' must be Array, got Integer" },
+        builtin_test{"set({}, 1, 2)[1]",                                  2                                               },
+        builtin_test{"let h = {1: 2}; let g = set(h, 1, 3); h[1] + g[1]", 5                                               },
+        builtin_test{"delete({1: 2, 3: 4}, 1)[1]",                        nullptr                                         },
+        builtin_test{"delete({1: 2, 3: 4}, 1)[3]",                        4                                               },
+        builtin_test{"set(1, 1, 1)",                                      "argument to 'set' must be Hash, got Integer"   },
+        builtin_test{"delete({}, [])",                                    "unusable as hash key: Array"                   },
     };
 
     for (const auto& test : tests) {
@@ -388,19 +451,19 @@ TEST(eval, builtins) {
             [&](const auto& val) {
                 using T = std::decay_t<decltype(val)>;
                 if constexpr (std::is_same_v<T, i64>) {
-                    test_int_object(*evaluated, val);
+                    test_int_object(evaluated, val);
                 } else if constexpr (std::is_same_v<T, std::string>) {
-                    auto& err{dynamic_cast<object::error&>(*evaluated)};
+                    auto& err{dynamic_cast<object::error&>(*evaluated.as_object())};
                     ASSERT_EQ(err.message, val);
                 } else if constexpr (std::is_same_v<T, std::vector<i64>>) {
-                    auto& arr{dynamic_cast<object::array&>(*evaluated)};
+                    auto& arr{dynamic_cast<object::array&>(*evaluated.as_object())};
 
                     ASSERT_EQ(arr.elements.size(), val.size());
                     for (const auto& [elem, v] : std::ranges::zip_view(arr.elements, val)) {
-                        test_int_object(*elem, v);
+                        test_int_object(elem, v);
                     }
                 } else if constexpr (std::is_same_v<T, std::nullptr_t>) {
-                    test_null_object(*evaluated);
+                    test_null_object(evaluated);
                 }
             },
             test.expected
@@ -408,18 +471,49 @@ TEST(eval, builtins) {
     }
 }
 
+TEST(eval, builtin_parse_int) {
+    using namespace interp;
+
+    struct parse_int_test {
+        std::string_view input{};
+        std::variant<i64, std::string> expected{};
+    };
+
+    std::array tests{
+        parse_int_test{"parse_int(\"42\")",    42                                                     },
+        parse_int_test{"parse_int(\" -17 \")", -17                                                    },
+        parse_int_test{"parse_int(\"+8\")",    8                                                      },
+        parse_int_test{"parse_int(\"12abc\")", "invalid argument to function 'parse_int()', got 12abc"},
+        parse_int_test{
+                       "parse_int(\"99999999999999999999\")",
+                       "argument to function 'parse_int()' is out of range, got 99999999999999999999"
+        },
+    };
+
+    for (const auto& test : tests) {
+        auto evaluated{test_eval(test.input)};
+
+        if (auto val{std::get_if<i64>(&test.expected)}) {
+            test_int_object(evaluated, *val);
+        } else {
+            auto& err{dynamic_cast<object::error&>(*evaluated.as_object())};
+            ASSERT_EQ(err.message, std::get<std::string>(test.expected));
+        }
+    }
+}
+
 TEST(eval, array_literal) {
     using namespace interp;
 
     static constexpr std::string_view input{"[1, 2 * 2, 3 + 3]"};
 
     auto evaluated{test_eval(input)};
-    auto& result{dynamic_cast<object::array&>(*evaluated)};
+    auto& result{dynamic_cast<object::array&>(*evaluated.as_object())};
     ASSERT_EQ(result.elements.size(), 3);
 
-    test_int_object(*result.elements[0], 1);
-    test_int_object(*result.elements[1], 4);
-    test_int_object(*result.elements[2], 6);
+    test_int_object(result.elements[0], 1);
+    test_int_object(result.elements[1], 4);
+    test_int_object(result.elements[2], 6);
 }
 
 TEST(eval, index_expression) {
@@ -447,9 +541,9 @@ TEST(eval, index_expression) {
         auto evaluated{test_eval(test.input)};
 
         if (test.expected.has_value()) {
-            test_int_object(*evaluated, *test.expected);
+            test_int_object(evaluated, *test.expected);
         } else {
-            test_null_object(*evaluated);
+            test_null_object(evaluated);
         }
     }
 }
@@ -470,23 +564,24 @@ TEST(eval, hash_literals) {
     )"};
 
     auto evaluated{test_eval(input)};
-    auto& hash{dynamic_cast<object::hash&>(*evaluated)};
+    auto& hash{dynamic_cast<object::hash&>(*evaluated.as_object())};
 
     std::unordered_map<object::hash_key, i64> expected{
-        {object::string{"one"}.get_hash_key(),   1},
-        {object::string{"two"}.get_hash_key(),   2},
-        {object::string{"three"}.get_hash_key(), 3},
-        {object::integer{4}.get_hash_key(),      4},
-        {object::boolean{true}.get_hash_key(),   5},
-        {object::boolean{false}.get_hash_key(),  6},
+        {object::string{"one"}.get_hash_key(),          1},
+        {object::string{"two"}.get_hash_key(),          2},
+        {object::string{"three"}.get_hash_key(),        3},
+        {object::value::integer(4).get_hash_key(),      4},
+        {object::value::boolean(true).get_hash_key(),   5},
+        {object::value::boolean(false).get_hash_key(),  6},
     };
 
     ASSERT_EQ(hash.pairs.size(), expected.size());
 
     for (const auto& [expected_key, expected_val] : expected) {
-        auto& pair{hash.pairs[expected_key]};
+        auto pair{hash.pairs.find(expected_key)};
+        ASSERT_NE(pair, nullptr);
 
-        test_int_object(*pair.second, expected_val);
+        test_int_object(pair->second, expected_val);
     }
 }
 
@@ -512,13 +607,38 @@ TEST(eval, index_hash_expressions) {
         auto evaluated{test_eval(test.input)};
 
         if (test.expected.has_value()) {
-            test_int_object(*evaluated, *test.expected);
+            test_int_object(evaluated, *test.expected);
         } else {
-            test_null_object(*evaluated);
+            test_null_object(evaluated);
         }
     }
 }
 
+TEST(eval, shared_values) {
+    using namespace interp;
+
+    static constexpr std::array inputs{
+        std::string_view{"let a = [1, 2, 3]; [a, a]"},
+        std::string_view{"let h = {1: [1, 2]}; [h[1], h[1]]"},
+        std::string_view{"let a = [[1], 2]; [first(a), a[0]]"},
+        std::string_view{"let a = [1, [2]]; [last(a), a[1]]"},
+    };
+
+    for (const auto& input : inputs) {
+        auto evaluated{test_eval(input)};
+        auto& arr{dynamic_cast<object::array&>(*evaluated.as_object())};
+
+        ASSERT_EQ(arr.elements.size(), 2);
+        ASSERT_EQ(arr.elements[0].as_object(), arr.elements[1].as_object());
+    }
+
+    auto evaluated{test_eval("let a = [1, 2]; let b = push(a, 3); let c = rest(a); [len(a), len(b), len(c)]")};
+    auto& lens{dynamic_cast<object::array&>(*evaluated.as_object())};
+    test_int_object(lens.elements[0], 2);
+    test_int_object(lens.elements[1], 3);
+    test_int_object(lens.elements[2], 1);
+}
+
 TEST(eval, assign_expression) {
     using namespace interp;
 
@@ -540,11 +660,11 @@ TEST(eval, assign_expression) {
             [&](const auto& val) {
                 using T = std::decay_t<decltype(val)>;
                 if constexpr (std::is_same_v<T, i64>) {
-                    test_int_object(*evaluated, val);
+                    test_int_object(evaluated, val);
                 } else if constexpr (std::is_same_v<T, bool>) {
-                    test_bool_object(*evaluated, val);
+                    test_bool_object(evaluated, val);
                 } else if constexpr (std::is_same_v<T, std::string>) {
-                    auto& error{dynamic_cast<object::error&>(*evaluated)};
+                    auto& error{dynamic_cast<object::error&>(*evaluated.as_object())};
                     ASSERT_EQ(error.message, val);
                 }
             },
@@ -567,7 +687,7 @@ TEST(eval, assign_expression_chain) {
 
     auto evaluated{test_eval(input)};
 
-    auto& str{dynamic_cast<object::string&>(*evaluated)};
+    auto& str{dynamic_cast<object::string&>(*evaluated.as_object())};
     ASSERT_EQ(str.value, "barbar");
 }
 
@@ -605,8 +725,7 @@ TEST(eval, while_statement) {
 
     for (const auto& test : tests) {
         auto evaluated{test_eval(test.input)};
-        auto& integer{dynamic_cast<object::integer&>(*evaluated)};
-        ASSERT_EQ(integer.value, test.expected);
+        test_int_object(evaluated, test.expected);
     }
 }
 
@@ -643,9 +762,9 @@ TEST(eval, break_statement) {
             [&](const auto& val) {
                 using T = std::decay_t<decltype(val)>;
                 if constexpr (std::is_same_v<T, i64>) {
-                    test_int_object(*evaluated, val);
+                    test_int_object(evaluated, val);
                 } else if constexpr (std::is_same_v<T, std::string>) {
-                    auto err{dynamic_cast<object::error&>(*evaluated)};
+                    auto err{dynamic_cast<object::error&>(*evaluated.as_object())};
                     ASSERT_EQ(err.message, val);
                 }
             },
@@ -690,9 +809,9 @@ TEST(eval, continue_statement) {
             [&](const auto& val) {
                 using T = std::decay_t<decltype(val)>;
                 if constexpr (std::is_same_v<T, i64>) {
-                    test_int_object(*evaluated, val);
+                    test_int_object(evaluated, val);
                 } else if constexpr (std::is_same_v<T, std::string>) {
-                    auto err{dynamic_cast<object::error&>(*evaluated)};
+                    auto err{dynamic_cast<object::error&>(*evaluated.as_object())};
                     ASSERT_EQ(err.message, val);
                 }
             },
@@ -700,3 +819,21 @@ TEST(eval, continue_statement) {
         );
     }
 }
+
+TEST(eval, deep_recursion) {
+    using namespace interp;
+
+    static constexpr std::string_view countdown{R"(
+        let countdown = fn(n) { if (n == 0) { 0 } else { countdown(n - 1) } };
+        countdown()"};
+
+    test_int_object(test_eval(std::format("{}50000);", countdown)), 0);
+
+    auto overflow{test_eval(std::format("{}200000);", countdown))};
+    ASSERT_EQ(dynamic_cast<object::error&>(*overflow.as_object()).message, "stack overflow");
+
+    eval::set_max_depth(10);
+    auto limited{test_eval(std::format("{}20);", countdown))};
+    eval::set_max_depth(eval::default_max_depth);
+    ASSERT_EQ(dynamic_cast<object::error&>(*limited.as_object()).message, "stack overflow");
+}
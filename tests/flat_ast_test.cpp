@@ -0,0 +1,178 @@
+#include <gtest/gtest.h>
+
+#include "ast.h"
+#include "eval.h"
+#include "flat_ast.h"
+#include "lexer.h"
+#include "object.h"
+#include "parser.h"
+#include "resolver.h"
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+static auto parse(std::string_view input) -> interp::ast::program {
+    using namespace interp;
+
+    lexer::lexer l{input};
+    parser::parser p{l};
+    auto program{p.parse_program()};
+    if (!p.errors.empty()) {
+        throw std::runtime_error{p.errors[0]};
+    }
+
+    resolver::resolver{}.resolve(program);
+
+    return program;
+}
+
+static constexpr std::string_view programs[]{
+    "let x = 5; let y = x * -2 + !true;",
+    "return 10;",
+    "if (x < y) { x } else { y }; if (a) { b }",
+    "let add = fn(a, b) { return a + b; }; add(1, add(2, 3));",
+    "let arr = [1, \"two\", [3]]; arr[2][0]",
+    "{\"one\": 1, true: fn() { 2 }}",
+    "let i = 0; while (i < 10) { i = i + 1; if (i == 5) { break; } continue; }",
+    "-9223372036854775807 - 1",
+    "",
+};
+
+TEST(flat_ast, to_string) {
+    using namespace interp;
+
+    for (auto input : programs) {
+        auto program{parse(input)};
+        auto tree{flat_ast::flatten(program)};
+
+        ASSERT_EQ(tree.to_string(), program.to_string());
+    }
+}
+
+TEST(flat_ast, layout) {
+    using namespace interp;
+
+    auto program{parse("let x = 1; while (x < 3) { let y = x; x = x + y; }")};
+    auto tree{flat_ast::flatten(program)};
+
+    const auto& root{tree[0]};
+    ASSERT_EQ(root.type, ast::node_type::Program);
+    ASSERT_EQ(root.b, 2);
+    ASSERT_EQ(root.c, program.num_slots);
+
+    // Every node comes before its children.
+    for (flat_ast::node_index i{0}; i < tree.size(); i++) {
+        if (tree[i].type == ast::node_type::InfixExpression) {
+            ASSERT_GT(tree[i].a, i);
+            ASSERT_GT(tree[i].b, i);
+        }
+    }
+
+    auto stmts{tree.list(root.a, root.b)};
+    const auto& let{tree[stmts[0]]};
+    ASSERT_EQ(let.type, ast::node_type::LetStatement);
+    ASSERT_EQ(tree.string(tree[let.a].c), "x");
+    ASSERT_EQ(tree.integer(let.b), 1);
+    ASSERT_EQ(tree.spans[stmts[0]].offset, 0);
+    ASSERT_EQ(tree.spans[stmts[0]].length, 3);
+
+    const auto& loop{tree[stmts[1]]};
+    ASSERT_EQ(loop.type, ast::node_type::WhileStatement);
+    ASSERT_EQ(tree[loop.b].c, 1);
+
+    // Names are stored once.
+    ASSERT_EQ(tree.chars, "xy");
+}
+
+TEST(flat_ast, serialize) {
+    using namespace interp;
+
+    for (auto input : programs) {
+        auto tree{flat_ast::flatten(parse(input))};
+        auto bytes{tree.serialize()};
+
+        auto read{flat_ast::tree::deserialize(bytes)};
+        ASSERT_TRUE(read.has_value());
+        ASSERT_EQ(read->to_string(), tree.to_string());
+        ASSERT_EQ(read->serialize(), bytes);
+    }
+}
+
+TEST(flat_ast, deserialize_invalid) {
+    using namespace interp;
+
+    auto bytes{flat_ast::flatten(parse("let f = fn(x) { x * 2 }; f(21)")).serialize()};
+
+    ASSERT_FALSE(flat_ast::tree::deserialize({}).has_value());
+    for (usize len{0}; len < bytes.size(); len++) {
+        ASSERT_FALSE(flat_ast::tree::deserialize(std::span{bytes}.first(len)).has_value());
+    }
+
+    // The first node's type.
+    auto bad_type{bytes};
+    bad_type[5 * sizeof(u32)] = std::byte{0xff};
+    ASSERT_FALSE(flat_ast::tree::deserialize(bad_type).has_value());
+
+    // The program's statement count, past the end of the lists.
+    auto bad_list{bytes};
+    bad_list[5 * sizeof(u32) + 3 + sizeof(u32)] = std::byte{0x7f};
+    ASSERT_FALSE(flat_ast::tree::deserialize(bad_list).has_value());
+}
+
+TEST(flat_ast, deserialize_invalid_slots) {
+    using namespace interp;
+
+    auto tree{flat_ast::flatten(parse("let y = 1; let f = fn(x) { x * y }; f(21)"))};
+    ASSERT_TRUE(flat_ast::tree::deserialize(tree.serialize()).has_value());
+
+    auto with{[&](auto change) {
+        auto changed{tree};
+        for (auto& n : changed.nodes) {
+            if (n.type == ast::node_type::Identifier && !n.flag && changed.string(n.c) == "y" && n.a == 1) {
+                change(n);
+            }
+        }
+        return flat_ast::tree::deserialize(changed.serialize());
+    }};
+
+    // The read of y inside f, past the globals.
+    ASSERT_FALSE(with([](flat_ast::node& n) { n.b = 1000; }).has_value());
+    // Further out than the program.
+    ASSERT_FALSE(with([](flat_ast::node& n) { n.a = 2; }).has_value());
+    // Past the builtins.
+    ASSERT_FALSE(with([](flat_ast::node& n) {
+                     n.flag = true;
+                     n.b = 1000;
+                 }).has_value());
+
+    // More parameters than the body has slots.
+    auto params{tree};
+    for (auto& n : params.nodes) {
+        if (n.type == ast::node_type::FnExpression) {
+            params.nodes[n.c].c = 0;
+        }
+    }
+    ASSERT_FALSE(flat_ast::tree::deserialize(params.serialize()).has_value());
+}
+
+TEST(flat_ast, eval) {
+    using namespace interp;
+
+    auto bytes{flat_ast::flatten(parse(R"(
+        let make = fn(n) { let i = 0; let arr = []; while (i < n) { arr = push(arr, i * i); i = i + 1; } arr };
+        let sum = fn(arr) { let i = 0; let s = 0; while (i < len(arr)) { s = s + arr[i]; i = i + 1; } s };
+        sum(make(10))
+    )"))
+                   .serialize()};
+
+    auto tree{flat_ast::tree::deserialize(bytes)};
+    ASSERT_TRUE(tree.has_value());
+
+    object::environment env{};
+    auto evaluated{eval::eval(std::make_shared<const flat_ast::tree>(std::move(*tree)), env)};
+    ASSERT_TRUE(evaluated.is_integer());
+    ASSERT_EQ(evaluated.as_integer(), 285);
+}
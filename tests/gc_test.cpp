@@ -0,0 +1,130 @@
+#include <gtest/gtest.h>
+
+#include "compiler.h"
+#include "eval.h"
+#include "lexer.h"
+#include "object.h"
+#include "parser.h"
+#include "resolver.h"
+#include "vm.h"
+
+#include <array>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+
+class threshold_guard {
+public:
+    threshold_guard(interp::usize bytes) {
+        interp::object::get_heap().set_threshold(bytes);
+    }
+
+    ~threshold_guard() {
+        interp::object::get_heap().set_threshold(interp::object::heap::default_threshold);
+    }
+};
+
+static auto parse(std::string_view input) -> interp::ast::program {
+    using namespace interp;
+
+    auto l{lexer::lexer{input}};
+    auto p{parser::parser{l}};
+    auto program{p.parse_program()};
+    if (!p.errors.empty()) {
+        throw std::runtime_error{"parser errors"};
+    }
+
+    return program;
+}
+
+static auto test_eval(std::string_view input) -> std::string {
+    using namespace interp;
+
+    auto program{parse(input)};
+    resolver::resolver{}.resolve(program);
+    auto env{object::environment{}};
+
+    return eval::eval(program, env).to_string();
+}
+
+static auto test_vm(std::string_view input) -> std::string {
+    using namespace interp;
+
+    auto program{parse(input)};
+
+    compiler::state state{};
+    compiler::compiler c{state};
+    c.compile(program);
+    if (!c.errors.empty()) {
+        throw std::runtime_error{std::format("compiler error: {}", c.errors[0])};
+    }
+
+    std::vector<object::value> globals{};
+    vm::vm machine{c.get_bytecode(), globals};
+
+    return machine.run().to_string();
+}
+
+static constexpr std::string_view garbage_in_loop{R"(
+let pair = fn(x) { [x, {"x": x}] };
+let i = 0;
+let sum = 0;
+while (i < 20000) {
+    let p = pair(i);
+    sum = sum + p[1]["x"];
+    i = i + 1;
+}
+sum
+)"};
+
+TEST(gc, garbage_in_loop) {
+    using namespace interp;
+
+    threshold_guard guard{4096};
+    auto& heap{object::get_heap()};
+    auto collections{heap.stats.collections};
+
+    ASSERT_EQ(test_eval(garbage_in_loop), "199990000");
+    ASSERT_GT(heap.stats.collections, collections);
+    ASSERT_LT(heap.num_objects, 2000);
+
+    collections = heap.stats.collections;
+    ASSERT_EQ(test_vm(garbage_in_loop), "199990000");
+    ASSERT_GT(heap.stats.collections, collections);
+    ASSERT_LT(heap.num_objects, 2000);
+}
+
+TEST(gc, collect_on_every_allocation) {
+    using namespace interp;
+
+    threshold_guard guard{0};
+
+    static constexpr std::array tests{
+        std::pair{std::string_view{"\"a\" + \"b\" + \"c\""}, std::string_view{"\"abc\""}},
+        std::pair{
+            std::string_view{"[\"a\", [\"b\"], {\"c\": \"d\"}]"},
+            std::string_view{"[\"a\", [\"b\"], {\"c\": \"d\"}]"}
+        },
+        std::pair{std::string_view{"{\"a\" + \"b\": \"c\" + \"d\"}[\"ab\"]"}, std::string_view{"\"cd\""}},
+        std::pair{std::string_view{"[\"a\", \"b\"][len(\"x\" + \"y\") - 1]"}, std::string_view{"\"b\""}},
+        std::pair{
+            std::string_view{"let f = fn(a, b) { [a, b] }; f(\"x\" + \"y\", \"z\" + \"w\")"},
+            std::string_view{"[\"xy\", \"zw\"]"}
+        },
+        std::pair{
+            std::string_view{"let counter = fn() { let n = 0; fn() { n = n + 1; push([], n) } }; "
+                             "let c = counter(); c(); c()"},
+            std::string_view{"[2]"}
+        },
+        std::pair{
+            std::string_view{"let a = []; let i = 0; while (i < 50) { a = push(a, to_string(i)); i = i + 1; } last(a)"},
+            std::string_view{"\"49\""}
+        },
+    };
+
+    for (const auto& [input, expected] : tests) {
+        ASSERT_EQ(test_eval(input), expected) << input;
+        ASSERT_EQ(test_vm(input), expected) << input;
+    }
+}
@@ -262,3 +262,126 @@ TEST(lexer, next_token_3) {
         ASSERT_EQ(expected.type, tok.type);
     }
 }
+
+TEST(lexer, tokens_borrow_input) {
+    using namespace interp;
+
+    static constexpr std::string_view input{"let five == \"str\";"};
+
+    lexer::lexer l{input};
+
+    for (auto tok = l.next_token(); tok.type != token::token_type::End; tok = l.next_token()) {
+        ASSERT_GE(tok.literal.data(), input.data());
+        ASSERT_LE(tok.literal.data() + tok.literal.size(), input.data() + input.size());
+    }
+}
+
+TEST(lexer, keywords) {
+    using namespace interp;
+
+    std::array tests{
+        std::pair{std::string_view{"fn"},        token::token_type::Function},
+        std::pair{std::string_view{"let"},       token::token_type::Let     },
+        std::pair{std::string_view{"true"},      token::token_type::True    },
+        std::pair{std::string_view{"false"},     token::token_type::False   },
+        std::pair{std::string_view{"if"},        token::token_type::If      },
+        std::pair{std::string_view{"else"},      token::token_type::Else    },
+        std::pair{std::string_view{"return"},    token::token_type::Return  },
+        std::pair{std::string_view{"while"},     token::token_type::While   },
+        std::pair{std::string_view{"break"},     token::token_type::Break   },
+        std::pair{std::string_view{"continue"},  token::token_type::Continue},
+        std::pair{std::string_view{"f"},         token::token_type::Ident   },
+        std::pair{std::string_view{"fns"},       token::token_type::Ident   },
+        std::pair{std::string_view{"lett"},      token::token_type::Ident   },
+        std::pair{std::string_view{"el"},        token::token_type::Ident   },
+        std::pair{std::string_view{"whilst"},    token::token_type::Ident   },
+        std::pair{std::string_view{"continued"}, token::token_type::Ident   },
+    };
+
+    for (const auto& [ident, expected] : tests) {
+        ASSERT_EQ(expected, token::lookup_ident(ident));
+    }
+}
+
+TEST(lexer, long_runs) {
+    using namespace interp;
+
+    static constexpr std::string_view input{
+        "  \t\n\r\n         let a_very_long_identifier_name_that_spans_blocks = 12345678901234567890123;"
+        "\"a string body that is longer than one sixteen byte block\" \"unterminated"
+    };
+
+    std::array tests{
+        token::token{token::token_type::Let,       "let"                                         },
+        token::token{token::token_type::Ident,     "a_very_long_identifier_name_that_spans_blocks"},
+        token::token{token::token_type::Assign,    "="                                           },
+        token::token{token::token_type::Int,       "12345678901234567890123"                     },
+        token::token{token::token_type::Semicolon, ";"                                           },
+        token::token{token::token_type::String,    "a string body that is longer than one sixteen byte block"},
+        token::token{token::token_type::String,    "unterminated"                                },
+        token::token{token::token_type::End,       ""                                            },
+    };
+
+    lexer::lexer l{input};
+
+    for (const auto& expected : tests) {
+        auto tok = l.next_token();
+
+        ASSERT_EQ(expected.type, tok.type);
+        ASSERT_EQ(expected.literal, tok.literal);
+    }
+}
+
+TEST(lexer, tokenize) {
+    using namespace interp;
+
+    static constexpr std::string_view input{"let x = [1, \"two\"];\nx[0] == 1"};
+
+    lexer::lexer streamed{input};
+    lexer::lexer batched{input};
+    auto tokens{batched.tokenize()};
+
+    ASSERT_EQ(tokens.types.size(), tokens.offsets.size());
+    ASSERT_EQ(tokens.types.size(), tokens.lengths.size());
+
+    for (usize i{}; i < tokens.size(); i++) {
+        auto expected = streamed.next_token();
+        auto tok = tokens.at(i);
+
+        ASSERT_EQ(expected.type, tok.type);
+        ASSERT_EQ(expected.literal, tok.literal);
+    }
+
+    ASSERT_EQ(token::token_type::End, tokens.types.back());
+    ASSERT_EQ(token::token_type::End, tokens.at(tokens.size()).type);
+}
+
+TEST(lexer, tokenize_parallel) {
+    using namespace interp;
+
+    // Long string literals full of spaces and quotes make the chunk boundaries land inside strings.
+    std::string input{};
+    while (input.size() < (4 << 20)) {
+        input += "let x = [1, 22, 333]; let s = \"a string with spaces and == tokens in it\"; x[0] != \"\"; ";
+        input += "\"" + std::string(5000, ' ') + "\";\n";
+    }
+
+    auto check{[](std::string_view text) {
+        auto expected{lexer::lexer{text}.tokenize()};
+        auto tokens{lexer::tokenize(text, 4)};
+
+        ASSERT_EQ(expected.size(), tokens.size());
+        for (usize i{}; i < tokens.size(); i++) {
+            ASSERT_EQ(expected.types[i], tokens.types[i]);
+            ASSERT_EQ(expected.offsets[i], tokens.offsets[i]);
+            ASSERT_EQ(expected.lengths[i], tokens.lengths[i]);
+        }
+    }};
+
+    check(input);
+    check(input + "\"unterminated string with spaces");
+
+    auto with_nul{input};
+    with_nul[with_nul.size() / 2] = '\0';
+    check(with_nul);
+}
@@ -0,0 +1,170 @@
+#include <gtest/gtest.h>
+
+#include "ast.h"
+#include "eval.h"
+#include "lexer.h"
+#include "object.h"
+#include "optimizer.h"
+#include "parser.h"
+#include "resolver.h"
+#include "types.h"
+
+#include <array>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+struct optimized {
+    std::string ast{};
+    interp::optimizer::opt_stats stats{};
+};
+
+static auto parse(std::string_view input) -> interp::ast::program {
+    using namespace interp;
+
+    lexer::lexer l{input};
+    parser::parser p{l};
+    auto program{p.parse_program()};
+    if (!p.errors.empty()) {
+        throw std::runtime_error{p.errors[0]};
+    }
+
+    resolver::resolver{}.resolve(program);
+
+    return program;
+}
+
+static auto test_optimize(std::string_view input) -> optimized {
+    using namespace interp;
+
+    auto program{parse(input)};
+    optimizer::optimizer o{};
+    o.optimize(program);
+
+    return optimized{program.to_string(), o.stats};
+}
+
+static auto test_eval(std::string_view input, bool optimize) -> std::string {
+    using namespace interp;
+
+    auto program{parse(input)};
+    if (optimize) {
+        optimizer::optimizer{}.optimize(program);
+    }
+
+    object::environment env{};
+    return eval::eval(program, env).to_string();
+}
+
+TEST(optimizer, constant_folding) {
+    using namespace interp;
+
+    struct folding_test {
+        std::string_view input{};
+        std::string_view expected{};
+        usize folded{};
+    };
+
+    static constexpr std::array tests{
+        folding_test{"60 * 60 * 24",                "86400",                     2},
+        folding_test{"-5 + 10 / 2",                 "0",                         3},
+        folding_test{"!true == false",              "true",                      2},
+        folding_test{"1 < 2 != 3 > 4",              "true",                      3},
+        folding_test{"!5",                          "false",                     1},
+        folding_test{"\"foo\" + \"bar\" + \"baz\"", "foobarbaz",                 2},
+        folding_test{"fn(x) { x * (2 + 3) }",       "fn(x)(x * 5)",              1},
+        folding_test{"[1 + 1, {2 * 2: 3 - 3}[4]]",  "[2, ({4: 0}[4])]",          3},
+        folding_test{"1 / 0",                       "(1 / 0)",                   0},
+        folding_test{"5 + true",                    "(5 + true)",                0},
+        folding_test{"9223372036854775807 + 1",     "(9223372036854775807 + 1)", 0},
+    };
+
+    for (const auto& test : tests) {
+        auto got{test_optimize(test.input)};
+        ASSERT_EQ(got.ast, test.expected);
+        ASSERT_EQ(got.stats.folded, test.folded);
+    }
+}
+
+TEST(optimizer, constant_propagation) {
+    using namespace interp;
+
+    struct propagation_test {
+        std::string_view input{};
+        std::string_view expected{};
+        usize propagated{};
+    };
+
+    // Lets whose reads were all replaced are removed afterwards.
+    static constexpr std::array tests{
+        propagation_test{"let x = 3; x * x",                                "9",                                   2},
+        propagation_test{"let s = \"a\"; let t = s + s; t",                 "aa",                                  3},
+        propagation_test{"let x = 3; let f = fn() { x + 1 }; f()",          "let f = fn()4;f()",                   1},
+        propagation_test{"let x = 3; x = 4; x",                             "let x = 3;x = 4x",                    0},
+        propagation_test{"let x = 3; let x = 4; x",                         "let x = 3;let x = 4;x",               0},
+        propagation_test{"let f = fn() { x }; let x = 3; f()",              "let f = fn()x;let x = 3;f()",         0},
+        propagation_test{"if (true) { let x = 3; }; x",                     "let x = 3;x",                         0},
+        propagation_test{"let x = 1; let f = fn(x) { x }; f(2)",            "let f = fn(x)x;f(2)",                 0},
+        propagation_test{"let i = 0; while (i < 3) { let d = 1; i = i + d; } i",
+                         "let i = 0;while (i < 3) i = (i + 1)i",                                                     1},
+    };
+
+    for (const auto& test : tests) {
+        auto got{test_optimize(test.input)};
+        ASSERT_EQ(got.ast, test.expected);
+        ASSERT_EQ(got.stats.propagated, test.propagated);
+    }
+}
+
+TEST(optimizer, dead_code) {
+    using namespace interp;
+
+    struct dead_code_test {
+        std::string_view input{};
+        std::string_view expected{};
+        usize pruned{};
+    };
+
+    static constexpr std::array tests{
+        dead_code_test{"if (true) { 1 } else { 2 }",                              "1",                           7 },
+        dead_code_test{"if (false) { 1 }; 2",                                     "2",                           6 },
+        dead_code_test{"if (1 > 2) { 1 }",                                        "iffalse 1",                   0 },
+        dead_code_test{"if (\"s\") { puts(1); 2 } else { 3 }",                    "puts(1)2",                    7 },
+        dead_code_test{"let f = fn() { return 1; 2; 3 }; f()",                    "let f = fn()return 1;;f()",   4 },
+        dead_code_test{"let i = 0; while (i < 1) { i = i + 1; continue; i = 5; } i",
+                       "let i = 0;while (i < 1) i = (i + 1)continuei",                                           4 },
+        dead_code_test{"let a = 1; let b = [a, 2]; let c = fn() { b }; puts(1)", "puts(1)",                     11},
+        dead_code_test{"let x = 1",                                               "let x = 1;",                  0 },
+        dead_code_test{"let x = puts(1); 2",                                      "let x = puts(1);2",           0 },
+        dead_code_test{"let x = 1; x = 2; 3",                                     "let x = 1;x = 23",            0 },
+    };
+
+    for (const auto& test : tests) {
+        auto got{test_optimize(test.input)};
+        ASSERT_EQ(got.ast, test.expected);
+        ASSERT_EQ(got.stats.pruned, test.pruned);
+    }
+}
+
+TEST(optimizer, same_results) {
+    static constexpr std::array inputs{
+        std::string_view{"let x = 3; x * x"},
+        std::string_view{"let day = 60 * 60 * 24; day / 3600"},
+        std::string_view{"let x = 3; x = x + 1; x"},
+        std::string_view{"let n = 10; let f = fn(a) { a * n }; f(n)"},
+        std::string_view{"let i = 0; let s = 0; while (i < 4) { let d = 2; s = s + d; i = i + 1; } s"},
+        std::string_view{"len(\"ab\" + \"cd\")"},
+        std::string_view{"let f = fn() { x }; let x = 3; f()"},
+        std::string_view{"1 / 0"},
+        std::string_view{"-true"},
+        std::string_view{"if (true) { 1 } else { 2 }"},
+        std::string_view{"5; if (false) { 1 }"},
+        std::string_view{"let f = fn() { if (true) { return 1; }; 2 }; f()"},
+        std::string_view{"let f = fn() { 1; let x = 2 }; f()"},
+        std::string_view{"let i = 0; while (true) { if (i > 3) { break; }; i = i + 1; } i"},
+    };
+
+    for (const auto& input : inputs) {
+        ASSERT_EQ(test_eval(input, true), test_eval(input, false));
+    }
+}
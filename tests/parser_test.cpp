@@ -1,8 +1,11 @@
 #include <gtest/gtest.h>
 
 #include "ast.h"
+#include "eval.h"
 #include "lexer.h"
+#include "object.h"
 #include "parser.h"
+#include "resolver.h"
 
 #include <print>
 #include <ranges>
@@ -82,8 +85,10 @@ test_infix_expression(const interp::ast::expression& expr, const T1& left, std::
 
     test_literal_expression(*in_expr.left, left);
 
-    if (in_expr.oper != oper) {
-        throw std::runtime_error{std::format("expr.oper should be {} is {}.", oper, in_expr.oper)};
+    if (interp::ast::get_operator_string(in_expr.oper) != oper) {
+        throw std::runtime_error{
+            std::format("expr.oper should be {} is {}.", oper, interp::ast::get_operator_string(in_expr.oper))
+        };
     }
 
     test_literal_expression(*in_expr.right, right);
@@ -218,6 +223,19 @@ TEST(parser, integer_expression) {
     ASSERT_EQ(int_lit.token_literal(), "5");
 }
 
+TEST(parser, integer_out_of_range) {
+    using namespace interp;
+
+    static constexpr std::string_view input{"9223372036854775807; 9223372036854775808;"};
+
+    lexer::lexer l{input};
+    parser::parser p{l};
+    p.parse_program();
+
+    ASSERT_EQ(p.errors.size(), 1);
+    ASSERT_EQ(p.errors[0], "integer 9223372036854775808 is out of range");
+}
+
 TEST(parser, prefix_expressions) {
     using namespace interp;
 
@@ -247,7 +265,7 @@ TEST(parser, prefix_expressions) {
         auto& stmt{dynamic_cast<ast::expression_statement&>(*program.statements[0])};
         auto& expr{dynamic_cast<ast::prefix_expression&>(*stmt.expr)};
 
-        ASSERT_EQ(expr.oper, test.oper);
+        ASSERT_EQ(ast::get_operator_string(expr.oper), test.oper);
         std::visit(
             [&](const auto& val) {
                 test_literal_expression(*expr.right, val);
@@ -372,7 +390,7 @@ TEST(parser, if_expression) {
     auto& expr{dynamic_cast<ast::if_expression&>(*stmt.expr)};
 
     test_infix_expression(*expr.condition, "x", "<", "y");
-    auto consq = dynamic_cast<ast::block_statement&>(*expr.consequence);
+    auto& consq = dynamic_cast<ast::block_statement&>(*expr.consequence);
     ASSERT_EQ(consq.statements.size(), 1);
 
     auto& consequence{dynamic_cast<ast::expression_statement&>(*consq.statements[0])};
@@ -398,12 +416,12 @@ TEST(parser, if_else_expression) {
 
     test_infix_expression(*expr.condition, "x", "<", "y");
 
-    auto consq = dynamic_cast<ast::block_statement&>(*expr.consequence);
+    auto& consq = dynamic_cast<ast::block_statement&>(*expr.consequence);
     ASSERT_EQ(consq.statements.size(), 1);
     auto& consequence{dynamic_cast<ast::expression_statement&>(*consq.statements[0])};
     test_identifier(*consequence.expr, "x");
 
-    auto alter = dynamic_cast<ast::block_statement&>(*expr.alternative);
+    auto& alter = dynamic_cast<ast::block_statement&>(*expr.alternative);
     ASSERT_EQ(alter.statements.size(), 1);
     auto& alternative{dynamic_cast<ast::expression_statement&>(*alter.statements[0])};
     test_identifier(*alternative.expr, "y");
@@ -423,12 +441,12 @@ TEST(parser, fn_literal) {
     auto& stmt{dynamic_cast<ast::expression_statement&>(*program.statements[0])};
 
     auto& fn{dynamic_cast<ast::fn_expression&>(*stmt.expr)};
-    ASSERT_EQ(fn.parameters.size(), 2);
+    ASSERT_EQ(fn.prototype->parameters.size(), 2);
 
-    test_literal_expression(*fn.parameters[0], "x");
-    test_literal_expression(*fn.parameters[1], "y");
+    test_literal_expression(*fn.prototype->parameters[0], "x");
+    test_literal_expression(*fn.prototype->parameters[1], "y");
 
-    auto body = dynamic_cast<ast::block_statement&>(*fn.body);
+    auto& body = dynamic_cast<ast::block_statement&>(*fn.prototype->body);
     ASSERT_EQ(body.statements.size(), 1);
     auto& body_stmt{dynamic_cast<ast::expression_statement&>(*body.statements[0])};
 
@@ -459,9 +477,9 @@ TEST(parser, fn_parameter) {
         auto& stmt{dynamic_cast<ast::expression_statement&>(*program.statements[0])};
         auto& fn{dynamic_cast<ast::fn_expression&>(*stmt.expr)};
 
-        ASSERT_EQ(fn.parameters.size(), test.expected_params.size());
-        for (u32 i = 0; i < fn.parameters.size(); i++) {
-            test_literal_expression(*fn.parameters.at(i), test.expected_params.at(i));
+        ASSERT_EQ(fn.prototype->parameters.size(), test.expected_params.size());
+        for (u32 i = 0; i < fn.prototype->parameters.size(); i++) {
+            test_literal_expression(*fn.prototype->parameters.at(i), test.expected_params.at(i));
         }
     }
 }
@@ -755,7 +773,7 @@ TEST(parser, while_statement) {
     auto& stmt{dynamic_cast<ast::while_statement&>(*program.statements[0])};
 
     test_infix_expression(*stmt.condition, "x", "<", 5);
-    auto body_stmt{dynamic_cast<ast::block_statement&>(*stmt.body)};
+    auto& body_stmt{dynamic_cast<ast::block_statement&>(*stmt.body)};
     ASSERT_EQ(body_stmt.statements.size(), 1);
 
     auto& body{dynamic_cast<ast::expression_statement&>(*body_stmt.statements[0])};
@@ -793,3 +811,99 @@ TEST(parser, continue) {
 
     ASSERT_EQ(stmt.token_literal(), "continue");
 }
+
+TEST(parser, token_buffer) {
+    using namespace interp;
+
+    static constexpr std::array inputs{
+        std::string_view{"let add = fn(a, b) { return a + b; }; add(1, 2 * 3)"},
+        std::string_view{"let h = {\"a\": [1, 2][0], true: !false}; h[\"a\"] + -1;"},
+        std::string_view{"let i = 0; while (i < 10) { if (i == 5) { break; } else { i = i + 1; continue; } }"},
+    };
+
+    for (const auto& input : inputs) {
+        lexer::lexer streamed_lexer{input};
+        parser::parser streamed{streamed_lexer};
+        auto expected{streamed.parse_program()};
+        check_parser_errors(streamed);
+
+        lexer::lexer batched_lexer{input};
+        auto tokens{batched_lexer.tokenize()};
+        parser::parser batched{tokens};
+        auto program{batched.parse_program()};
+        check_parser_errors(batched);
+
+        ASSERT_EQ(program.to_string(), expected.to_string());
+    }
+}
+
+TEST(parser, deeply_nested_expression) {
+    using namespace interp;
+
+    // Parentheses do not nest the ast, so any number of them parses.
+    auto grouped{std::format("{}1{} + 2;", std::string(100'000, '('), std::string(100'000, ')'))};
+    lexer::lexer grouped_lexer{grouped};
+    parser::parser grouped_parser{grouped_lexer};
+    auto program{grouped_parser.parse_program()};
+    check_parser_errors(grouped_parser);
+    ASSERT_EQ(program.to_string(), "(1 + 2)");
+
+    auto shallow{std::format("{}1;", std::string(900, '-'))};
+    lexer::lexer shallow_lexer{shallow};
+    parser::parser shallow_parser{shallow_lexer};
+    shallow_parser.parse_program();
+    check_parser_errors(shallow_parser);
+
+    auto deep{std::format("{}1;", std::string(100'000, '-'))};
+    lexer::lexer deep_lexer{deep};
+    parser::parser deep_parser{deep_lexer};
+    deep_parser.parse_program();
+    ASSERT_FALSE(deep_parser.errors.empty());
+    ASSERT_EQ(deep_parser.errors[0], "expression nested deeper than 1000 levels");
+}
+
+TEST(parser, long_operator_chain) {
+    using namespace interp;
+
+    // Only the right operand of an operator is nested deeper, so chains of any length parse.
+    std::string input{"0"};
+    for (usize i{1}; i < 10'000; i++) {
+        input += " + 1";
+    }
+
+    lexer::lexer l{input};
+    parser::parser p{l};
+    auto program{p.parse_program()};
+    check_parser_errors(p);
+
+    resolver::resolver{}.resolve(program);
+    object::environment env{};
+    auto evaluated{eval::eval(program, env)};
+    ASSERT_TRUE(evaluated.is_integer());
+    ASSERT_EQ(evaluated.as_integer(), 9'999);
+}
+
+TEST(parser, deeply_nested_blocks) {
+    using namespace interp;
+
+    auto nested{[](usize depth) {
+        std::string input{};
+        for (usize i{0}; i < depth; i++) {
+            input += "while (x) { ";
+        }
+        return input + std::string(depth, '}');
+    }};
+
+    auto shallow{nested(900)};
+    lexer::lexer shallow_lexer{shallow};
+    parser::parser shallow_parser{shallow_lexer};
+    shallow_parser.parse_program();
+    check_parser_errors(shallow_parser);
+
+    auto deep{nested(100'000)};
+    lexer::lexer deep_lexer{deep};
+    parser::parser deep_parser{deep_lexer};
+    deep_parser.parse_program();
+    ASSERT_FALSE(deep_parser.errors.empty());
+    ASSERT_EQ(deep_parser.errors[0], "expression nested deeper than 1000 levels");
+}
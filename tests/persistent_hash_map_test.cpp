@@ -0,0 +1,100 @@
+#include <gtest/gtest.h>
+
+#include "persistent_hash_map.h"
+#include "types.h"
+
+class colliding_hash {
+public:
+    auto operator()(interp::i64 key) const -> interp::usize {
+        return static_cast<interp::usize>(key % 4);
+    }
+};
+
+TEST(persistent_hash_map, insert_find) {
+    using namespace interp;
+
+    persistent::hash_map<i64, i64> map{};
+    for (i64 i{0}; i < 10000; i++) {
+        map = map.insert(i, i * 2);
+    }
+
+    ASSERT_EQ(map.size(), 10000);
+    for (i64 i{0}; i < 10000; i++) {
+        ASSERT_NE(map.find(i), nullptr);
+        ASSERT_EQ(*map.find(i), i * 2);
+    }
+    ASSERT_EQ(map.find(10000), nullptr);
+
+    map = map.insert(5, 0);
+    ASSERT_EQ(map.size(), 10000);
+    ASSERT_EQ(*map.find(5), 0);
+}
+
+TEST(persistent_hash_map, sharing) {
+    using namespace interp;
+
+    auto base{persistent::hash_map<i64, i64>{}.insert(1, 1).insert(2, 2)};
+    auto inserted{base.insert(3, 3)};
+    auto replaced{base.insert(1, 10)};
+    auto erased{base.erase(1)};
+
+    ASSERT_EQ(base.size(), 2);
+    ASSERT_EQ(*base.find(1), 1);
+    ASSERT_FALSE(base.contains(3));
+
+    ASSERT_EQ(inserted.size(), 3);
+    ASSERT_EQ(*replaced.find(1), 10);
+
+    ASSERT_EQ(erased.size(), 1);
+    ASSERT_FALSE(erased.contains(1));
+    ASSERT_TRUE(erased.contains(2));
+    ASSERT_EQ(erased.erase(2).size(), 0);
+    ASSERT_EQ(erased.erase(7).size(), 1);
+}
+
+TEST(persistent_hash_map, erase) {
+    using namespace interp;
+
+    persistent::hash_map<i64, i64> map{};
+    for (i64 i{0}; i < 5000; i++) {
+        map = map.insert(i, i);
+    }
+
+    for (i64 i{0}; i < 5000; i += 2) {
+        map = map.erase(i);
+    }
+
+    ASSERT_EQ(map.size(), 2500);
+    for (i64 i{0}; i < 5000; i++) {
+        ASSERT_EQ(map.contains(i), i % 2 == 1);
+    }
+
+    usize count{};
+    map.for_each([&](i64 key, i64 val) {
+        ASSERT_EQ(key, val);
+        count++;
+    });
+    ASSERT_EQ(count, 2500);
+}
+
+TEST(persistent_hash_map, collisions) {
+    using namespace interp;
+
+    persistent::hash_map<i64, i64, colliding_hash> map{};
+    for (i64 i{0}; i < 100; i++) {
+        map = map.insert(i, -i);
+    }
+
+    ASSERT_EQ(map.size(), 100);
+    for (i64 i{0}; i < 100; i++) {
+        ASSERT_EQ(*map.find(i), -i);
+    }
+
+    for (i64 i{0}; i < 100; i += 3) {
+        map = map.erase(i);
+    }
+
+    for (i64 i{0}; i < 100; i++) {
+        ASSERT_EQ(map.contains(i), i % 3 != 0);
+    }
+}
@@ -0,0 +1,58 @@
+#include <gtest/gtest.h>
+
+#include "persistent_vector.h"
+#include "types.h"
+
+TEST(persistent_vector, push_back) {
+    using namespace interp;
+
+    persistent::vector<i64> vec{};
+    for (i64 i{0}; i < 100000; i++) {
+        vec = vec.push_back(i);
+    }
+
+    ASSERT_EQ(vec.size(), 100000);
+    for (i64 i{0}; i < 100000; i++) {
+        ASSERT_EQ(vec[static_cast<usize>(i)], i);
+    }
+    ASSERT_EQ(vec.front(), 0);
+    ASSERT_EQ(vec.back(), 99999);
+}
+
+TEST(persistent_vector, sharing) {
+    using namespace interp;
+
+    persistent::vector<i64> base{std::vector<i64>{1, 2, 3}};
+    auto pushed{base.push_back(4)};
+    auto popped{base.pop_front()};
+
+    ASSERT_EQ(base.size(), 3);
+    ASSERT_EQ(base.back(), 3);
+
+    ASSERT_EQ(pushed.size(), 4);
+    ASSERT_EQ(pushed.back(), 4);
+
+    ASSERT_EQ(popped.size(), 2);
+    ASSERT_EQ(popped.front(), 2);
+    ASSERT_EQ(popped.push_back(5).back(), 5);
+    ASSERT_EQ(popped.pop_front().pop_front().size(), 0);
+}
+
+TEST(persistent_vector, branches) {
+    using namespace interp;
+
+    std::vector<persistent::vector<i64>> versions{persistent::vector<i64>{}};
+    for (i64 i{0}; i < 2000; i++) {
+        versions.push_back(versions.back().push_back(i));
+    }
+
+    for (usize v{0}; v < versions.size(); v += 97) {
+        ASSERT_EQ(versions[v].size(), v);
+
+        usize i{0};
+        for (auto elem : versions[v]) {
+            ASSERT_EQ(elem, static_cast<i64>(i++));
+        }
+        ASSERT_EQ(i, v);
+    }
+}
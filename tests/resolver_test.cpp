@@ -0,0 +1,119 @@
+#include <gtest/gtest.h>
+
+#include "ast.h"
+#include "lexer.h"
+#include "parser.h"
+#include "resolver.h"
+#include "types.h"
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+class resolved {
+public:
+    std::string name{};
+    interp::usize depth{};
+    interp::usize slot{};
+    bool builtin{};
+
+    auto operator==(const resolved&) const -> bool = default;
+};
+
+static auto collect(const interp::ast::node& node, std::vector<resolved>& out) -> void {
+    using namespace interp;
+
+    if (auto n{dynamic_cast<const ast::identifier*>(&node)}) {
+        out.push_back(resolved{std::string{n->value}, n->depth, n->slot, n->builtin});
+    }
+
+    ast::for_each_child(node, [&](const ast::node& child) { collect(child, out); });
+}
+
+static auto test_resolve(std::string_view input) -> std::vector<resolved> {
+    using namespace interp;
+
+    lexer::lexer l{input};
+    parser::parser p{l};
+    auto program{p.parse_program()};
+    if (!p.errors.empty()) {
+        throw std::runtime_error{p.errors[0]};
+    }
+
+    resolver::resolver{}.resolve(program);
+
+    std::vector<resolved> ret{};
+    collect(program, ret);
+
+    return ret;
+}
+
+TEST(resolver, slots) {
+    using namespace interp;
+
+    auto got{test_resolve(R"(
+    let a = 1;
+    let f = fn(x, y) {
+        let z = x + a;
+        fn() { z + y + b };
+    };
+    len(f);
+    )")};
+
+    std::vector<resolved> expected{
+        {"x", 0, 0, false},
+        {"y", 0, 1, false},
+        {"x", 0, 0, false},
+        {"a", 1, 0, false},
+        {"z", 1, 2, false},
+        {"y", 1, 1, false},
+        {"b", 2, 2, false},
+        {"len", 0, 0, true},
+        {"f", 0, 1, false},
+    };
+
+    ASSERT_EQ(got, expected);
+}
+
+TEST(resolver, while_scope) {
+    using namespace interp;
+
+    auto got{test_resolve(R"(
+    let i = 0;
+    while (i < 3) {
+        let j = i;
+        i = j + 1;
+    }
+    )")};
+
+    std::vector<resolved> expected{
+        {"i", 0, 0, false},
+        {"i", 1, 0, false},
+        {"i", 1, 0, false},
+        {"j", 0, 0, false},
+    };
+
+    ASSERT_EQ(got, expected);
+}
+
+TEST(resolver, declared_in_order) {
+    using namespace interp;
+
+    auto got{test_resolve(R"(
+    let x = 1;
+    let f = fn() {
+        let y = x;
+        let x = 2;
+        x + y + f()
+    };
+    )")};
+
+    std::vector<resolved> expected{
+        {"x", 1, 0, false},
+        {"x", 0, 1, false},
+        {"y", 0, 0, false},
+        {"f", 1, 1, false},
+    };
+
+    ASSERT_EQ(got, expected);
+}
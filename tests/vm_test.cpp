@@ -0,0 +1,181 @@
+#include <gtest/gtest.h>
+
+#include "compiler.h"
+#include "eval.h"
+#include "lexer.h"
+#include "object.h"
+#include "parser.h"
+#include "resolver.h"
+#include "vm.h"
+
+#include <memory>
+#include <stdexcept>
+#include <string_view>
+
+static auto parse(std::string_view input) -> interp::ast::program {
+    using namespace interp;
+
+    auto l{lexer::lexer{input}};
+    auto p{parser::parser{l}};
+    auto program{p.parse_program()};
+    if (!p.errors.empty()) {
+        throw std::runtime_error{"parser errors"};
+    }
+
+    return program;
+}
+
+static auto test_vm(std::string_view input) -> interp::object::value {
+    using namespace interp;
+
+    auto program{parse(input)};
+
+    compiler::state state{};
+    compiler::compiler c{state};
+    c.compile(program);
+    if (!c.errors.empty()) {
+        throw std::runtime_error{std::format("compiler error: {}", c.errors[0])};
+    }
+
+    std::vector<object::value> globals{};
+    vm::vm machine{c.get_bytecode(), globals};
+
+    return machine.run();
+}
+
+static auto test_eval(std::string_view input) -> interp::object::value {
+    using namespace interp;
+
+    auto program{parse(input)};
+    resolver::resolver{}.resolve(program);
+    auto env{object::environment{}};
+
+    return eval::eval(program, env);
+}
+
+static auto result_string(interp::object::value val) -> std::string {
+    return val.has_value() ? val.to_string() : "<none>";
+}
+
+TEST(vm, matches_eval) {
+    static constexpr std::array inputs{
+        std::string_view{"1 + 2 * 3 - 4 / 2"},
+        std::string_view{"-(5 + 5) + 20"},
+        std::string_view{"!true; !!5; !(1 > 2)"},
+        std::string_view{"1 < 2 == true"},
+        std::string_view{"\"Hello\" + \" \" + \"World\""},
+        std::string_view{"if (1 > 2) { 10 } else { 20 }"},
+        std::string_view{"if (false) { 10 }"},
+        std::string_view{"let a = 5; let b = a * 2; a + b"},
+        std::string_view{"[1, 2 * 2, 3 + 3][1]"},
+        std::string_view{"[1, 2, 3][3]"},
+        std::string_view{"{1: 2, \"a\": true}[\"a\"]"},
+        std::string_view{"let h = set({1: 2}, 3, 4); delete(h, 1)[3] + len(push(rest([1, 2]), 3))"},
+        std::string_view{"{1: 2}[3]"},
+        std::string_view{"let add = fn(a, b) { return a + b; 10 }; add(1, 2)"},
+        std::string_view{"let f = fn() { 1; 2 }; f()"},
+        std::string_view{"let newAdder = fn(x) { fn(y) { x + y } }; let addTwo = newAdder(2); addTwo(3)"},
+        std::string_view{"let newAdder = fn(x) { fn(y) { x + y } }; newAdder(1)(2) + newAdder(3)(4)"},
+        std::string_view{"let fib = fn(n) { if (n < 2) { return n; } fib(n - 1) + fib(n - 2) }; fib(15)"},
+        std::string_view{"len(\"four\") + len([1, 2]) + first([7, 8]) + last([7, 8])"},
+        std::string_view{"rest(push([1, 2], 3))"},
+        std::string_view{"let x = 0; let y = 0; while (x < 10) { x = x + 1; if (x == 3) { continue; } "
+                         "if (x == 8) { break; } y = y + x; } y"},
+        std::string_view{"let x = 0; while (x < 5) { x = x + 1; return x; }"},
+        std::string_view{"let f = fn() { let x = if (true) { return 5; }; 10 }; f()"},
+        std::string_view{"let f = fn() { let x = 0; while (true) { x = x + 1; if (x > 3) { return x * 10; } } }; f()"},
+        std::string_view{"let x = 5; let z = 3; let foo = x; x = z = foo = \"bar\"; z + foo"},
+        std::string_view{"let counter = fn() { let n = 0; fn() { n = n + 1; n } }; let c = counter(); c(); c(); c()"},
+        std::string_view{"let a = fn() { b() }; let b = fn() { 5 }; a()"},
+        std::string_view{"let x = 1; let f = fn() { let y = x; let x = 2; y }; f()"},
+        std::string_view{"let outer = fn() { let x = 1; let inner = fn() { x = x + 10; }; inner(); x }; outer()"},
+        std::string_view{"let x = 1; while (x < 3) { while (x < 3) { x = x + 1; } } x"},
+        std::string_view{"let x = 1"},
+        std::string_view{"5 + true;"},
+        std::string_view{"-true"},
+        std::string_view{"\"Hello\" - \"World\""},
+        std::string_view{"foobar"},
+        std::string_view{"x = 3;"},
+        std::string_view{"1 / 0"},
+        std::string_view{"len(1)"},
+        std::string_view{"5()"},
+        std::string_view{"9223372036854775807 + 1; -9223372036854775807 - 2"},
+        std::string_view{"9223372036854775807 * 2"},
+        std::string_view{"let min = -9223372036854775807 - 1; min / -1 + -min"},
+        std::string_view{"let f = fn(a, b) { a }; f(1)"},
+        std::string_view{"fn() { 1 }(2)"},
+        std::string_view{"let f = fn(n) { if (n == 0) { 0 } else { f(n - 1) } }; f(5000)"},
+        std::string_view{"let f = fn(n) { f(n + 1) }; f(0)"},
+        std::string_view{"{\"name\": \"Monkey\"}[[1]]"},
+    };
+
+    for (const auto& input : inputs) {
+        ASSERT_EQ(result_string(test_vm(input)), result_string(test_eval(input))) << input;
+    }
+}
+
+TEST(vm, max_depth) {
+    using namespace interp;
+
+    static constexpr std::string_view input{"let f = fn(n) { if (n == 0) { 0 } else { f(n - 1) } }; f(20)"};
+
+    eval::set_max_depth(10);
+    auto vm_result{result_string(test_vm(input))};
+    auto eval_result{result_string(test_eval(input))};
+    eval::set_max_depth(eval::default_max_depth);
+    ASSERT_EQ(vm_result, "error: stack overflow");
+    ASSERT_EQ(eval_result, vm_result);
+}
+
+TEST(vm, recursive_closures) {
+    static constexpr std::string_view input{R"(
+    let wrapper = fn() {
+        let countdown = fn(x) {
+            if (x == 0) {
+                return 0;
+            }
+            countdown(x - 1);
+        };
+        countdown(1);
+    };
+    wrapper();
+    )"};
+
+    auto result{test_vm(input)};
+    ASSERT_EQ(result.as_integer(), 0);
+}
+
+TEST(vm, closures_in_loop) {
+    static constexpr std::string_view input{R"(
+    let fs = [];
+    let i = 0;
+    while (i < 3) {
+        let j = i;
+        fs = push(fs, fn() { j });
+        i = i + 1;
+    }
+    fs[0]() + fs[1]() * 10 + fs[2]() * 100
+    )"};
+
+    auto result{test_vm(input)};
+    ASSERT_EQ(result.as_integer(), 210);
+}
+
+TEST(vm, errors) {
+    struct error_test {
+        std::string_view input{};
+        std::string_view expected{};
+    };
+
+    std::array tests{
+        error_test{"fn(x) { x }()",                           "wrong number of arguments: want=1, got=0"},
+        error_test{"let f = fn(n) { f(n + 1) }; f(0)",        "stack overflow"                          },
+        error_test{"{\"name\": \"Monkey\"}[fn(x) { x }];",    "unusable as hash key: Closure"           },
+        error_test{"let x = if (true) { 1 }; let y = x; z;", "identifier not found: z"                 },
+    };
+
+    for (const auto& test : tests) {
+        auto result{test_vm(test.input)};
+        ASSERT_EQ(dynamic_cast<interp::object::error&>(*result.as_object()).message, test.expected);
+    }
+}